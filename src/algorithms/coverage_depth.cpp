@@ -2,6 +2,8 @@
 #include <bdsg/hash_graph.hpp>
 #include "algorithms/subgraph.hpp"
 #include <vg/io/stream.hpp>
+#include <vg/io/alignment_io.hpp>
+#include "../gaf_reader.hpp"
 #include "../path.hpp"
 
 namespace vg {
@@ -234,6 +236,26 @@ static void update_sample_gam_depth(const Alignment& aln, unordered_map<nid_t, s
     }
 }
 
+// like above, but work straight from the GAF record.  the bases covered on each node are
+// the overlap of the node with the aligned interval of the path, which is what the mappings'
+// from lengths would add up to
+static void update_sample_gaf_depth(const HandleGraph& graph, const gafkluge::GafRecord& record,
+                                    unordered_map<nid_t, size_t>& node_coverage) {
+    int64_t node_start = 0;
+    for (const gafkluge::GafStep& step : record.path) {
+        nid_t node_id = stoll(step.name);
+        int64_t node_end = node_start + graph.get_length(graph.get_handle(node_id));
+        int64_t overlap = min(node_end, record.path_end) - max(node_start, record.path_start);
+        if (overlap > 0) {
+            auto it = node_coverage.find(node_id);
+            if (it != node_coverage.end()) {
+                it->second += overlap;
+            }
+        }
+        node_start = node_end;
+    }
+}
+
 // sum up the results from the different threads and return the average.
 // if a min_coverage is given, nodes with less coverage are ignored
 static pair<double, double> combine_and_average_node_coverages(const HandleGraph& graph, vector<unordered_map<nid_t, size_t>>& node_coverages, size_t min_coverage) {
@@ -271,7 +293,23 @@ pair<double, double> sample_mapping_depth(const HandleGraph& graph, const string
                 vg::io::for_each_parallel(gam_stream, aln_callback);
             });
     } else if (format == "GAF") {
-        vg::io::gaf_unpaired_for_each_parallel(graph, input_filename, aln_callback);
+        // skip building Alignments unless the path is given by name rather than by nodes
+        vg::gaf_record_for_each_parallel(input_filename, [&](gafkluge::GafRecord& record) {
+                if ((size_t) vg::gaf_mapping_quality(record) < min_mapq) {
+                    return;
+                }
+                bool node_path = true;
+                for (const gafkluge::GafStep& step : record.path) {
+                    node_path = node_path && !step.is_stable;
+                }
+                if (node_path) {
+                    update_sample_gaf_depth(graph, record, node_coverages[omp_get_thread_num()]);
+                } else {
+                    Alignment aln;
+                    vg::io::gaf_to_alignment(graph, record, aln);
+                    aln_callback(aln);
+                }
+            });
     } else {
         throw runtime_error("vg::aglorithms::coverage_depth: Invalid format specified for sample_mapping_depth(): " +
                             format + ". Valid options are GAM and GAF.");
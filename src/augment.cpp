@@ -14,6 +14,10 @@ namespace vg {
 
 using namespace std;
 
+// About how much memory each breakpoint costs while its chunk is being edited:
+// its node translation entries and a share of the sequences added there.
+static const size_t AUGMENT_BYTES_PER_BREAKPOINT = 512;
+
 // The correct way to edit the graph
 void augment(MutablePathMutableHandleGraph* graph,
              const string& gam_path,
@@ -29,7 +33,9 @@ void augment(MutablePathMutableHandleGraph* graph,
              Packer* packer,
              size_t min_bp_coverage,
              double max_frac_n,
-             bool edges_only) {
+             bool edges_only,
+             size_t batch_size,
+             size_t max_edit_memory) {
 
     // memory-wasting hack: we need node lengths from the original graph in order to parse the GAF.  Unlesss we
     // store them, they will be lost in the 2nd pass
@@ -92,7 +98,9 @@ void augment(MutablePathMutableHandleGraph* graph,
                  packer,
                  min_bp_coverage,
                  max_frac_n,
-                 edges_only);
+                 edges_only,
+                 batch_size,
+                 max_edit_memory);
 }
 
 void augment(MutablePathMutableHandleGraph* graph,
@@ -109,7 +117,9 @@ void augment(MutablePathMutableHandleGraph* graph,
              Packer* packer,
              size_t min_bp_coverage,
              double max_frac_n,
-             bool edges_only) {
+             bool edges_only,
+             size_t batch_size,
+             size_t max_edit_memory) {
     
     function<void(function<void(Alignment&)>, bool, bool)> iterate_gam =
         [&path_vector] (function<void(Alignment&)> aln_callback, bool second_pass, bool parallel) {
@@ -148,7 +158,9 @@ void augment(MutablePathMutableHandleGraph* graph,
                  packer,
                  min_bp_coverage,
                  max_frac_n,
-                 edges_only);
+                 edges_only,
+                 batch_size,
+                 max_edit_memory);
 }
 
 // Check if alignment contains node that's not in the graph
@@ -185,7 +197,9 @@ void augment_impl(MutablePathMutableHandleGraph* graph,
                   Packer* packer,
                   size_t min_bp_coverage,
                   double max_frac_n,
-                  bool edges_only) {
+                  bool edges_only,
+                  size_t batch_size,
+                  size_t max_edit_memory) {
 
     if (edges_only) {
         // just add edges between consecutive mappings that aren't already in the graph
@@ -198,7 +212,8 @@ void augment_impl(MutablePathMutableHandleGraph* graph,
     }
     
     // toggle between using Packer to store breakpoints or the STL map
-    bool packed_mode = min_bp_coverage > 0 || min_baseq > 0 || max_frac_n < 1.;
+    // (bounding memory needs the Packer, since the map grows with the input)
+    bool packed_mode = min_bp_coverage > 0 || min_baseq > 0 || max_frac_n < 1. || max_edit_memory > 0;
     assert(!packed_mode || packer != nullptr);
     
     unordered_map<id_t, set<pos_t>> breakpoints;
@@ -238,7 +253,17 @@ void augment_impl(MutablePathMutableHandleGraph* graph,
             }
         }, false, packed_mode);
 
-    if (packed_mode) {
+    // When bounding memory, the starts of the node ID ranges we edit one at a
+    // time, and the file their breakpoints wait in until then
+    vector<nid_t> chunk_starts;
+    string spill_file;
+    if (max_edit_memory > 0) {
+        // Filter the breakpoints by coverage, straight to disk
+        spill_file = temp_file::create("augment-breakpoints");
+        size_t max_chunk_breakpoints = max<size_t>(max_edit_memory / AUGMENT_BYTES_PER_BREAKPOINT, 1);
+        chunk_starts = spill_breakpoints_by_coverage(*packer, max<size_t>(min_bp_coverage, 1), max_chunk_breakpoints,
+                                                     spill_file);
+    } else if (packed_mode) {
         // Filter the breakpoints by coverage
         breakpoints = filter_breakpoints_by_coverage(*packer, min_bp_coverage);
     } else {
@@ -262,7 +287,20 @@ void augment_impl(MutablePathMutableHandleGraph* graph,
     // from offsets on old nodes to new nodes. Note that this would mess up the
     // ranks of nodes in their existing paths, which is why we clear and rebuild
     // them.
-    auto node_translation = ensure_breakpoints(graph, breakpoints);
+    map<pos_t, id_t> node_translation;
+    // When editing in chunks, we only break the nodes of a chunk once an
+    // alignment we are about to add needs them. Track how many chunks are done.
+    size_t chunks_broken = 0;
+    auto break_chunks_through = [&](size_t chunk) {
+        for (; chunks_broken <= chunk; ++chunks_broken) {
+            nid_t end_id = chunks_broken + 1 < chunk_starts.size() ? chunk_starts[chunks_broken + 1] : numeric_limits<nid_t>::max();
+            auto chunk_translation = ensure_breakpoints(graph, load_spilled_breakpoints(spill_file, chunk_starts[chunks_broken], end_id));
+            node_translation.insert(chunk_translation.begin(), chunk_translation.end());
+        }
+    };
+    if (chunk_starts.empty()) {
+        node_translation = ensure_breakpoints(graph, breakpoints);
+    }
 
     // we remember the sequences of nodes we've added at particular positions on the forward strand
     unordered_map<pair<pos_t, string>, vector<id_t>> added_seqs;
@@ -275,11 +313,24 @@ void augment_impl(MutablePathMutableHandleGraph* graph,
     }
     vector<Alignment> aln_buffer;
 
-    // Second pass: add the nodes and edges
-    iterate_gam((function<void(Alignment&)>)[&](Alignment& aln) {
+    // Second pass: add the nodes and edges. We take the alignments in batches of a fixed size.
+    // Filtering and simplifying the paths in a batch only reads the graph, so we do that in
+    // parallel, and then make the edits serially in input order so that the result is the same
+    // as editing one alignment at a time.
+    vector<Alignment> batch;
+    batch.reserve(batch_size);
+    vector<Path> simplified_paths;
+    vector<uint8_t> keep;
+    auto process_batch = [&]() {
+        simplified_paths.resize(batch.size());
+        keep.assign(batch.size(), 0);
+#pragma omp parallel for schedule(dynamic, 16)
+        for (size_t i = 0; i < batch.size(); ++i) {
+            Alignment& aln = batch[i];
             if (aln.mapping_quality() < min_mapq || (filter_out_of_graph_alignments && !check_in_graph(aln.path(), orig_node_sizes))) {
-                return;
+                continue;
             }
+            keep[i] = 1;
             
             if (remove_softclips) {
                 softclip_trim(aln);
@@ -289,17 +340,24 @@ void augment_impl(MutablePathMutableHandleGraph* graph,
             // Mapping (because we don't have or want a breakpoint there)
             // Note: We're electing to re-simplify in a second pass to avoid storing all
             // the input paths in memory
-            Path simplified_path = simplify(aln.path());
+            simplified_paths[i] = simplify(aln.path());
 
             // Filter out edits corresponding to breakpoints that didn't meet our coverage
             // criteria
             if (min_bp_coverage > 0) {
-                simplify_filtered_edits(graph, aln, simplified_path, node_translation, orig_node_sizes,
+                simplify_filtered_edits(graph, aln, simplified_paths[i], node_translation, orig_node_sizes,
                                         min_baseq, max_frac_n);
             }
-
+        }
+        
+        for (size_t j = 0; j < batch.size(); ++j) {
+            if (!keep[j]) {
+                continue;
+            }
+            Alignment& aln = batch[j];
+            
             // Create new nodes/wire things up. Get the added version of the path.
-            Path added = add_nodes_and_edges(graph, simplified_path, node_translation, added_seqs,
+            Path added = add_nodes_and_edges(graph, simplified_paths[j], node_translation, added_seqs,
                                              added_nodes, orig_node_sizes);
 
             // Copy over the name
@@ -332,7 +390,73 @@ void augment_impl(MutablePathMutableHandleGraph* graph,
                     aln_buffer.clear();
                 }
             }
-        }, true, false);
+        }
+        batch.clear();
+    };
+    if (chunk_starts.empty()) {
+        iterate_gam((function<void(Alignment&)>)[&](Alignment& aln) {
+                batch.emplace_back(std::move(aln));
+                if (batch.size() >= batch_size) {
+                    process_batch();
+                }
+            }, true, false);
+        process_batch();
+    } else {
+        // Each alignment is added with the chunk of the lowest node ID it
+        // visits, so once a chunk is done no later alignment can look at the
+        // added sequences or translations for its nodes, and we can drop them.
+        // This costs one more pass over the alignments for each chunk.
+        auto chunk_of = [&](nid_t node_id) -> size_t {
+            auto it = upper_bound(chunk_starts.begin(), chunk_starts.end(), node_id);
+            return it == chunk_starts.begin() ? 0 : (it - chunk_starts.begin()) - 1;
+        };
+        for (size_t chunk = 0; chunk < chunk_starts.size(); ++chunk) {
+            break_chunks_through(chunk);
+            iterate_gam((function<void(Alignment&)>)[&](Alignment& aln) {
+                    const Path& path = aln.path();
+                    nid_t min_id = numeric_limits<nid_t>::max();
+                    nid_t max_id = numeric_limits<nid_t>::min();
+                    for (size_t i = 0; i < path.mapping_size(); ++i) {
+                        min_id = min<nid_t>(min_id, path.mapping(i).position().node_id());
+                        max_id = max<nid_t>(max_id, path.mapping(i).position().node_id());
+                    }
+                    if (path.mapping_size() == 0) {
+                        // Unplaced alignments go with the first chunk
+                        if (chunk != 0) {
+                            return;
+                        }
+                    } else {
+                        if (chunk_of(min_id) != chunk) {
+                            return;
+                        }
+                        // Later chunks may need breaking before we can add this
+                        break_chunks_through(chunk_of(max_id));
+                    }
+                    batch.emplace_back(std::move(aln));
+                    if (batch.size() >= batch_size) {
+                        process_batch();
+                    }
+                }, true, false);
+            process_batch();
+
+            nid_t next_start = chunk + 1 < chunk_starts.size() ? chunk_starts[chunk + 1] : numeric_limits<nid_t>::max();
+            for (auto it = added_seqs.begin(); it != added_seqs.end();) {
+                if (id(it->first.first) < next_start) {
+                    it = added_seqs.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+            if (out_translations == nullptr) {
+                // We only keep these to make the translation
+                node_translation.erase(node_translation.begin(), node_translation.lower_bound(make_pos_t(next_start, false, 0)));
+                added_nodes.clear();
+            }
+        }
+    }
+    if (!spill_file.empty()) {
+        temp_file::remove(spill_file);
+    }
     if (!aln_buffer.empty()) {
         // Flush the buffer
         aln_emitter->emit_singles(vector<Alignment>(aln_buffer));
@@ -571,6 +695,99 @@ unordered_map<id_t, set<pos_t>> filter_breakpoints_by_coverage(const Packer& pac
     
     return bp_maps[0];
 }
+
+vector<nid_t> spill_breakpoints_by_coverage(const Packer& packed_breakpoints, size_t min_bp_coverage,
+                                            size_t max_chunk_breakpoints, const string& filename) {
+    const HandleGraph* graph = packed_breakpoints.get_graph();
+    const VectorizableHandleGraph* vec_graph = dynamic_cast<const VectorizableHandleGraph*>(graph);
+    vector<nid_t> chunk_starts;
+    if (graph->get_node_count() == 0) {
+        return chunk_starts;
+    }
+
+    // Count the breakpoints in up to 64k ranges of node IDs of equal width, so
+    // we can cut the ID space into chunks by how many breakpoints they hold.
+    nid_t min_id = graph->min_node_id();
+    size_t id_range = graph->max_node_id() - min_id + 1;
+    size_t bucket_count = min<size_t>(id_range, 1 << 16);
+    auto bucket_of = [&](nid_t node_id) {
+        return (size_t)(node_id - min_id) * bucket_count / id_range;
+    };
+    vector<size_t> bucket_breakpoints(bucket_count, 0);
+
+    ofstream out(filename, ios::binary);
+    if (!out) {
+        cerr << "[vg augment] error: could not write breakpoints to " << filename << endl;
+        exit(1);
+    }
+    size_t n = packed_breakpoints.coverage_size();
+    vector<vector<pair<nid_t, size_t>>> thread_buffers(get_thread_count());
+    // Write out a thread's breakpoints when it has this many
+    const size_t buffer_size = 64 * 1024;
+    auto flush = [&](vector<pair<nid_t, size_t>>& buffer) {
+#pragma omp critical (spill_breakpoints)
+        {
+            for (auto& breakpoint : buffer) {
+                bucket_breakpoints[bucket_of(breakpoint.first)]++;
+            }
+            out.write((const char*)buffer.data(), buffer.size() * sizeof(pair<nid_t, size_t>));
+        }
+        buffer.clear();
+    };
+#pragma omp parallel for
+    for (size_t i = 0; i < n; ++i) {
+        if (packed_breakpoints.coverage_at_position(i) >= min_bp_coverage) {
+            auto& buffer = thread_buffers[omp_get_thread_num()];
+            nid_t node_id = vec_graph->node_at_vector_offset(i+1);
+            buffer.emplace_back(node_id, i - vec_graph->node_vector_offset(node_id));
+            if (buffer.size() >= buffer_size) {
+                flush(buffer);
+            }
+        }
+    }
+    for (auto& buffer : thread_buffers) {
+        flush(buffer);
+    }
+    out.close();
+    if (!out) {
+        cerr << "[vg augment] error: could not write breakpoints to " << filename << endl;
+        exit(1);
+    }
+
+    // Cut a new chunk whenever the next range would put too many breakpoints in
+    // this one.
+    chunk_starts.push_back(min_id);
+    size_t chunk_breakpoints = 0;
+    for (size_t bucket = 0; bucket < bucket_count; ++bucket) {
+        if (chunk_breakpoints > 0 && chunk_breakpoints + bucket_breakpoints[bucket] > max_chunk_breakpoints) {
+            // The first ID in the bucket
+            chunk_starts.push_back(min_id + (bucket * id_range + bucket_count - 1) / bucket_count);
+            chunk_breakpoints = 0;
+        }
+        chunk_breakpoints += bucket_breakpoints[bucket];
+    }
+    return chunk_starts;
+}
+
+unordered_map<id_t, set<pos_t>> load_spilled_breakpoints(const string& filename, nid_t first_id, nid_t end_id) {
+    unordered_map<id_t, set<pos_t>> breakpoints;
+    ifstream in(filename, ios::binary);
+    if (!in) {
+        cerr << "[vg augment] error: could not read breakpoints from " << filename << endl;
+        exit(1);
+    }
+    vector<pair<nid_t, size_t>> buffer(64 * 1024);
+    while (in) {
+        in.read((char*)buffer.data(), buffer.size() * sizeof(pair<nid_t, size_t>));
+        size_t count = in.gcount() / sizeof(pair<nid_t, size_t>);
+        for (size_t i = 0; i < count; ++i) {
+            if (buffer[i].first >= first_id && buffer[i].first < end_id) {
+                breakpoints[buffer[i].first].insert(make_pos_t(buffer[i].first, false, buffer[i].second));
+            }
+        }
+    }
+    return breakpoints;
+}
     
 
 path_handle_t add_path_to_graph(MutablePathHandleGraph* graph, const Path& path) {
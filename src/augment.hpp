@@ -43,6 +43,15 @@ using namespace std;
 /// A packer is required for all non-mapq filters
 /// If a breakpoint has less than min_bp_coverage it is not included in the graph
 /// Edits with more than max_frac_n N content will be ignored
+/// Alignments are read batch_size at a time so that their edits can be filtered in
+/// parallel before they are added to the graph.
+/// If max_edit_memory is set, memory for the breakpoints and added nodes is
+/// bounded to about that many bytes (requires a packer). The breakpoints that pass
+/// the filters are spilled to a temporary file, and the graph is edited one node
+/// ID range at a time, reading the alignments once per range. Each alignment is
+/// added with the range of its lowest node ID, so alignments written to
+/// gam_out_path come out in that order. The translation, if wanted, still covers
+/// the whole graph.
 void augment(MutablePathMutableHandleGraph* graph,
              const string& gam_path,
              const string& aln_format = "GAM",
@@ -57,7 +66,9 @@ void augment(MutablePathMutableHandleGraph* graph,
              Packer* packer = nullptr,
              size_t min_bp_coverage = 0,
              double max_frac_n = 1.,
-             bool edges_only = false);
+             bool edges_only = false,
+             size_t batch_size = 1024,
+             size_t max_edit_memory = 0);
 
 /// Like above, but operates on a vector of Alignments, instead of a file
 /// (Note: It is best to use file interface to stream large numbers of alignments to save memory)
@@ -75,7 +86,9 @@ void augment(MutablePathMutableHandleGraph* graph,
              Packer* packer = nullptr,
              size_t min_bp_coverage = 0,
              double max_frac_n = 1.,
-             bool edges_only = false);
+             bool edges_only = false,
+             size_t batch_size = 1024,
+             size_t max_edit_memory = 0);
 
 /// Generic version used to implement the above three methods.  
 void augment_impl(MutablePathMutableHandleGraph* graph,
@@ -92,7 +105,9 @@ void augment_impl(MutablePathMutableHandleGraph* graph,
                   Packer* packer,
                   size_t min_bp_coverage,
                   double max_frac_n,
-                  bool edges_only);
+                  bool edges_only,
+                  size_t batch_size,
+                  size_t max_edit_memory);
 
 /// Add a path to the graph.  This is like VG::extend, and expects
 /// a path with no edits, and for all the nodes and edges in the path
@@ -133,6 +148,16 @@ void find_packed_breakpoints(const Path& path, Packer& packed_breakpoints, bool
 /// expected by following methods
 unordered_map<id_t, set<pos_t>> filter_breakpoints_by_coverage(const Packer& packed_breakpoints, size_t min_bp_coverage);
 
+/// Like filter_breakpoints_by_coverage, but writes the breakpoints to the given file
+/// instead of keeping them in memory. Returns the starts, in order, of node ID ranges
+/// that each hold at most max_chunk_breakpoints breakpoints, unless a single node has more
+vector<nid_t> spill_breakpoints_by_coverage(const Packer& packed_breakpoints, size_t min_bp_coverage,
+                                            size_t max_chunk_breakpoints, const string& filename);
+
+/// Read back the breakpoints written by spill_breakpoints_by_coverage on nodes with
+/// IDs in [first_id, end_id)
+unordered_map<id_t, set<pos_t>> load_spilled_breakpoints(const string& filename, nid_t first_id, nid_t end_id);
+
 /// Take a map from node ID to a set of offsets at which new nodes should
 /// start (which may include 0 and 1-past-the-end, which should be ignored),
 /// break the specified nodes at those positions. Returns a map from old
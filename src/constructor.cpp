@@ -1860,6 +1860,60 @@ namespace vg {
             callback(chunk.graph);
         };
 
+        // Chunks only depend on each other through ID assignment and wiring,
+        // which are cheap, so we collect a batch of chunks to construct in
+        // parallel and then wire and emit them in order. This produces the
+        // same graph as constructing them one at a time.
+        struct QueuedChunk {
+            string reference_sequence;
+            vector<vcflib::Variant> variants;
+            size_t start;
+            size_t end;
+        };
+        vector<QueuedChunk> chunk_queue;
+        size_t max_queued_chunks = max<size_t>(get_thread_count() * chunks_per_thread, 1);
+        
+        // Construct all the queued chunks, and wire up and emit them in order.
+        auto construct_queued_chunks = [&]() {
+            vector<ConstructedChunk> results(chunk_queue.size());
+            
+            #pragma omp parallel for schedule(dynamic, 1)
+            for (size_t i = 0; i < chunk_queue.size(); i++) {
+                QueuedChunk& queued = chunk_queue[i];
+                results[i] = construct_chunk(std::move(queued.reference_sequence), reference_contig,
+                                             std::move(queued.variants), queued.start);
+            }
+            
+            for (size_t i = 0; i < chunk_queue.size(); i++) {
+                // Wire up and emit the chunk graph
+                wire_and_emit(results[i]);
+                // Free it now that it is out
+                results[i] = ConstructedChunk();
+                
+                // Say we've completed the chunk
+                update_progress(chunk_queue[i].end - leading_offset);
+            }
+            
+            chunk_queue.clear();
+        };
+        
+        // Queue up the chunk from chunk_start to chunk_end with the current
+        // chunk_variants, constructing the queue if it is full.
+        auto queue_chunk = [&]() {
+            chunk_queue.emplace_back();
+            QueuedChunk& queued = chunk_queue.back();
+            // Get the ref sequence we need. The FASTA reader isn't thread
+            // safe, so we do this here.
+            queued.reference_sequence = reference.getSubSequence(reference_contig, chunk_start, chunk_end - chunk_start);
+            queued.variants = std::move(chunk_variants);
+            queued.start = chunk_start;
+            queued.end = chunk_end;
+            
+            if (chunk_queue.size() >= max_queued_chunks) {
+                construct_queued_chunks();
+            }
+        };
+
         bool do_external_insertions = false;
         FastaReference* insertion_fasta;
 
@@ -2040,17 +2094,8 @@ namespace vg {
                             min((size_t) reference_end,
                                 (size_t) (chunk_start + bases_per_chunk))));
 
-                // Get the ref sequence we need
-                auto chunk_ref = reference.getSubSequence(reference_contig, chunk_start, chunk_end - chunk_start);
-
-                // Call the construction
-                auto result = construct_chunk(chunk_ref, reference_contig, chunk_variants, chunk_start);
-
-                // Wire up and emit the chunk graph
-                wire_and_emit(result);
-
-                // Say we've completed the chunk
-                update_progress(chunk_end - leading_offset);
+                // Queue the chunk up to be constructed
+                queue_chunk();
 
                 // Set up a new chunk
                 chunk_start = chunk_end;
@@ -2076,17 +2121,8 @@ namespace vg {
                     min((size_t) reference_end,
                         (size_t) (chunk_start + bases_per_chunk)));
 
-            // Get the ref sequence we need
-            auto chunk_ref = reference.getSubSequence(reference_contig, chunk_start, chunk_end - chunk_start);
-
-            // Call the construction
-            auto result = construct_chunk(chunk_ref, reference_contig, chunk_variants, chunk_start);
-
-            // Wire up and emit the chunk graph
-            wire_and_emit(result);
-
-            // Say we've completed the chunk
-            update_progress(chunk_end - leading_offset);
+            // Queue the chunk up to be constructed
+            queue_chunk();
 
             // Set up a new chunk
             chunk_start = chunk_end;
@@ -2094,6 +2130,9 @@ namespace vg {
             chunk_variants.clear();
         }
 
+        // Construct whatever is left
+        construct_queued_chunks();
+
         // All the chunks have been wired and emitted.
         
         if (last_node_buffer.id() != 0) {
@@ -128,6 +128,12 @@ public:
     // load all of chr1 into an std::string, even if we have no variants on it.
     size_t bases_per_chunk = 1024 * 1024;
     
+    // How many chunks per thread should we collect before constructing them in
+    // parallel? Constructed chunks are held until they can be wired up in
+    // order, so this bounds memory use at about threads times this many
+    // chunks.
+    size_t chunks_per_thread = 2;
+    
     // This set contains the set of VCF sequence names we want to build the
     // graph for. If empty, we will build the graph for all sequences in the
     // FASTA. If nonempty, we build only for the specified sequences. If
@@ -35,11 +35,18 @@ void Damage::combineDeamRates(long double f1[4],long double f2[4],long double f[
             }
         }
                                                                                        }
-//! A method to initialize the deamination probabilities
+//! A method to initialize the deamination probabilities from each end of the fragment
 /*!
-  This method is called by the run/main function
+  This method is called by initDeamProbabilities, and alone by callers that
+  only need sub5p and sub3p and not the per fragment length rates
 */
-void Damage::initDeamProbabilities(const string & deam5pfreqE,const string & deam3pfreqE){
+void Damage::initEndDeamProbabilities(const string & deam5pfreqE,const string & deam3pfreqE){
+
+    //start over if we had other profiles loaded
+    sub5p.clear();
+    sub3p.clear();
+    sub5pDiNuc.clear();
+    sub3pDiNuc.clear();
 
     vector<substitutionRates> sub5pT;
     vector<substitutionRates> sub3pT;
@@ -202,6 +209,19 @@ void Damage::initDeamProbabilities(const string & deam5pfreqE,const string & dea
     }
 
 #endif
+}
+
+//! A method to initialize the deamination probabilities
+/*!
+  This method is called by the run/main function
+*/
+void Damage::initDeamProbabilities(const string & deam5pfreqE,const string & deam3pfreqE){
+
+    initEndDeamProbabilities(deam5pfreqE,deam3pfreqE);
+
+    subDeam.clear();
+    subDeamDiNuc.clear();
+
     //dummy values
     for(unsigned int L=0;L<MINLENGTHFRAGMENT;L++){     //for each fragment length
 	vector<probSubstition> subDeam_;
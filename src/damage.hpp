@@ -23,6 +23,7 @@ public:
 
     //deamination functions
     void initDeamProbabilities(const string & deam5pfreqE,const string & deam3pfreqE);
+    void initEndDeamProbabilities(const string & deam5pfreqE,const string & deam3pfreqE);
     void combineDeamRates(long double f1[4],long double f2[4],long double f[4],int b);
 
     //Substitution rates due to deamination
@@ -0,0 +1,66 @@
+/**
+ * \file damage_mask.cpp
+ * Builds substitution masks from deamination profiles.
+ */
+
+#include "damage_mask.hpp"
+#include "damage.hpp"
+
+namespace vg {
+
+/// Get the 0-3 index of a base in the order used by the damage matrices, or -1
+static inline int damage_base_index(char base) {
+    switch (base) {
+    case 'A': case 'a': return 0;
+    case 'C': case 'c': return 1;
+    case 'G': case 'g': return 2;
+    case 'T': case 't': return 3;
+    default: return -1;
+    }
+}
+
+uint16_t damage_mask_bit(char ref_base, char read_base) {
+    int ref_index = damage_base_index(ref_base);
+    int read_index = damage_base_index(read_base);
+    if (ref_index < 0 || read_index < 0) {
+        return 0;
+    }
+    return 1 << (ref_index * 4 + read_index);
+}
+
+void make_damage_masks(const string& deam5p_file, const string& deam3p_file, double min_damage_prob,
+                       vector<uint16_t>& mask_5p, vector<uint16_t>& mask_3p) {
+    // we only need the rates by distance from each end, not the full per-length tables
+    Damage damage;
+    damage.initEndDeamProbabilities(deam5p_file, deam3p_file);
+
+    // deamination only turns C into T, and G into A on the other strand
+    const pair<int, int> deaminations[] = { {1, 3}, {2, 0} };
+    auto make_mask = [&](const vector<probSubstition>& rates, vector<uint16_t>& mask) {
+        mask.clear();
+        if (rates.empty()) {
+            return;
+        }
+        // the profile's last row is carried on through the rest of the read, so it is the
+        // background rate in the interior
+        const probSubstition& interior = rates.back();
+        for (auto& rate : rates) {
+            uint16_t bits = 0;
+            for (auto& sub : deaminations) {
+                int index = sub.first * 4 + sub.second;
+                if (rate.s[index] >= min_damage_prob && rate.s[index] > interior.s[index]) {
+                    bits |= 1 << index;
+                }
+            }
+            mask.push_back(bits);
+        }
+        // no need to look past the last position with any damage
+        while (!mask.empty() && mask.back() == 0) {
+            mask.pop_back();
+        }
+    };
+    make_mask(damage.sub5p, mask_5p);
+    make_mask(damage.sub3p, mask_3p);
+}
+
+}
@@ -0,0 +1,33 @@
+#ifndef VG_DAMAGE_MASK_HPP_INCLUDED
+#define VG_DAMAGE_MASK_HPP_INCLUDED
+
+/**
+ * \file damage_mask.hpp
+ * Tables of which substitutions ancient DNA damage explains near read ends,
+ * for code that needs to check bases against a deamination profile without
+ * pulling in the whole damage model.
+ */
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace vg {
+using namespace std;
+
+/// Get the bit for a substitution from ref_base to read_base in a damage mask,
+/// or 0 if either is not one of ACGT.
+uint16_t damage_mask_bit(char ref_base, char read_base);
+
+/// Read the 5' and 3' .prof deamination matrices that giraffe takes, and make
+/// one substitution mask per distance from each end. A mask has the bit for
+/// C->T or G->A set where that substitution happens with at least
+/// min_damage_prob probability, and more often than in the read interior, so
+/// only the damaged ends are covered no matter how high the background rate
+/// is. The masks stop at the last position with any bit set.
+void make_damage_masks(const string& deam5p_file, const string& deam3p_file, double min_damage_prob,
+                       vector<uint16_t>& mask_5p, vector<uint16_t>& mask_3p);
+
+}
+
+#endif
@@ -717,6 +717,26 @@ void DozeuInterface::align_downward(Alignment& alignment, const OrderedGraph& gr
 	flush();
 }
 
+void DozeuInterface::trim_arena() {
+    // Dozeu chains the blocks it grows into after its first one, and keeps
+    // them all for reuse after a flush. Keep the leading blocks that fit in
+    // the budget and give the rest back.
+    dz_mem_s* mem = dz_mem(dz);
+    size_t retained = mem->blk.size;
+    dz_mem_block_s** link = &mem->blk.next;
+    while (*link != nullptr && retained + (*link)->size <= max_retained_arena_bytes) {
+        retained += (*link)->size;
+        link = &(*link)->next;
+    }
+    dz_mem_block_s* blk = *link;
+    *link = nullptr;
+    while (blk != nullptr) {
+        dz_mem_block_s* next = blk->next;
+        dz_free(blk);
+        blk = next;
+    }
+}
+
 void DozeuInterface::align_pinned(Alignment& alignment, const HandleGraph& g, bool pin_left,
                                   int8_t full_length_bonus, uint16_t max_gap_length)
 {
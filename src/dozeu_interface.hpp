@@ -53,7 +53,7 @@ static constexpr uint16_t default_xdrop_max_gap_length = 40;
  *
  * This class maintains an internal dz_s, which is *NOT THREADSAFE*,
  * and non-const during alignments. However, it may be reused for
- * subsequent alignments.
+ * subsequent alignments, and its memory arena is kept between them.
  */
 class DozeuInterface {
     
@@ -242,6 +242,17 @@ protected:
     
     /// The core dozeu class, which does the alignments
     dz_s* dz = nullptr;
+    
+    /// How many bytes of dozeu's arena should we hold on to between
+    /// alignments? The arena grows as big as any one problem needs, and is
+    /// just reset afterward, but past this size it gives the extra back so an
+    /// occasional huge problem doesn't pin its memory to the thread forever.
+    /// Every thread has its own aligners, so this is paid per thread.
+    static constexpr size_t max_retained_arena_bytes = 32 * 1024 * 1024;
+    
+    /// Free the blocks of dozeu's arena past max_retained_arena_bytes. Must
+    /// be called right after a flush, when no blocks are in use.
+    void trim_arena();
 };
 
 /*
@@ -0,0 +1,152 @@
+/**
+ * \file gaf_reader.cpp
+ * Implements parallel reading of GAF text alignment files.
+ */
+
+#include "gaf_reader.hpp"
+
+#include <vg/io/alignment_io.hpp>
+
+#include <htslib/hts.h>
+#include <htslib/kseq.h>
+#include <htslib/kstring.h>
+#include <htslib/thread_pool.h>
+
+#include <omp.h>
+
+namespace vg {
+using namespace std;
+
+/// Read the lines of a GAF file in blocks of batch_size records of
+/// record_lines lines each, and hand each block to process_block on the
+/// thread that read it. Returns the number of lines read.
+static size_t for_each_gaf_block_parallel(const string& filename, size_t record_lines, size_t batch_size,
+                                          const function<void(vector<string>&)>& process_block) {
+
+    htsFile* in = hts_open(filename.c_str(), "r");
+    if (in == nullptr) {
+        cerr << "error[vg::gaf_reader]: could not open " << filename << endl;
+        exit(1);
+    }
+
+    // Decompression is shared out over a pool, so the thread holding the file
+    // gives it up sooner.
+    size_t threads = max(omp_get_max_threads(), 1);
+    hts_tpool* pool = hts_tpool_init(threads);
+    if (pool != nullptr) {
+        htsThreadPool input_pool = {pool, 0};
+        // This only takes for compressed input, which is fine.
+        hts_set_opt(in, HTS_OPT_THREAD_POOL, &input_pool);
+    }
+
+    size_t line_count = 0;
+
+    #pragma omp parallel
+    {
+        kstring_t line = {0, 0, nullptr};
+        vector<string> block;
+        while (true) {
+            block.clear();
+
+            #pragma omp critical (gaf_reader_input)
+            {
+                // Each thread fights for the file and the winner takes a block
+                int status = 0;
+                while (block.size() < batch_size * record_lines && (status = hts_getline(in, KS_SEP_LINE, &line)) >= 0) {
+                    if (line.l == 0) {
+                        continue;
+                    }
+                    block.emplace_back(line.s, line.l);
+                }
+                if (status < -1) {
+                    cerr << "error[vg::gaf_reader]: could not read " << filename << endl;
+                    exit(1);
+                }
+                line_count += block.size();
+            }
+
+            if (block.empty()) {
+                break;
+            }
+            if (block.size() % record_lines != 0) {
+                cerr << "error[vg::gaf_reader]: " << filename << " ends partway through an interleaved pair" << endl;
+                exit(1);
+            }
+
+            process_block(block);
+        }
+        free(line.s);
+    }
+
+    hts_close(in);
+    if (pool != nullptr) {
+        hts_tpool_destroy(pool);
+    }
+
+    return line_count;
+}
+
+size_t gaf_record_for_each_parallel(const string& filename,
+                                    const function<void(gafkluge::GafRecord&)>& lambda,
+                                    size_t batch_size) {
+    return for_each_gaf_block_parallel(filename, 1, batch_size, [&](vector<string>& block) {
+        gafkluge::GafRecord record;
+        for (const string& line : block) {
+            gafkluge::parse_gaf_record(line, record);
+            lambda(record);
+        }
+    });
+}
+
+size_t gaf_record_pair_for_each_parallel(const string& filename,
+                                         const function<void(gafkluge::GafRecord&, gafkluge::GafRecord&)>& lambda,
+                                         size_t batch_size) {
+    return for_each_gaf_block_parallel(filename, 2, batch_size, [&](vector<string>& block) {
+        gafkluge::GafRecord record1;
+        gafkluge::GafRecord record2;
+        for (size_t i = 0; i < block.size(); i += 2) {
+            gafkluge::parse_gaf_record(block[i], record1);
+            gafkluge::parse_gaf_record(block[i + 1], record2);
+            lambda(record1, record2);
+        }
+    }) / 2;
+}
+
+size_t gaf_filtered_for_each_parallel(const HandleGraph& graph, const string& filename,
+                                      const function<bool(const gafkluge::GafRecord&)>& keep,
+                                      const function<void(Alignment&)>& lambda,
+                                      size_t batch_size) {
+    return gaf_record_for_each_parallel(filename, [&](gafkluge::GafRecord& record) {
+        if (!keep || keep(record)) {
+            Alignment aln;
+            vg::io::gaf_to_alignment(graph, record, aln);
+            lambda(aln);
+        }
+    }, batch_size);
+}
+
+size_t gaf_filtered_paired_for_each_parallel(const HandleGraph& graph, const string& filename,
+                                             const function<bool(const gafkluge::GafRecord&, const gafkluge::GafRecord&)>& keep,
+                                             const function<void(Alignment&, Alignment&)>& lambda,
+                                             size_t batch_size) {
+    return gaf_record_pair_for_each_parallel(filename, [&](gafkluge::GafRecord& record1, gafkluge::GafRecord& record2) {
+        if (!keep || keep(record1, record2)) {
+            Alignment aln1;
+            Alignment aln2;
+            vg::io::gaf_to_alignment(graph, record1, aln1);
+            vg::io::gaf_to_alignment(graph, record2, aln2);
+            lambda(aln1, aln2);
+        }
+    }, batch_size);
+}
+
+int32_t gaf_mapping_quality(const gafkluge::GafRecord& record) {
+    return gafkluge::is_missing(record.mapq) ? 0 : record.mapq;
+}
+
+int64_t gaf_score(const gafkluge::GafRecord& record) {
+    auto it = record.opt_fields.find("AS");
+    return it == record.opt_fields.end() ? 0 : stol(it->second.second);
+}
+
+}
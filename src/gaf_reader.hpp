@@ -0,0 +1,59 @@
+#ifndef VG_GAF_READER_HPP_INCLUDED
+#define VG_GAF_READER_HPP_INCLUDED
+
+/**
+ * \file gaf_reader.hpp
+ * Parallel reading of GAF text alignment files, which lets callers look at
+ * the GAF fields of each record before paying to convert it to an Alignment.
+ */
+
+#include "handle.hpp"
+
+#include <functional>
+#include <string>
+
+#include <vg/vg.pb.h>
+#include <vg/io/gafkluge.hpp>
+
+namespace vg {
+using namespace std;
+
+/// Parse the records of the GAF file with the given name ("-" for standard
+/// input), which may be BGZF-compressed, and call the given function on each
+/// of them. Threads take turns reading blocks of batch_size lines, and parse
+/// their blocks in parallel. Records are not visited in file order. Returns
+/// the number of records read.
+size_t gaf_record_for_each_parallel(const string& filename,
+                                    const function<void(gafkluge::GafRecord&)>& lambda,
+                                    size_t batch_size = 512);
+
+/// Same as above, but for interleaved pairs of records.
+size_t gaf_record_pair_for_each_parallel(const string& filename,
+                                         const function<void(gafkluge::GafRecord&, gafkluge::GafRecord&)>& lambda,
+                                         size_t batch_size = 512);
+
+/// Read the GAF file in parallel as above, and convert the records for which
+/// keep returns true to Alignments for the given function. Records that keep
+/// rejects are never converted. A null keep function accepts every record.
+size_t gaf_filtered_for_each_parallel(const HandleGraph& graph, const string& filename,
+                                      const function<bool(const gafkluge::GafRecord&)>& keep,
+                                      const function<void(Alignment&)>& lambda,
+                                      size_t batch_size = 512);
+
+/// Same as above, but for interleaved pairs of records.
+size_t gaf_filtered_paired_for_each_parallel(const HandleGraph& graph, const string& filename,
+                                             const function<bool(const gafkluge::GafRecord&, const gafkluge::GafRecord&)>& keep,
+                                             const function<void(Alignment&, Alignment&)>& lambda,
+                                             size_t batch_size = 512);
+
+/// Get the mapping quality of a GAF record, as it would be set on the
+/// Alignment. Missing mapping qualities are 0.
+int32_t gaf_mapping_quality(const gafkluge::GafRecord& record);
+
+/// Get the alignment score from the AS tag of a GAF record, as it would be
+/// set on the Alignment. Records without the tag score 0.
+int64_t gaf_score(const gafkluge::GafRecord& record);
+
+}
+
+#endif
@@ -0,0 +1,515 @@
+/**
+ * \file gaf_sorter.cpp
+ * Implements sorting for GAF text alignment files.
+ */
+
+#include "gaf_sorter.hpp"
+#include "utility.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <queue>
+#include <thread>
+
+#include <sys/stat.h>
+
+#include <htslib/hts.h>
+#include <htslib/kstring.h>
+
+#include <omp.h>
+
+//#define debug
+
+namespace vg {
+using namespace std;
+
+bool GAFSorter::Key::operator<(const Key& other) const {
+    // Same order as StreamSorter uses on Positions.
+    if (node_id != other.node_id) {
+        return node_id < other.node_id;
+    }
+    if (is_reverse != other.is_reverse) {
+        return is_reverse < other.is_reverse;
+    }
+    return offset < other.offset;
+}
+
+bool GAFSorter::Record::operator<(const Record& other) const {
+    if (key < other.key) {
+        return true;
+    }
+    if (other.key < key) {
+        return false;
+    }
+    // Break ties by the whole line, so the output doesn't depend on how the
+    // input was split into runs.
+    return line < other.line;
+}
+
+GAFSorter::Key GAFSorter::get_key(const string& line) {
+    Key min_key;
+
+    // Find the path (column 6) and the path start offset (column 8).
+    size_t path_begin = 0;
+    size_t path_end = 0;
+    size_t path_offset = 0;
+    size_t column = 0;
+    size_t field_start = 0;
+    for (size_t i = 0; i <= line.size() && column <= 7; i++) {
+        if (i == line.size() || line[i] == '\t') {
+            if (column == 5) {
+                path_begin = field_start;
+                path_end = i;
+            } else if (column == 7) {
+                path_offset = strtoull(line.c_str() + field_start, nullptr, 10);
+            }
+            column++;
+            field_start = i + 1;
+        }
+    }
+
+    if (column <= 7 || path_begin == path_end || (line[path_begin] != '>' && line[path_begin] != '<')) {
+        // Not enough columns, unmapped, or a path we can't place without the graph.
+        return min_key;
+    }
+
+    bool have_min = false;
+    bool first_step = true;
+    size_t i = path_begin;
+    while (i < path_end && (line[i] == '>' || line[i] == '<')) {
+        // For each oriented node visit
+        Key step;
+        step.is_reverse = (line[i] == '<');
+        ++i;
+        while (i < path_end && line[i] >= '0' && line[i] <= '9') {
+            step.node_id = step.node_id * 10 + (line[i] - '0');
+            ++i;
+        }
+        // Only the first visit can start partway into the node.
+        step.offset = first_step ? path_offset : 0;
+        first_step = false;
+
+        if (!have_min || step < min_key) {
+            min_key = step;
+            have_min = true;
+        }
+    }
+
+    return min_key;
+}
+
+//-----------------------------------------------------------------------------
+
+class GAFSorter::RunReader : public GAFSorter::Source {
+public:
+    RunReader(const string& filename, hts_tpool* pool) : filename(filename) {
+        in = bgzf_open(filename.c_str(), "r");
+        if (in == nullptr) {
+            cerr << "error[vg::GAFSorter]: could not read sorted run " << filename << endl;
+            exit(1);
+        }
+        if (pool != nullptr) {
+            // Decompress ahead of the merge in the shared pool.
+            bgzf_thread_pool(in, pool, 0);
+        }
+        advance();
+    }
+
+    virtual ~RunReader() {
+        free(buffer.s);
+        bgzf_close(in);
+    }
+
+    virtual bool has_current() const {
+        return have_current;
+    }
+
+    virtual Record& current() {
+        return record;
+    }
+
+    virtual void advance() {
+        int status = bgzf_getline(in, '\n', &buffer);
+        if (status < -1) {
+            cerr << "error[vg::GAFSorter]: could not read sorted run " << filename << endl;
+            exit(1);
+        }
+        have_current = (status >= 0);
+        if (have_current) {
+            record.line.assign(buffer.s, buffer.l);
+            record.key = get_key(record.line);
+        }
+    }
+
+private:
+    string filename;
+    BGZF* in = nullptr;
+    kstring_t buffer = {0, 0, nullptr};
+    Record record;
+    bool have_current = false;
+};
+
+class GAFSorter::BatchQueue : public GAFSorter::Source {
+public:
+
+    /// Add a batch of records, waiting if too many are waiting already. An
+    /// empty batch ends the stream.
+    void push(vector<Record>&& batch) {
+        unique_lock<mutex> lock(queue_mutex);
+        not_full.wait(lock, [&]() { return queue.size() < MAX_BATCHES; });
+        queue.emplace_back(std::move(batch));
+        not_empty.notify_one();
+    }
+
+    /// Wait for the first batch. Must be called before reading.
+    void start() {
+        fetch();
+    }
+
+    virtual bool has_current() const {
+        return next < batch.size();
+    }
+
+    virtual Record& current() {
+        return batch[next];
+    }
+
+    virtual void advance() {
+        next++;
+        if (next == batch.size() && !finished) {
+            fetch();
+        }
+    }
+
+    /// How many records should go in a batch?
+    static constexpr size_t BATCH_SIZE = 4096;
+
+private:
+
+    /// Wait for and take the next batch.
+    void fetch() {
+        unique_lock<mutex> lock(queue_mutex);
+        not_empty.wait(lock, [&]() { return !queue.empty(); });
+        batch = std::move(queue.front());
+        queue.pop_front();
+        next = 0;
+        finished = batch.empty();
+        not_full.notify_one();
+    }
+
+    /// How many batches can wait in the queue?
+    static constexpr size_t MAX_BATCHES = 4;
+
+    mutex queue_mutex;
+    condition_variable not_full;
+    condition_variable not_empty;
+    deque<vector<Record>> queue;
+
+    vector<Record> batch;
+    size_t next = 0;
+    bool finished = false;
+};
+
+//-----------------------------------------------------------------------------
+
+GAFSorter::GAFSorter(bool show_progress) {
+    this->show_progress = show_progress;
+}
+
+void GAFSorter::merge(vector<Source*>& sources, const function<void(Record&)>& emit) {
+    // Priority queues put the greatest item first, so reverse the order.
+    auto source_order = [&](Source* a, Source* b) {
+        return b->current() < a->current();
+    };
+    priority_queue<Source*, vector<Source*>, decltype(source_order)> source_queue(source_order);
+    for (auto& source : sources) {
+        if (source->has_current()) {
+            source_queue.push(source);
+        }
+    }
+
+    while (!source_queue.empty()) {
+        Source* winner = source_queue.top();
+        source_queue.pop();
+
+        emit(winner->current());
+
+        winner->advance();
+        if (winner->has_current()) {
+            source_queue.push(winner);
+        }
+    }
+}
+
+string GAFSorter::write_run(vector<Record>& records, hts_tpool* pool) const {
+    std::sort(records.begin(), records.end());
+
+    string filename = temp_file::create("vg-gafsort-");
+    // Temp runs only need to be small, not very small.
+    BGZF* out = bgzf_open(filename.c_str(), "w1");
+    if (out == nullptr) {
+        cerr << "error[vg::GAFSorter]: could not write sorted run to " << filename << endl;
+        exit(1);
+    }
+    if (pool != nullptr) {
+        // Compress in parallel in the shared pool.
+        bgzf_thread_pool(out, pool, 0);
+    }
+    for (auto& record : records) {
+        if (bgzf_write(out, record.line.data(), record.line.size()) < 0 || bgzf_write(out, "\n", 1) < 0) {
+            cerr << "error[vg::GAFSorter]: could not write sorted run to " << filename << endl;
+            exit(1);
+        }
+    }
+    if (bgzf_close(out) != 0) {
+        cerr << "error[vg::GAFSorter]: could not finish sorted run " << filename << endl;
+        exit(1);
+    }
+    records.clear();
+
+#ifdef debug
+    #pragma omp critical (cerr)
+    cerr << "Wrote sorted GAF run " << filename << endl;
+#endif
+
+    return filename;
+}
+
+string GAFSorter::merge_to_run(const vector<string>& runs, hts_tpool* pool, size_t threads) const {
+    string filename = temp_file::create("vg-gafsort-");
+    BGZF* out = bgzf_open(filename.c_str(), "w1");
+    if (out == nullptr) {
+        cerr << "error[vg::GAFSorter]: could not write merged run to " << filename << endl;
+        exit(1);
+    }
+    if (pool != nullptr) {
+        bgzf_thread_pool(out, pool, 0);
+    }
+    merge_runs(runs, pool, threads, [&](Record& record) {
+        if (bgzf_write(out, record.line.data(), record.line.size()) < 0 || bgzf_write(out, "\n", 1) < 0) {
+            cerr << "error[vg::GAFSorter]: could not write merged run to " << filename << endl;
+            exit(1);
+        }
+    });
+    if (bgzf_close(out) != 0) {
+        cerr << "error[vg::GAFSorter]: could not finish merged run " << filename << endl;
+        exit(1);
+    }
+    return filename;
+}
+
+void GAFSorter::merge_runs(const vector<string>& runs, hts_tpool* pool, size_t threads,
+                           const function<void(Record&)>& emit) const {
+
+    // Use a group per thread, but don't bother with groups of one run.
+    size_t group_count = min(threads, runs.size() / 2);
+
+    if (group_count <= 1) {
+        // Merge everything right here.
+        vector<unique_ptr<RunReader>> readers;
+        vector<Source*> sources;
+        for (auto& run : runs) {
+            readers.emplace_back(new RunReader(run, pool));
+            sources.push_back(readers.back().get());
+        }
+        merge(sources, emit);
+    } else {
+        // Merge groups of runs in their own threads, and merge what they
+        // produce here.
+        vector<BatchQueue> queues(group_count);
+        vector<thread> workers;
+        for (size_t i = 0; i < group_count; i++) {
+            workers.emplace_back([&, i]() {
+                vector<unique_ptr<RunReader>> readers;
+                vector<Source*> sources;
+                for (size_t j = i; j < runs.size(); j += group_count) {
+                    readers.emplace_back(new RunReader(runs[j], pool));
+                    sources.push_back(readers.back().get());
+                }
+                vector<Record> batch;
+                batch.reserve(BatchQueue::BATCH_SIZE);
+                merge(sources, [&](Record& record) {
+                    batch.emplace_back(std::move(record));
+                    if (batch.size() == BatchQueue::BATCH_SIZE) {
+                        queues[i].push(std::move(batch));
+                        batch.clear();
+                        batch.reserve(BatchQueue::BATCH_SIZE);
+                    }
+                });
+                if (!batch.empty()) {
+                    queues[i].push(std::move(batch));
+                }
+                // Say we are done.
+                queues[i].push(vector<Record>());
+            });
+        }
+
+        vector<Source*> sources;
+        for (auto& queue : queues) {
+            queue.start();
+            sources.push_back(&queue);
+        }
+        merge(sources, emit);
+
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    for (auto& run : runs) {
+        temp_file::remove(run);
+    }
+}
+
+void GAFSorter::stream_sort(const string& filename_in, ostream& stream_out) {
+
+    htsFile* in = hts_open(filename_in.c_str(), "r");
+    if (in == nullptr) {
+        cerr << "error[vg::GAFSorter]: could not open " << filename_in << endl;
+        exit(1);
+    }
+
+    // One pool compresses and decompresses for everyone.
+    size_t threads = max(omp_get_max_threads(), 1);
+    hts_tpool* pool = hts_tpool_init(threads);
+    if (pool != nullptr) {
+        htsThreadPool input_pool = {pool, 0};
+        // This only takes for compressed input, which is fine.
+        hts_set_opt(in, HTS_OPT_THREAD_POOL, &input_pool);
+    }
+
+    // Work out how much input there is, if we can.
+    size_t file_size = 0;
+    struct stat file_stats;
+    if (filename_in != "-" && stat(filename_in.c_str(), &file_stats) == 0) {
+        file_size = file_stats.st_size;
+    }
+    // Don't give an actual 0 to the progress code or it will NaN
+    create_progress("break into sorted chunks", file_size == 0 ? 1 : file_size);
+
+    vector<string> runs;
+    size_t total_records = 0;
+    size_t bytes_read = 0;
+
+    #pragma omp parallel
+    {
+        kstring_t line = {0, 0, nullptr};
+        while (true) {
+            vector<Record> buffer;
+
+            #pragma omp critical (gaf_input)
+            {
+                // Each thread fights for the file and the winner takes some data
+                size_t buffered_bytes = 0;
+                int status = 0;
+                while (buffered_bytes < max_buf_size && (status = hts_getline(in, KS_SEP_LINE, &line)) >= 0) {
+                    if (line.l == 0) {
+                        continue;
+                    }
+                    buffer.emplace_back();
+                    buffer.back().line.assign(line.s, line.l);
+                    buffered_bytes += line.l + sizeof(Record);
+                }
+                if (buffered_bytes < max_buf_size && status < -1) {
+                    cerr << "error[vg::GAFSorter]: could not read " << filename_in << endl;
+                    exit(1);
+                }
+                bytes_read += buffered_bytes;
+                update_progress(min(bytes_read, file_size));
+            }
+
+            if (buffer.empty()) {
+                break;
+            }
+
+            // Parsing keys can happen in parallel.
+            for (auto& record : buffer) {
+                record.key = get_key(record.line);
+            }
+            size_t record_count = buffer.size();
+            string run = write_run(buffer, pool);
+
+            #pragma omp critical (gaf_runs)
+            {
+                runs.push_back(run);
+                total_records += record_count;
+            }
+        }
+        free(line.s);
+    }
+
+    hts_close(in);
+    destroy_progress();
+
+    while (runs.size() > max_fan_in) {
+        // Too many runs to have open at once, so merge groups of them into
+        // bigger runs first. We do one group at a time to stay under the
+        // open file limit, but each group's merge is itself a parallel tree.
+        size_t group_count = (runs.size() + max_fan_in - 1) / max_fan_in;
+        create_progress("merge " + to_string(runs.size()) + " files", group_count);
+        vector<string> merged(group_count);
+        for (size_t i = 0; i < group_count; i++) {
+            vector<string> group(runs.begin() + i * max_fan_in,
+                                 runs.begin() + min(runs.size(), (i + 1) * max_fan_in));
+            merged[i] = merge_to_run(group, pool, threads);
+            update_progress(i + 1);
+        }
+        destroy_progress();
+        runs = std::move(merged);
+    }
+
+    // Merge the last layer, in a tree, into the output.
+    create_progress("merge " + to_string(runs.size()) + " files", total_records == 0 ? 1 : total_records);
+    size_t records_written = 0;
+    merge_runs(runs, pool, threads, [&](Record& record) {
+        stream_out.write(record.line.data(), record.line.size());
+        stream_out.put('\n');
+        update_progress(++records_written);
+    });
+    update_progress(total_records == 0 ? 1 : total_records);
+    destroy_progress();
+
+    if (!stream_out) {
+        cerr << "error[vg::GAFSorter]: could not write sorted GAF" << endl;
+        exit(1);
+    }
+
+    if (pool != nullptr) {
+        hts_tpool_destroy(pool);
+    }
+}
+
+void GAFSorter::easy_sort(const string& filename_in, ostream& stream_out) {
+    htsFile* in = hts_open(filename_in.c_str(), "r");
+    if (in == nullptr) {
+        cerr << "error[vg::GAFSorter]: could not open " << filename_in << endl;
+        exit(1);
+    }
+
+    vector<Record> records;
+    kstring_t line = {0, 0, nullptr};
+    int status = 0;
+    while ((status = hts_getline(in, KS_SEP_LINE, &line)) >= 0) {
+        if (line.l == 0) {
+            continue;
+        }
+        records.emplace_back();
+        records.back().line.assign(line.s, line.l);
+        records.back().key = get_key(records.back().line);
+    }
+    free(line.s);
+    if (status < -1) {
+        cerr << "error[vg::GAFSorter]: could not read " << filename_in << endl;
+        exit(1);
+    }
+    hts_close(in);
+
+    std::sort(records.begin(), records.end());
+
+    for (auto& record : records) {
+        stream_out.write(record.line.data(), record.line.size());
+        stream_out.put('\n');
+    }
+}
+
+}
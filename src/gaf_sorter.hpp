@@ -0,0 +1,124 @@
+#ifndef VG_GAF_SORTER_HPP_INCLUDED
+#define VG_GAF_SORTER_HPP_INCLUDED
+
+/**
+ * \file gaf_sorter.hpp
+ * Sorting for GAF text alignment files, in the same order as GAM sorting.
+ */
+
+#include "progressive.hpp"
+#include "types.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <htslib/bgzf.h>
+#include <htslib/thread_pool.h>
+
+namespace vg {
+using namespace std;
+
+/**
+ * Sorts GAF records by the minimum node ID they visit, like StreamSorter
+ * does for GAM, without needing the graph or converting to Protobuf.
+ *
+ * The streaming sort breaks the input into sorted runs in parallel and
+ * keeps them in BGZF-compressed temp files, compressed and decompressed by a
+ * shared htslib thread pool, which also reads ahead in each run. Runs are
+ * then merged in a tree: groups of runs are merged by their own threads,
+ * which feed a final merge that writes the output.
+ */
+class GAFSorter : public Progressive {
+public:
+
+    /// Create a GAF sorter, showing sort progress on standard error if
+    /// show_progress is true.
+    GAFSorter(bool show_progress = false);
+
+    /// Sort the GAF file with the given name ("-" for standard input), which
+    /// may be compressed, using temporary files, and write it to the given
+    /// stream as plain text.
+    void stream_sort(const string& filename_in, ostream& stream_out);
+
+    /// Sort the GAF file with the given name ("-" for standard input) in
+    /// memory, and write it to the given stream as plain text.
+    void easy_sort(const string& filename_in, ostream& stream_out);
+
+    /// Where a GAF record sorts. Matches the minimum Position that
+    /// StreamSorter would use for the same alignment as a GAM.
+    struct Key {
+        id_t node_id = 0;
+        bool is_reverse = false;
+        size_t offset = 0;
+
+        /// Order by node ID, then strand (forward first), then offset.
+        bool operator<(const Key& other) const;
+    };
+
+    /// Get the key of a GAF line. Unmapped records, and records whose path
+    /// isn't given as node IDs, get node 0 and sort first, like unmapped GAM
+    /// records.
+    static Key get_key(const string& line);
+
+    /// How many serialized bytes of records should each thread hold in memory
+    /// before writing a sorted run?
+    size_t max_buf_size = (512 * 1024 * 1024);
+
+    /// How many runs can we have open at once? The default stays well under
+    /// the usual limit of 1024 open files.
+    size_t max_fan_in = 256;
+
+private:
+
+    /// A GAF line and where it sorts.
+    struct Record {
+        Key key;
+        string line;
+
+        bool operator<(const Record& other) const;
+    };
+
+    /// Something we can merge records out of.
+    class Source {
+    public:
+        virtual ~Source() = default;
+        /// Is there a current record?
+        virtual bool has_current() const = 0;
+        /// Get the current record, which we are allowed to move from.
+        virtual Record& current() = 0;
+        /// Move on to the next record.
+        virtual void advance() = 0;
+    };
+
+    /// Source that reads a sorted run from a BGZF temp file.
+    class RunReader;
+
+    /// Source that takes batches of records from another thread.
+    class BatchQueue;
+
+    /// Sort records and write them to a new temp file, which is returned.
+    string write_run(vector<Record>& records, hts_tpool* pool) const;
+
+    /// Merge the records from all the given sources, in order, into the
+    /// given function.
+    static void merge(vector<Source*>& sources, const function<void(Record&)>& emit);
+
+    /// Merge the given runs to a single new run file, using up to the given
+    /// number of threads, and delete them.
+    string merge_to_run(const vector<string>& runs, hts_tpool* pool, size_t threads) const;
+
+    /// Merge the given runs into the given function, using up to the given
+    /// number of threads for a two-level merge tree. The runs are deleted.
+    void merge_runs(const vector<string>& runs, hts_tpool* pool, size_t threads,
+                    const function<void(Record&)>& emit) const;
+};
+
+}
+
+#endif
@@ -104,8 +104,15 @@ size_t GaplessExtension::overlap(const HandleGraph& graph, const GaplessExtensio
 }
 
 Path GaplessExtension::to_path(const HandleGraph& graph, const std::string& sequence) const {
-
     Path result;
+    this->to_path(graph, sequence, result);
+    return result;
+}
+
+void GaplessExtension::to_path(const HandleGraph& graph, const std::string& sequence, Path& result) const {
+
+    // Clearing keeps the Mappings and Edits around for reuse.
+    result.Clear();
 
     auto mismatch = this->mismatch_positions.begin(); // The next mismatch.
     size_t read_offset = this->read_interval.first;   // Current offset in the read.
@@ -125,7 +132,7 @@ Path GaplessExtension::to_path(const HandleGraph& graph, const std::string& sequ
             Edit& edit = *(mapping.add_edit());
             edit.set_from_length(1);
             edit.set_to_length(1);
-            edit.set_sequence(std::string(1, sequence[*mismatch]));
+            edit.set_sequence(sequence.data() + *mismatch, 1);
             read_offset = *mismatch + 1;
             ++mismatch;
         }
@@ -138,8 +145,6 @@ Path GaplessExtension::to_path(const HandleGraph& graph, const std::string& sequ
         mapping.set_rank(i + 1);
         node_offset = 0;
     }
-
-    return result;
 }
 
 //------------------------------------------------------------------------------
@@ -195,6 +200,27 @@ void set_score(GaplessExtension& extension, const Aligner* aligner) {
     extension.score += static_cast<int32_t>(extension.right_full * aligner->full_length_bonus);
 }
 
+// Sequences are compared a word at a time. In a word loaded from a string,
+// character i is in byte i, counting from the least significant end.
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "gapless matching assumes little-endian words");
+
+// Compare up to 8 characters packed in words. Returns a word with the high bit
+// set in each byte where the characters differ, and all other bits clear.
+inline std::uint64_t mismatching_bytes(std::uint64_t a, std::uint64_t b) {
+    constexpr std::uint64_t LOW_BITS = 0x7F7F7F7F7F7F7F7FULL;
+    std::uint64_t x = a ^ b;
+    // Adding to the low 7 bits carries into the high bit if any of them is set.
+    return (((x & LOW_BITS) + LOW_BITS) | x) & ~LOW_BITS;
+}
+
+// Index of the first / last differing character in a nonzero mismatching_bytes() word.
+inline size_t first_mismatch(std::uint64_t mismatches) {
+    return __builtin_ctzll(mismatches) / 8;
+}
+inline size_t last_mismatch(std::uint64_t mismatches) {
+    return 7 - __builtin_clzll(mismatches) / 8;
+}
+
 // Match the initial node, assuming that read_offset or node_offset is 0.
 // Updates internal_score and old_score; use set_score() to compute score.
 void match_initial(GaplessExtension& match, const std::string& seq, gbwtgraph::view_type target) {
@@ -205,18 +231,9 @@ void match_initial(GaplessExtension& match, const std::string& seq, gbwtgraph::v
         std::uint64_t a = 0, b = 0;
         std::memcpy(&a, seq.data() + match.read_interval.second, len);
         std::memcpy(&b, target.first + node_offset, len);
-        if (a == b) {
-            match.read_interval.second += len;
-            node_offset += len;
-        } else {
-            for (size_t i = 0; i < len; i++) {
-                if (seq[match.read_interval.second] != target.first[node_offset]) {
-                    match.internal_score++;
-                }
-                match.read_interval.second++;
-                node_offset++;
-            }
-        }
+        match.internal_score += __builtin_popcountll(mismatching_bytes(a, b));
+        match.read_interval.second += len;
+        node_offset += len;
         left -= len;
     }
     match.old_score = match.internal_score;
@@ -233,21 +250,21 @@ size_t match_forward(GaplessExtension& match, const std::string& seq, gbwtgraph:
         std::uint64_t a = 0, b = 0;
         std::memcpy(&a, seq.data() + match.read_interval.second, len);
         std::memcpy(&b, target.first + node_offset, len);
-        if (a == b) {
-            match.read_interval.second += len;
-            node_offset += len;
-        } else {
-            for (size_t i = 0; i < len; i++) {
-                if (seq[match.read_interval.second] != target.first[node_offset]) {
-                    if (match.internal_score + 1 >= mismatch_limit) {
-                        return node_offset;
-                    }
-                    match.internal_score++;
-                }
-                match.read_interval.second++;
-                node_offset++;
+        std::uint64_t mismatches = mismatching_bytes(a, b);
+        uint32_t count = __builtin_popcountll(mismatches);
+        if (count > 0 && match.internal_score + count >= mismatch_limit) {
+            // Some mismatch in this word reaches the limit. Stop before it.
+            while (match.internal_score + 1 < mismatch_limit) {
+                match.internal_score++;
+                mismatches &= mismatches - 1;
             }
+            size_t matched = first_mismatch(mismatches);
+            match.read_interval.second += matched;
+            return node_offset + matched;
         }
+        match.internal_score += count;
+        match.read_interval.second += len;
+        node_offset += len;
         left -= len;
     }
     return node_offset;
@@ -263,21 +280,23 @@ void match_backward(GaplessExtension& match, const std::string& seq, gbwtgraph::
         std::uint64_t a = 0, b = 0;
         std::memcpy(&a, seq.data() + match.read_interval.first - len, len);
         std::memcpy(&b, target.first + match.offset - len, len);
-        if (a == b) {
-            match.read_interval.first -= len;
-            match.offset -= len;
-        } else {
-            for (size_t i = 0; i < len; i++) {
-                if (seq[match.read_interval.first - 1] != target.first[match.offset - 1]) {
-                    if (match.internal_score + 1 >= mismatch_limit) {
-                        return;
-                    }
-                    match.internal_score++;
-                }
-                match.read_interval.first--;
-                match.offset--;
+        std::uint64_t mismatches = mismatching_bytes(a, b);
+        uint32_t count = __builtin_popcountll(mismatches);
+        if (count > 0 && match.internal_score + count >= mismatch_limit) {
+            // Some mismatch in this word reaches the limit. Going backward, we
+            // meet the mismatches from the last character down.
+            while (match.internal_score + 1 < mismatch_limit) {
+                match.internal_score++;
+                mismatches &= ~(std::uint64_t(0x80) << (8 * last_mismatch(mismatches)));
             }
+            size_t matched = len - 1 - last_mismatch(mismatches);
+            match.read_interval.first -= matched;
+            match.offset -= matched;
+            return;
         }
+        match.internal_score += count;
+        match.read_interval.first -= len;
+        match.offset -= len;
         left -= len;
     }
 }
@@ -361,12 +380,19 @@ void find_mismatches(const std::string& seq, const gbwtgraph::CachedGBWTGraph& g
         size_t node_offset = extension.offset, read_offset = extension.read_interval.first;
         for (const handle_t& handle : extension.path) {
             gbwtgraph::view_type target = graph.get_sequence_view(handle);
-            while (node_offset < target.second && read_offset < extension.read_interval.second) {
-                if (target.first[node_offset] != seq[read_offset]) {
-                    extension.mismatch_positions.push_back(read_offset);
+            size_t left = std::min(target.second - std::min(node_offset, target.second),
+                                   extension.read_interval.second - read_offset);
+            while (left > 0) {
+                size_t len = std::min(left, sizeof(std::uint64_t));
+                std::uint64_t a = 0, b = 0;
+                std::memcpy(&a, seq.data() + read_offset, len);
+                std::memcpy(&b, target.first + node_offset, len);
+                for (std::uint64_t mismatches = mismatching_bytes(a, b); mismatches != 0; mismatches &= mismatches - 1) {
+                    extension.mismatch_positions.push_back(read_offset + first_mismatch(mismatches));
                 }
-                node_offset++;
-                read_offset++;
+                node_offset += len;
+                read_offset += len;
+                left -= len;
             }
             node_offset = 0;
         }
@@ -517,6 +543,25 @@ bool trim_mismatches(GaplessExtension& extension, const gbwtgraph::CachedGBWTGra
 
 //------------------------------------------------------------------------------
 
+// Ask for the compressed GBWT record of the node to be brought into the CPU
+// cache, without waiting for it. Decompressing records the thread hasn't seen
+// lately is most of the cost of an extension step, so we ask for the records of
+// several independent searches before stepping any of them.
+static inline void prefetch_record(const gbwtgraph::CachedGBWTGraph& cache, gbwt::node_type node) {
+    const gbwt::GBWT& index = *(cache.graph->index);
+    if (index.contains(node)) {
+        __builtin_prefetch(index.bwt.data.data() + index.bwt.getRange(index.toComp(node)).first);
+    }
+}
+
+// The search for the best extension of one seed, which can be advanced one
+// step at a time alongside the searches for other seeds.
+struct SeedSearch {
+    GaplessExtension::seed_type seed;
+    GaplessExtension best_match;
+    std::priority_queue<GaplessExtension> extensions;
+};
+
 std::vector<GaplessExtension> GaplessExtender::extend(cluster_type& cluster, std::string sequence, const gbwtgraph::CachedGBWTGraph* cache, size_t max_mismatches, double overlap_threshold) const {
 
     std::vector<GaplessExtension> result;
@@ -532,149 +577,193 @@ std::vector<GaplessExtension> GaplessExtender::extend(cluster_type& cluster, std
         cache = new gbwtgraph::CachedGBWTGraph(*(this->graph));
     }
 
-    // Find the best extension starting from each seed.
+    // Check if the seed is contained in an exact full-length alignment.
     size_t best_alignment = std::numeric_limits<size_t>::max();
-    for (seed_type seed : cluster) {
-
-        // Check if the seed is contained in an exact full-length alignment.
-        if (best_alignment < result.size() && result[best_alignment].internal_score == 0) {
-            if (result[best_alignment].contains(*cache, seed)) {
-                continue;
-            }
-        }
+    auto is_contained = [&](const seed_type& seed) -> bool {
+        return (best_alignment < result.size() && result[best_alignment].internal_score == 0 &&
+                result[best_alignment].contains(*cache, seed));
+    };
 
-        GaplessExtension best_match {
+    // Match the initial node of the seed and add it to the queue.
+    auto start_search = [&](SeedSearch& search, const seed_type& seed) {
+        search.seed = seed;
+        search.best_match = GaplessExtension {
             { }, static_cast<size_t>(0), gbwt::BidirectionalState(),
             { static_cast<size_t>(0), static_cast<size_t>(0) }, { },
             std::numeric_limits<int32_t>::min(), false, false,
             false, false, std::numeric_limits<uint32_t>::max(), std::numeric_limits<uint32_t>::max()
         };
+        size_t read_offset = get_read_offset(seed);
+        size_t node_offset = get_node_offset(seed);
+        GaplessExtension match {
+            { seed.first }, node_offset, cache->get_bd_state(seed.first),
+            { read_offset, read_offset }, { },
+            static_cast<int32_t>(0), false, false,
+            false, false, static_cast<uint32_t>(0), static_cast<uint32_t>(0)
+        };
+        match_initial(match, sequence, cache->get_sequence_view(seed.first));
+        if (match.read_interval.first == 0) {
+            match.left_full = true;
+            match.left_maximal = true;
+        }
+        if (match.read_interval.second >= sequence.length()) {
+            match.right_full = true;
+            match.right_maximal = true;
+        }
+        set_score(match, this->aligner);
+        search.extensions.push(std::move(match));
+    };
 
-        // Match the initial node and add it to the queue.
-        std::priority_queue<GaplessExtension> extensions;
-        {
-            size_t read_offset = get_read_offset(seed);
-            size_t node_offset = get_node_offset(seed);
-            GaplessExtension match {
-                { seed.first }, node_offset, cache->get_bd_state(seed.first),
-                { read_offset, read_offset }, { },
-                static_cast<int32_t>(0), false, false,
-                false, false, static_cast<uint32_t>(0), static_cast<uint32_t>(0)
-            };
-            match_initial(match, sequence, cache->get_sequence_view(seed.first));
-            if (match.read_interval.first == 0) {
-                match.left_full = true;
-                match.left_maximal = true;
-            }
-            if (match.read_interval.second >= sequence.length()) {
-                match.right_full = true;
-                match.right_maximal = true;
+    // Extend the most promising extension in the search, using alignment
+    // scores for priority. First make the extension right-maximal and then
+    // left-maximal.
+    auto step_search = [&](SeedSearch& search) {
+        std::priority_queue<GaplessExtension>& extensions = search.extensions;
+        GaplessExtension curr = std::move(extensions.top());
+        extensions.pop();
+
+        // Case 1: Extend to the right.
+        if (!curr.right_maximal) {
+            size_t num_extensions = 0;
+            // Always allow at least max_mismatches / 2 mismatches in the current flank.
+            uint32_t mismatch_limit = std::max(
+                static_cast<uint32_t>(max_mismatches + 1),
+                static_cast<uint32_t>(max_mismatches / 2 + curr.old_score + 1));
+            cache->follow_paths(curr.state, false, [&](const gbwt::BidirectionalState& next_state) -> bool {
+                handle_t handle = gbwtgraph::GBWTGraph::node_to_handle(next_state.forward.node);
+                GaplessExtension next {
+                    { }, curr.offset, next_state,
+                    curr.read_interval, { },
+                    curr.score, curr.left_full, curr.right_full,
+                    curr.left_maximal, curr.right_maximal, curr.internal_score, curr.old_score
+                };
+                size_t node_offset = match_forward(next, sequence, cache->get_sequence_view(handle), mismatch_limit);
+                if (node_offset == 0) { // Did not match anything.
+                    return true;
+                }
+                next.path = get_path(curr.path, handle);
+                // Did the extension become right-maximal?
+                if (next.read_interval.second >= sequence.length()) {
+                    next.right_full = true;
+                    next.right_maximal = true;
+                    next.old_score = next.internal_score;
+                } else if (node_offset < cache->get_length(handle)) {
+                    next.right_maximal = true;
+                    next.old_score = next.internal_score;
+                }
+                set_score(next, this->aligner);
+                num_extensions += next.state.size();
+                extensions.push(std::move(next));
+                return true;
+            });
+            // We could not extend all threads in 'curr' to the right. The unextended ones
+            // may have different left extensions, so we must consider 'curr' right-maximal.
+            if (num_extensions < curr.state.size()) {
+                curr.right_maximal = true;
+                curr.old_score = curr.internal_score;
+                extensions.push(std::move(curr));
             }
-            set_score(match, this->aligner);
-            extensions.push(std::move(match));
-        }
-
-        // Extend the most promising extensions first, using alignment scores for priority.
-        // First make the extension right-maximal and then left-maximal.
-        while (!extensions.empty()) {
-            GaplessExtension curr = std::move(extensions.top());
-            extensions.pop();
-
-            // Case 1: Extend to the right.
-            if (!curr.right_maximal) {
-                size_t num_extensions = 0;
-                // Always allow at least max_mismatches / 2 mismatches in the current flank.
-                uint32_t mismatch_limit = std::max(
-                    static_cast<uint32_t>(max_mismatches + 1),
-                    static_cast<uint32_t>(max_mismatches / 2 + curr.old_score + 1));
-                cache->follow_paths(curr.state, false, [&](const gbwt::BidirectionalState& next_state) -> bool {
-                    handle_t handle = gbwtgraph::GBWTGraph::node_to_handle(next_state.forward.node);
-                    GaplessExtension next {
-                        { }, curr.offset, next_state,
-                        curr.read_interval, { },
-                        curr.score, curr.left_full, curr.right_full,
-                        curr.left_maximal, curr.right_maximal, curr.internal_score, curr.old_score
-                    };
-                    size_t node_offset = match_forward(next, sequence, cache->get_sequence_view(handle), mismatch_limit);
-                    if (node_offset == 0) { // Did not match anything.
-                        return true;
-                    }
-                    next.path = get_path(curr.path, handle);
-                    // Did the extension become right-maximal?
-                    if (next.read_interval.second >= sequence.length()) {
-                        next.right_full = true;
-                        next.right_maximal = true;
-                        next.old_score = next.internal_score;
-                    } else if (node_offset < cache->get_length(handle)) {
-                        next.right_maximal = true;
-                        next.old_score = next.internal_score;
-                    }
-                    set_score(next, this->aligner);
-                    num_extensions += next.state.size();
-                    extensions.push(std::move(next));
+            return;
+        }
+
+        // Case 2: Extend to the left.
+        if (!curr.left_maximal) {
+            bool found_extension = false;
+            // Always allow at least max_mismatches / 2 mismatches in the current flank.
+            uint32_t mismatch_limit = std::max(
+                static_cast<uint32_t>(max_mismatches + 1),
+                static_cast<uint32_t>(max_mismatches / 2 + curr.old_score + 1));
+            cache->follow_paths(curr.state, true, [&](const gbwt::BidirectionalState& next_state) -> bool {
+                handle_t handle = gbwtgraph::GBWTGraph::node_to_handle(gbwt::Node::reverse(next_state.backward.node));
+                size_t node_length = cache->get_length(handle);
+                GaplessExtension next {
+                    { }, node_length, next_state,
+                    curr.read_interval, { },
+                    curr.score, curr.left_full, curr.right_full,
+                    curr.left_maximal, curr.right_maximal, curr.internal_score, curr.old_score
+                };
+                match_backward(next, sequence, cache->get_sequence_view(handle), mismatch_limit);
+                if (next.offset >= node_length) { // Did not match anything.
                     return true;
-                });
-                // We could not extend all threads in 'curr' to the right. The unextended ones
-                // may have different left extensions, so we must consider 'curr' right-maximal.
-                if (num_extensions < curr.state.size()) {
-                    curr.right_maximal = true;
-                    curr.old_score = curr.internal_score;
-                    extensions.push(std::move(curr));
                 }
+                next.path = get_path(handle, curr.path);
+                // Did the extension become left-maximal?
+                if (next.read_interval.first == 0) {
+                    next.left_full = true;
+                    next.left_maximal = true;
+                    // No need to set old_score.
+                } else if (next.offset > 0) {
+                    next.left_maximal = true;
+                    // No need to set old_score.
+                }
+                set_score(next, this->aligner);
+                extensions.push(std::move(next));
+                found_extension = true;
+                return true;
+            });
+            if (!found_extension) {
+                curr.left_maximal = true;
+                // No need to set old_score.
+            } else {
+                return;
+            }
+        }
+
+        // Case 3: Maximal extension with a better score than the best extension so far.
+        if (search.best_match < curr) {
+            search.best_match = std::move(curr);
+        }
+    };
+
+    // Find the best extension starting from each seed. The searches for a few
+    // seeds at a time run in lockstep, so we can fetch the GBWT records all of
+    // them need next before decoding any, and the fetches overlap.
+    std::vector<SeedSearch> batch;
+    auto seed_iter = cluster.begin();
+    while (seed_iter != cluster.end()) {
+        batch.clear();
+        while (seed_iter != cluster.end() && batch.size() < LOCKSTEP_SEEDS) {
+            seed_type seed = *seed_iter;
+            ++seed_iter;
+            if (is_contained(seed)) {
                 continue;
             }
+            batch.emplace_back();
+            start_search(batch.back(), seed);
+        }
 
-            // Case 2: Extend to the left.
-            if (!curr.left_maximal) {
-                bool found_extension = false;
-                // Always allow at least max_mismatches / 2 mismatches in the current flank.
-                uint32_t mismatch_limit = std::max(
-                    static_cast<uint32_t>(max_mismatches + 1),
-                    static_cast<uint32_t>(max_mismatches / 2 + curr.old_score + 1));
-                cache->follow_paths(curr.state, true, [&](const gbwt::BidirectionalState& next_state) -> bool {
-                    handle_t handle = gbwtgraph::GBWTGraph::node_to_handle(gbwt::Node::reverse(next_state.backward.node));
-                    size_t node_length = cache->get_length(handle);
-                    GaplessExtension next {
-                        { }, node_length, next_state,
-                        curr.read_interval, { },
-                        curr.score, curr.left_full, curr.right_full,
-                        curr.left_maximal, curr.right_maximal, curr.internal_score, curr.old_score
-                    };
-                    match_backward(next, sequence, cache->get_sequence_view(handle), mismatch_limit);
-                    if (next.offset >= node_length) { // Did not match anything.
-                        return true;
+        bool active = !batch.empty();
+        while (active) {
+            if (batch.size() > 1) {
+                for (SeedSearch& search : batch) {
+                    if (search.extensions.empty()) {
+                        continue;
                     }
-                    next.path = get_path(handle, curr.path);
-                    // Did the extension become left-maximal?
-                    if (next.read_interval.first == 0) {
-                        next.left_full = true;
-                        next.left_maximal = true;
-                        // No need to set old_score.
-                    } else if (next.offset > 0) {
-                        next.left_maximal = true;
-                        // No need to set old_score.
+                    const GaplessExtension& next = search.extensions.top();
+                    if (!next.right_maximal) {
+                        prefetch_record(*cache, next.state.forward.node);
+                    } else if (!next.left_maximal) {
+                        prefetch_record(*cache, next.state.backward.node);
                     }
-                    set_score(next, this->aligner);
-                    extensions.push(std::move(next));
-                    found_extension = true;
-                    return true;
-                });
-                if (!found_extension) {
-                    curr.left_maximal = true;
-                    // No need to set old_score.
-                } else {
-                    continue;
                 }
             }
-
-            // Case 3: Maximal extension with a better score than the best extension so far.
-            if (best_match < curr) {
-                best_match = std::move(curr);
+            active = false;
+            for (SeedSearch& search : batch) {
+                if (!search.extensions.empty()) {
+                    step_search(search);
+                    active = true;
+                }
             }
         }
 
-        // Add the best match to the result and update the best_alignment offset.
-        if (!best_match.empty()) {
+        // Add the best matches to the result and update the best_alignment
+        // offset. A seed that an earlier seed in the batch already contains
+        // would not have been extended one seed at a time, so we drop it.
+        for (SeedSearch& search : batch) {
+            if (search.best_match.empty() || is_contained(search.seed)) {
+                continue;
+            }
+            GaplessExtension& best_match = search.best_match;
             if (best_match.full() && (best_alignment >= result.size() || best_match.internal_score < result[best_alignment].internal_score)) {
                 best_alignment = result.size();
             }
@@ -1052,6 +1141,12 @@ void WFAAlignment::join(const WFAAlignment& second) {
 //#define debug_path
 
 Path WFAAlignment::to_path(const HandleGraph& graph, const std::string& sequence) const {
+    Path result;
+    this->to_path(graph, sequence, result);
+    return result;
+}
+
+void WFAAlignment::to_path(const HandleGraph& graph, const std::string& sequence, Path& result) const {
 
     if (!*this) {
         throw std::runtime_error("WFAAlignment is not OK and cannot become a path");
@@ -1065,11 +1160,12 @@ Path WFAAlignment::to_path(const HandleGraph& graph, const std::string& sequence
         throw std::runtime_error("WFAAlignment extends past end of sequence");
     }
 
-    Path result;
+    // Clearing keeps the Mappings and Edits around for reuse.
+    result.Clear();
 
     if (this->path.empty()) {
         // Nothing to do!
-        return result;
+        return;
     }
 
     // Walk through the sequence
@@ -1152,7 +1248,7 @@ Path WFAAlignment::to_path(const HandleGraph& graph, const std::string& sequence
             if (sequence_cursor + length_to_resolve > this->seq_offset + this->length) {
                 throw std::runtime_error("WFAAlignment uses more sequence than provided");
             }
-            created->set_sequence(sequence.substr(sequence_cursor, length_to_resolve));
+            created->set_sequence(sequence.data() + sequence_cursor, length_to_resolve);
         }
         if (edit_type == match || edit_type == mismatch || edit_type == insertion) {
             // These edits consume some sequence
@@ -1211,8 +1307,6 @@ Path WFAAlignment::to_path(const HandleGraph& graph, const std::string& sequence
         std::cerr << " to edit " << (edit_it - edits.begin()) << " offset " << current_edit_used << " = path step " << (path_it - path.begin()) << " offset " << node_cursor << std::endl;
 #endif
     }
-
-    return result;
 }
 
 std::ostream& WFAAlignment::print(const HandleGraph& graph, std::ostream& out) const {
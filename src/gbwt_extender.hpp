@@ -85,6 +85,10 @@ struct GaplessExtension
     /// Convert the extension into a Path.
     Path to_path(const HandleGraph& graph, const std::string& sequence) const;
 
+    /// Convert the extension into the given Path, replacing its contents but
+    /// reusing its already-allocated Mappings and Edits.
+    void to_path(const HandleGraph& graph, const std::string& sequence, Path& result) const;
+
     /// For priority queues.
     bool operator<(const GaplessExtension& another) const {
         return (this->score < another.score);
@@ -102,6 +106,21 @@ struct GaplessExtension
     }
 };
 
+/**
+ * Match the read forward from read_interval.second against the target, starting
+ * from its beginning, and stop before the mismatch count (internal_score)
+ * reaches mismatch_limit. Returns the number of characters matched. Use
+ * set_score() to recompute the score.
+ */
+size_t match_forward(GaplessExtension& match, const std::string& seq, gbwtgraph::view_type target, uint32_t mismatch_limit);
+
+/**
+ * Match the read backward from read_interval.first against the target, ending
+ * at offset, and stop before the mismatch count (internal_score) reaches
+ * mismatch_limit. Updates read_interval.first and offset.
+ */
+void match_backward(GaplessExtension& match, const std::string& seq, gbwtgraph::view_type target, uint32_t mismatch_limit);
+
 //------------------------------------------------------------------------------
 
 /**
@@ -143,6 +162,9 @@ public:
     /// position pairs is at most this.
     constexpr static double OVERLAP_THRESHOLD = 0.8;
 
+    /// How many seeds extend() searches from in lockstep.
+    constexpr static size_t LOCKSTEP_SEEDS = 4;
+
     /// Create an empty GaplessExtender.
     GaplessExtender();
 
@@ -194,6 +216,9 @@ public:
      * Allow any number of mismatches in the initial node, at least
      * max_mismatches mismatches in the entire extension, and at least
      * max_mismatches / 2 mismatches on each flank.
+     * Seeds are extended LOCKSTEP_SEEDS at a time, one step of each search
+     * after another, so the GBWT records they need next can be fetched
+     * together. The results are the same as extending one seed at a time.
      * Use the provided CachedGBWTGraph or allocate a new one.
      */
     std::vector<GaplessExtension> extend(cluster_type& cluster, std::string sequence, const gbwtgraph::CachedGBWTGraph* cache = nullptr, \
@@ -299,6 +324,10 @@ struct WFAAlignment {
     /// Convert the WFAAlignment into a Path.
     Path to_path(const HandleGraph& graph, const std::string& sequence) const;
 
+    /// Convert the WFAAlignment into the given Path, replacing its contents
+    /// but reusing its already-allocated Mappings and Edits.
+    void to_path(const HandleGraph& graph, const std::string& sequence, Path& result) const;
+
     /// Prints some debug information about the alignment.
     std::ostream& print(const HandleGraph& graph, std::ostream& out) const;
     /// Prints some debug information about the alignment.
@@ -7,6 +7,7 @@
 
 #include <sstream>
 #include <unordered_map>
+#include <unordered_set>
 
 namespace vg {
 
@@ -442,6 +443,47 @@ std::vector<gbwt::size_type> threads_for_contig(const gbwt::GBWT& gbwt_index, co
     return std::vector<gbwt::size_type>();
 }
 
+/// Get the number of threads / gbwt paths in the GBWT.
+static gbwt::size_type gbwt_thread_count(const gbwt::GBWT& gbwt_index) {
+    return gbwt_index.bidirectional() ? gbwt_index.sequences() / 2 : gbwt_index.sequences();
+}
+
+/// Get a name for a thread that identifies it across GBWTs with different
+/// sample and contig ids.
+static std::string thread_key(const gbwt::Metadata& metadata, gbwt::size_type id) {
+    const gbwt::PathName& path = metadata.path(id);
+    std::string key = metadata.hasSampleNames() ? metadata.sample(path.sample) : std::to_string(path.sample);
+    key += '\0';
+    key += metadata.hasContigNames() ? metadata.contig(path.contig) : std::to_string(path.contig);
+    key += '\0';
+    key += std::to_string(path.phase);
+    key += '\0';
+    key += std::to_string(path.count);
+    return key;
+}
+
+std::vector<gbwt::size_type> new_threads(const gbwt::GBWT& old_index, const gbwt::GBWT& new_index) {
+    std::vector<gbwt::size_type> result;
+    if (old_index.hasMetadata() && old_index.metadata.hasPathNames() &&
+        new_index.hasMetadata() && new_index.metadata.hasPathNames()) {
+        std::unordered_set<std::string> old_keys;
+        old_keys.reserve(old_index.metadata.paths());
+        for (gbwt::size_type id = 0; id < old_index.metadata.paths(); id++) {
+            old_keys.insert(thread_key(old_index.metadata, id));
+        }
+        for (gbwt::size_type id = 0; id < new_index.metadata.paths(); id++) {
+            if (!old_keys.count(thread_key(new_index.metadata, id))) {
+                result.push_back(id);
+            }
+        }
+    } else {
+        for (gbwt::size_type id = gbwt_thread_count(old_index); id < gbwt_thread_count(new_index); id++) {
+            result.push_back(id);
+        }
+    }
+    return result;
+}
+
 std::string insert_gbwt_path(MutablePathHandleGraph& graph, const gbwt::GBWT& gbwt_index, gbwt::size_type id, std::string path_name) {
 
     gbwt::size_type sequence_id = gbwt_index.bidirectional() ? gbwt::Path::encode(id, false) : id;
@@ -225,6 +225,12 @@ std::vector<gbwt::size_type> threads_for_sample(const gbwt::GBWT& gbwt_index, co
 /// Return the list of thread ids / gbwt path ids for the given contig.
 std::vector<gbwt::size_type> threads_for_contig(const gbwt::GBWT& gbwt_index, const std::string& contig_name);
 
+/// Return the list of thread ids / gbwt path ids in new_index that are not in
+/// old_index. Threads are matched by their sample, contig, phase, and count
+/// when both indexes have path names. Otherwise the threads of new_index are
+/// assumed to start with those of old_index.
+std::vector<gbwt::size_type> new_threads(const gbwt::GBWT& old_index, const gbwt::GBWT& new_index);
+
 /// Insert a GBWT thread into the graph and return its name. Returns an empty string on failure.
 /// If a path name is specified and not empty, that name will be used for the inserted path.
 /// NOTE: id is a gbwt path id, not a gbwt sequence id.
@@ -3,6 +3,10 @@
 
 #include <vg/io/vpkg.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <sstream>
+
 namespace vg {
 
 //------------------------------------------------------------------------------
@@ -151,6 +155,226 @@ void save_minimizer(const gbwtgraph::DefaultMinimizerIndex& index, const std::st
 
 //------------------------------------------------------------------------------
 
+void index_haplotype_threads(const gbwtgraph::GBWTGraph& graph, const std::vector<gbwt::size_type>& threads, bool rymer,
+                             gbwtgraph::DefaultMinimizerIndex& index,
+                             const std::function<gbwtgraph::payload_type(const pos_t&)>& get_payload,
+                             size_t segment_bp) {
+
+    typedef gbwtgraph::DefaultMinimizerIndex::minimizer_type minimizer_type;
+
+    // Break the threads into segments. Each segment starts with enough of the
+    // end of the previous one that every window of the thread falls entirely
+    // within some segment.
+    size_t overlap = index.window_bp() - 1;
+    std::vector<std::vector<handle_t>> segments;
+    for (gbwt::size_type thread : threads) {
+        gbwt::size_type sequence = graph.index->bidirectional() ? gbwt::Path::encode(thread, false) : thread;
+        if (sequence >= graph.index->sequences()) {
+            std::cerr << "error: [index_haplotype_threads()] invalid path id: " << thread << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+        std::vector<handle_t> segment;
+        size_t segment_length = 0;
+        for (gbwt::node_type node : graph.index->extract(sequence)) {
+            handle_t handle = gbwtgraph::GBWTGraph::node_to_handle(node);
+            segment.push_back(handle);
+            segment_length += graph.get_length(handle);
+            if (segment_length >= segment_bp) {
+                // Carry the last nodes over into the next segment.
+                size_t carried = 0, carried_length = 0;
+                while (carried < segment.size() && carried_length < overlap) {
+                    carried_length += graph.get_length(segment[segment.size() - carried - 1]);
+                    carried++;
+                }
+                std::vector<handle_t> next(segment.end() - carried, segment.end());
+                segments.emplace_back(std::move(segment));
+                segment = std::move(next);
+                segment_length = carried_length;
+            }
+        }
+        if (!segment.empty()) {
+            segments.emplace_back(std::move(segment));
+        }
+    }
+
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (size_t i = 0; i < segments.size(); i++) {
+        const std::vector<handle_t>& traversal = segments[i];
+        std::string seq;
+        for (const handle_t& handle : traversal) {
+            seq += graph.get_sequence(handle);
+        }
+
+        // Find the minimizers and their graph positions, as in index_haplotypes().
+        std::vector<std::pair<minimizer_type, pos_t>> hits;
+        auto iter = traversal.begin();
+        size_t node_start = 0;
+        for (minimizer_type& minimizer : index.minimizers(seq, rymer)) {
+            if (minimizer.empty()) {
+                continue;
+            }
+            size_t node_length = graph.get_length(*iter);
+            while (node_start + node_length <= minimizer.offset) {
+                node_start += node_length;
+                ++iter;
+                node_length = graph.get_length(*iter);
+            }
+            pos_t pos { graph.get_id(*iter), graph.get_is_reverse(*iter), minimizer.offset - node_start };
+            if (minimizer.is_reverse) {
+                pos = reverse_base_pos(pos, node_length);
+            }
+            if (!gbwtgraph::Position::valid_offset(pos)) {
+                #pragma omp critical (cerr)
+                std::cerr << "error: [index_haplotype_threads()] node offset " << offset(pos) << " is too large" << std::endl;
+                std::exit(EXIT_FAILURE);
+            }
+            hits.emplace_back(minimizer, pos);
+        }
+        gbwt::removeDuplicates(hits, false);
+
+        std::vector<gbwtgraph::payload_type> payloads;
+        if (!rymer) {
+            payloads.reserve(hits.size());
+            for (auto& hit : hits) {
+                payloads.push_back(get_payload(hit.second));
+            }
+        }
+
+        #pragma omp critical (minimizer_index)
+        {
+            for (size_t j = 0; j < hits.size(); j++) {
+                if (rymer) {
+                    index.insert(hits[j].first, hits[j].second, { hits[j].first.original_kmer_key.get_key(), 42 });
+                } else {
+                    index.insert(hits[j].first, hits[j].second, payloads[j]);
+                }
+            }
+        }
+    }
+}
+
+void recompute_payloads(gbwtgraph::DefaultMinimizerIndex& index,
+                        const std::function<gbwtgraph::payload_type(const pos_t&)>& get_payload) {
+
+    typedef gbwtgraph::DefaultMinimizerIndex::key_type key_type;
+    typedef gbwtgraph::DefaultMinimizerIndex::minimizer_type minimizer_type;
+
+    // Collect the hits, so that the payloads can be computed in parallel.
+    std::vector<std::pair<key_type, gbwtgraph::hit_type>> hits;
+    hits.reserve(index.values());
+    index.for_each_kmer([&](const gbwtgraph::DefaultMinimizerIndex::cell_type& cell) -> bool {
+        if (cell.first.is_pointer()) {
+            for (const gbwtgraph::hit_type& hit : *(cell.second.pointer)) {
+                hits.emplace_back(cell.first, hit);
+            }
+        } else {
+            hits.emplace_back(cell.first, cell.second.value);
+        }
+        return true;
+    });
+
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (size_t i = 0; i < hits.size(); i++) {
+        hits[i].second.payload = get_payload(gbwtgraph::Position::decode(hits[i].second.pos));
+    }
+
+    // insert() never replaces a payload, so the hits go into a new index.
+    gbwtgraph::DefaultMinimizerIndex result(index.k(), (index.uses_syncmers() ? index.s() : index.w()), index.uses_syncmers());
+    for (auto& hit : hits) {
+        minimizer_type minimizer;
+        minimizer.key = hit.first;
+        minimizer.hash = hit.first.hash();
+        minimizer.offset = 0;
+        minimizer.is_reverse = false;
+        result.insert(minimizer, hit.second.pos, hit.second.payload);
+    }
+    index.swap(result);
+}
+
+/// Is every node and edge of subgraph also in graph, with the same sequence?
+static bool contains_graph(const gbwtgraph::GBWTGraph& graph, const gbwtgraph::GBWTGraph& subgraph) {
+    std::atomic<bool> contained(true);
+    subgraph.for_each_handle([&](const handle_t& handle) -> bool {
+        nid_t id = subgraph.get_id(handle);
+        if (!graph.has_node(id) || graph.get_sequence(graph.get_handle(id, false)) != subgraph.get_sequence(handle)) {
+            contained = false;
+            return false;
+        }
+        auto translate = [&](const handle_t& other) -> handle_t {
+            return graph.get_handle(subgraph.get_id(other), subgraph.get_is_reverse(other));
+        };
+        handle_t here = translate(handle);
+        subgraph.follow_edges(handle, false, [&](const handle_t& next) -> bool {
+            if (!graph.has_edge(here, translate(next))) {
+                contained = false;
+            }
+            return contained.load();
+        });
+        subgraph.follow_edges(handle, true, [&](const handle_t& prev) -> bool {
+            if (!graph.has_edge(translate(prev), here)) {
+                contained = false;
+            }
+            return contained.load();
+        });
+        return contained.load();
+    }, true);
+    return contained;
+}
+
+std::vector<gbwt::size_type> find_update_threads(const gbwtgraph::GBZ& gbz, const std::string& previous_name, bool show_progress) {
+    if (show_progress) {
+        std::cerr << "Loading previous haplotypes from " << previous_name << std::endl;
+    }
+    auto previous = vg::io::VPKG::try_load_first<gbwtgraph::GBZ, gbwt::GBWT>(previous_name);
+    if (std::get<1>(previous)) {
+        std::cerr << "error: [find_update_threads()] " << previous_name << " is a GBWT without a graph; "
+                  << "use the GBZ the index was built from, so that the graphs can be compared" << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+    if (!std::get<0>(previous)) {
+        std::cerr << "error: [find_update_threads()] cannot load GBZ " << previous_name << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+    if (!contains_graph(gbz.graph, std::get<0>(previous)->graph)) {
+        std::cerr << "error: [find_update_threads()] the graph in " << previous_name << " is not part of the input graph; "
+                  << "the index must be rebuilt" << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+
+    std::vector<gbwt::size_type> result = new_threads(std::get<0>(previous)->index, gbz.index);
+    if (show_progress) {
+        std::cerr << "Found " << result.size() << " new haplotype threads" << std::endl;
+    }
+    return result;
+}
+
+void dump_minimizer(const gbwtgraph::DefaultMinimizerIndex& index, std::ostream& out) {
+    std::vector<std::string> lines;
+    auto add_hit = [&](gbwtgraph::DefaultMinimizerIndex::key_type key, const gbwtgraph::hit_type& hit) {
+        pos_t pos = gbwtgraph::Position::decode(hit.pos);
+        std::stringstream line;
+        line << key.get_key() << "\t" << id(pos) << "\t" << (is_rev(pos) ? "-" : "+") << "\t" << offset(pos)
+             << "\t" << hit.payload.first << "\t" << hit.payload.second;
+        lines.push_back(line.str());
+    };
+    index.for_each_kmer([&](const gbwtgraph::DefaultMinimizerIndex::cell_type& cell) -> bool {
+        if (cell.first.is_pointer()) {
+            for (const gbwtgraph::hit_type& hit : *(cell.second.pointer)) {
+                add_hit(cell.first, hit);
+            }
+        } else {
+            add_hit(cell.first, cell.second.value);
+        }
+        return true;
+    });
+    std::sort(lines.begin(), lines.end());
+    for (const std::string& line : lines) {
+        out << line << "\n";
+    }
+}
+
+//------------------------------------------------------------------------------
+
 /// Return a mapping of the original segment ids to a list of chopped node ids
 /// (mimicking logic and interface from function of same name in gbwt_helper.cpp)
 unordered_map<string, vector<nid_t>> load_translation_map(const gbwtgraph::GBWTGraph& graph) {
@@ -9,6 +9,9 @@
 #include <gbwtgraph/gbz.h>
 #include <gbwtgraph/minimizer.h>
 #include "position.hpp"
+#include <functional>
+#include <ostream>
+#include <string>
 #include <unordered_map>
 #include <vector>
 
@@ -60,6 +63,56 @@ void save_minimizer(const gbwtgraph::DefaultMinimizerIndex& index, const std::st
 
 //------------------------------------------------------------------------------
 
+/**
+ * Insert the minimizers (or RYmers, if rymer is set) of the given GBWT threads
+ * / gbwt path ids into an existing index, like gbwtgraph::index_haplotypes()
+ * does for all the haplotypes in the graph. This lets an index be updated
+ * when new haplotypes are added to the GBWT without scanning the old ones
+ * again. That scan is all it saves: the distance index is not updated, and
+ * the payloads of the old hits still have to be recomputed from a distance
+ * index built for the new graph.
+ * Positions already in the index are not inserted again, so windows the new
+ * threads share with the old ones are harmless. Payloads are only computed
+ * for positions on the new threads.
+ *
+ * Threads are broken into overlapping segments of about segment_bp bases,
+ * which are indexed in parallel. The number of threads can be set through OMP.
+ */
+void index_haplotype_threads(const gbwtgraph::GBWTGraph& graph, const std::vector<gbwt::size_type>& threads, bool rymer,
+                             gbwtgraph::DefaultMinimizerIndex& index,
+                             const std::function<gbwtgraph::payload_type(const pos_t&)>& get_payload,
+                             size_t segment_bp = 1024 * 1024);
+
+/**
+ * Replace the payload of every hit in the index with get_payload() of its
+ * position. Payloads from a distance index describe the whole snarl
+ * decomposition of the graph, so they go stale when nodes or edges are added
+ * and must be recomputed before an updated index can be used with the new
+ * distance index. The payloads are computed in parallel, with the number of
+ * threads set through OMP.
+ */
+void recompute_payloads(gbwtgraph::DefaultMinimizerIndex& index,
+                        const std::function<gbwtgraph::payload_type(const pos_t&)>& get_payload);
+
+/**
+ * Find the threads of the GBZ that are not in the GBZ in file previous_name,
+ * so that a minimizer index built from the previous haplotypes can be brought
+ * up to date with index_haplotype_threads(). The positions already in the
+ * index only stay valid if every node and edge of the previous graph is also
+ * in the new graph, with the same sequence, so that is checked first. Any
+ * distance payloads must still be recomputed with recompute_payloads(). A
+ * bare GBWT has no sequences to check and is rejected. Exits with an
+ * error if the previous haplotypes cannot be used.
+ */
+std::vector<gbwt::size_type> find_update_threads(const gbwtgraph::GBZ& gbz, const std::string& previous_name, bool show_progress = false);
+
+/// Write the hits in the minimizer index as sorted lines of text with the key,
+/// the position, and the payload, so that two indexes can be compared by their
+/// contents instead of by the layouts of their hash tables.
+void dump_minimizer(const gbwtgraph::DefaultMinimizerIndex& index, std::ostream& out);
+
+//------------------------------------------------------------------------------
+
 /// Return a mapping of the original segment ids to a list of chopped node ids
 std::unordered_map<std::string, std::vector<nid_t>> load_translation_map(const gbwtgraph::GBWTGraph& graph);
 
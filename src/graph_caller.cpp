@@ -16,13 +16,9 @@ GraphCaller::~GraphCaller() {
 
 void GraphCaller::call_top_level_snarls(const HandleGraph& graph, RecurseType recurse_type) {
 
-    // Used to recurse on children of parents that can't be called
-    size_t thread_count = get_thread_count();
-    vector<vector<const Snarl*>> snarl_queue(thread_count);
-
-    // Run the snarl caller on a snarl, and queue up the children if it fails
+    // Run the snarl caller on a snarl, and return the children to recurse on if it fails
     auto process_snarl = [&](const Snarl* snarl) {
-
+        vector<const Snarl*> to_recurse;
         if (!snarl_manager.is_trivial(snarl, graph)) {
 
 #ifdef debug
@@ -31,32 +27,52 @@ void GraphCaller::call_top_level_snarls(const HandleGraph& graph, RecurseType re
 
             bool was_called = call_snarl(*snarl);
             if (recurse_type == RecurseAlways || (!was_called && recurse_type == RecurseOnFail)) {
-                const vector<const Snarl*>& children = snarl_manager.children_of(snarl);
-                vector<const Snarl*>& thread_queue = snarl_queue[omp_get_thread_num()];
-                thread_queue.insert(thread_queue.end(), children.begin(), children.end());
+                to_recurse = snarl_manager.children_of(snarl);
             }
         }
+        return to_recurse;
     };
 
-    // Start with the top level snarls
-    snarl_manager.for_each_top_level_snarl_parallel(process_snarl);
-
-    // Then recurse on any children the snarl caller failed to handle
-    while (!std::all_of(snarl_queue.begin(), snarl_queue.end(),
-                        [](const vector<const Snarl*>& snarl_vec) {return snarl_vec.empty();})) {
-        vector<const Snarl*> cur_queue;
-        for (vector<const Snarl*>& thread_queue : snarl_queue) {
-            cur_queue.reserve(cur_queue.size() + thread_queue.size());
-            std::move(thread_queue.begin(), thread_queue.end(), std::back_inserter(cur_queue));
-            thread_queue.clear();
+    // Snarl costs are very skewed, so rather than a parallel loop over each
+    // level of the snarl tree, every snarl gets its own task.  The most
+    // expensive are started first, and children are started as soon as their
+    // parent is done, so the OpenMP runtime can keep every thread busy.
+    function<void(const vector<const Snarl*>&)> spawn_tasks = [&](const vector<const Snarl*>& snarls) {
+        for (const Snarl* snarl : by_decreasing_cost(snarls, [&](const Snarl* snarl) {
+                    return estimate_cost(snarl);
+                })) {
+#pragma omp task firstprivate(snarl)
+            {
+                vector<const Snarl*> children = process_snarl(snarl);
+                if (!children.empty()) {
+                    spawn_tasks(children);
+                }
+            }
         }
+    };
 
-#pragma omp parallel for schedule(dynamic, 1)
-        for (int i = 0; i < cur_queue.size(); ++i) {
-            process_snarl(cur_queue[i]);
+#pragma omp parallel
+    {
+#pragma omp single
+        {
+            spawn_tasks(snarl_manager.top_level_snarls());
         }
     }
-  
+}
+
+size_t GraphCaller::estimate_cost(const Snarl* snarl) const {
+    // Node IDs are normally in topological order, so the ID span stands in
+    // for the size, and the children for the number of traversals.
+    size_t id_span = std::abs(snarl->end().node_id() - snarl->start().node_id()) + 1;
+    return id_span * (snarl_manager.children_of(snarl).size() + 1);
+}
+
+size_t GraphCaller::estimate_cost(const Chain& chain) const {
+    size_t cost = 0;
+    for (auto& link : chain) {
+        cost += estimate_cost(link.first);
+    }
+    return cost;
 }
 
 static void flip_snarl(Snarl& snarl) {
@@ -66,67 +82,79 @@ static void flip_snarl(Snarl& snarl) {
 }
 
 void GraphCaller::call_top_level_chains(const HandleGraph& graph, size_t max_edges, size_t max_trivial, RecurseType recurse_type) {
-    // Used to recurse on children of parents that can't be called
-    size_t thread_count = get_thread_count();
-    vector<vector<Chain>> chain_queue(thread_count);
-
-    // Run the snarl caller on a chain. queue up the children if it fails
-    auto process_chain = [&](const Chain* chain) {
 
-#ifdef debug
-        cerr << "calling top level chain ";
-        for (const auto& i : *chain) {
-            cerr << pb2json(*i.first) << "," << i.second << ",";
-        }
-        cerr << endl;
-#endif
-        // Break up the chain
-        vector<Chain> chain_pieces = break_chain(graph, *chain, max_edges, max_trivial);
-
-        for (Chain& chain_piece : chain_pieces) {
-            // Make a fake snarl spanning the chain
-            // It is important to remember that along with not actually being a snarl,
-            // it's not managed by the snarl manager so functions looking into its nesting
-            // structure will not work
-            Snarl fake_snarl;
-            *fake_snarl.mutable_start() = chain_piece.front().second == true ? reverse(chain_piece.front().first->end()) :
-                chain_piece.front().first->start();
-            *fake_snarl.mutable_end() = chain_piece.back().second == true ? reverse(chain_piece.back().first->start()) :
-                chain_piece.back().first->end();
+    // Run the snarl caller on a piece of a chain, and return the child chains to recurse on if it fails
+    auto process_chain_piece = [&](const Chain& chain_piece) {
+        vector<const Chain*> to_recurse;
+        
+        // Make a fake snarl spanning the chain
+        // It is important to remember that along with not actually being a snarl,
+        // it's not managed by the snarl manager so functions looking into its nesting
+        // structure will not work
+        Snarl fake_snarl;
+        *fake_snarl.mutable_start() = chain_piece.front().second == true ? reverse(chain_piece.front().first->end()) :
+            chain_piece.front().first->start();
+        *fake_snarl.mutable_end() = chain_piece.back().second == true ? reverse(chain_piece.back().first->start()) :
+            chain_piece.back().first->end();
 
 #ifdef debug
-            cerr << "calling fake snarl " << pb2json(fake_snarl) << endl;
+        cerr << "calling fake snarl " << pb2json(fake_snarl) << endl;
 #endif
             
-            bool was_called = call_snarl(fake_snarl);
-            if (recurse_type == RecurseAlways || (!was_called && recurse_type == RecurseOnFail)) {
-                vector<Chain>& thread_queue = chain_queue[omp_get_thread_num()];                
-                for (pair<const Snarl*, bool> chain_link : chain_piece) {
-                    const deque<Chain>& child_chains = snarl_manager.chains_of(chain_link.first);
-                    thread_queue.insert(thread_queue.end(), child_chains.begin(), child_chains.end());
+        bool was_called = call_snarl(fake_snarl);
+        if (recurse_type == RecurseAlways || (!was_called && recurse_type == RecurseOnFail)) {
+            for (pair<const Snarl*, bool> chain_link : chain_piece) {
+                for (const Chain& child_chain : snarl_manager.chains_of(chain_link.first)) {
+                    to_recurse.push_back(&child_chain);
                 }
             }
         }
+        return to_recurse;
     };
 
-    // Start with the top level snarls
-    snarl_manager.for_each_top_level_chain_parallel(process_chain);
-
-    // Then recurse on any children the snarl caller failed to handle
-    while (!std::all_of(chain_queue.begin(), chain_queue.end(),
-                        [](const vector<Chain>& chain_vec) {return chain_vec.empty();})) {
-        vector<Chain> cur_queue;
-        for (vector<Chain>& thread_queue : chain_queue) {
-            cur_queue.reserve(cur_queue.size() + thread_queue.size());
-            std::move(thread_queue.begin(), thread_queue.end(), std::back_inserter(cur_queue));
-            thread_queue.clear();
+    // Like for snarls, every chain is a task, most expensive first, and each
+    // piece of a chain is a subtask, so one big chain doesn't hold up a thread.
+    function<void(const vector<const Chain*>&)> spawn_tasks = [&](const vector<const Chain*>& chains) {
+        for (const Chain* chain : by_decreasing_cost(chains, [&](const Chain* chain) {
+                    return estimate_cost(*chain);
+                })) {
+#pragma omp task firstprivate(chain)
+            {
+#ifdef debug
+                cerr << "calling chain ";
+                for (const auto& i : *chain) {
+                    cerr << pb2json(*i.first) << "," << i.second << ",";
+                }
+                cerr << endl;
+#endif
+                // Break up the chain
+                vector<Chain> chain_pieces = break_chain(graph, *chain, max_edges, max_trivial);
+                for (Chain& chain_piece : by_decreasing_cost(chain_pieces, [&](const Chain& piece) {
+                            return estimate_cost(piece);
+                        })) {
+#pragma omp task firstprivate(chain_piece)
+                    {
+                        vector<const Chain*> children = process_chain_piece(chain_piece);
+                        if (!children.empty()) {
+                            spawn_tasks(children);
+                        }
+                    }
+                }
+            }
         }
+    };
 
-#pragma omp parallel for schedule(dynamic, 1)
-        for (int i = 0; i < cur_queue.size(); ++i) {
-            process_chain(&cur_queue[i]);
-        }
+    vector<const Chain*> top_level_chains;
+    snarl_manager.for_each_top_level_chain([&](const Chain* chain) {
+            top_level_chains.push_back(chain);
+        });
     
+#pragma omp parallel
+    {
+#pragma omp single
+        {
+            spawn_tasks(top_level_chains);
+        }
     }
 }
 
@@ -233,7 +261,8 @@ void VCFOutputCaller::write_variants(ostream& out_stream, const SnarlManager* sn
     }
     std::sort(all_variants.begin(), all_variants.end(), [](const pair<pair<string, size_t>, string>& v1,
                                                            const pair<pair<string, size_t>, string>& v2) {
-            return v1.first.first < v2.first.first || (v1.first.first == v2.first.first && v1.first.second < v2.first.second);
+            // break ties on the record itself, so the order doesn't depend on thread scheduling
+            return v1.first < v2.first || (v1.first == v2.first && v1.second < v2.second);
         });
     for (auto v : all_variants) {
         string dest;
@@ -55,6 +55,15 @@ protected:
 
     /// Break up a chain into bits that we want to call using size heuristics
     vector<Chain> break_chain(const HandleGraph& graph, const Chain& chain, size_t max_edges, size_t max_trivial);
+
+    /// Estimate how long it will take to call a snarl, for scheduling
+    size_t estimate_cost(const Snarl* snarl) const;
+    /// Estimate how long it will take to call a chain, for scheduling
+    size_t estimate_cost(const Chain& chain) const;
+
+    /// Get a copy of the given items, sorted with the most expensive first
+    template<typename Item, typename CostFunction>
+    static vector<Item> by_decreasing_cost(const vector<Item>& items, const CostFunction& cost);
     
 protected:
 
@@ -576,6 +585,25 @@ protected:
 };
 
 
+template<typename Item, typename CostFunction>
+vector<Item> GraphCaller::by_decreasing_cost(const vector<Item>& items, const CostFunction& cost) {
+    vector<pair<size_t, size_t>> costs;
+    costs.reserve(items.size());
+    for (size_t i = 0; i < items.size(); ++i) {
+        costs.emplace_back(cost(items[i]), i);
+    }
+    // ties stay in their original order
+    std::stable_sort(costs.begin(), costs.end(), [](const pair<size_t, size_t>& a, const pair<size_t, size_t>& b) {
+            return a.first > b.first;
+        });
+    vector<Item> sorted;
+    sorted.reserve(items.size());
+    for (auto& item_cost : costs) {
+        sorted.push_back(items[item_cost.second]);
+    }
+    return sorted;
+}
+
 }
 
 #endif
@@ -5,6 +5,7 @@
  */
 
 #include "hts_alignment_emitter.hpp"
+#include "hts_duplicate_marker.hpp"
 #include "surjecting_alignment_emitter.hpp"
 #include "back_translating_alignment_emitter.hpp"
 #include "alignment.hpp"
@@ -22,7 +23,7 @@ using namespace std;
 
 unique_ptr<AlignmentEmitter> get_alignment_emitter(const string& filename, const string& format,
                                                    const vector<tuple<path_handle_t, size_t, size_t>>& paths, size_t max_threads,
-                                                   const HandleGraph* graph, int flags) {
+                                                   const HandleGraph* graph, int flags, const HTSOutputOptions& hts_options) {
 
     
     unique_ptr<AlignmentEmitter> emitter;
@@ -44,12 +45,15 @@ unique_ptr<AlignmentEmitter> get_alignment_emitter(const string& filename, const
         unordered_map<string, int64_t> subpath_to_length;
         std::tie(path_names_and_lengths, subpath_to_length) = extract_path_metadata(paths, *path_graph, true);
     
+        bool sort = flags & ALIGNMENT_EMITTER_FLAG_HTS_SORT;
         if (flags & ALIGNMENT_EMITTER_FLAG_HTS_SPLICED) {
             // Use a splicing emitter as the final emitter
-            emitter = make_unique<SplicedHTSAlignmentEmitter>(filename, format, path_names_and_lengths, subpath_to_length, *path_graph, max_threads);
+            emitter = make_unique<SplicedHTSAlignmentEmitter>(filename, format, path_names_and_lengths, subpath_to_length, *path_graph, max_threads,
+                                                              sort, hts_options);
         } else {
             // Use a normal emitter
-            emitter = make_unique<HTSAlignmentEmitter>(filename, format, path_names_and_lengths, subpath_to_length, max_threads);
+            emitter = make_unique<HTSAlignmentEmitter>(filename, format, path_names_and_lengths, subpath_to_length, max_threads,
+                                                       sort, hts_options);
         }
         
         if (!(flags & ALIGNMENT_EMITTER_FLAG_HTS_RAW)) {
@@ -425,13 +429,16 @@ const size_t HTSWriter::BGZF_FOOTER_LENGTH = 28;
 HTSWriter::HTSWriter(const string& filename, const string& format,
     const vector<pair<string, int64_t>>& path_order_and_length,
     const unordered_map<string, int64_t>& subpath_to_length,
-    size_t max_threads) :
+    size_t max_threads, bool sort, const HTSOutputOptions& options) :
     out_file(filename == "-" ? nullptr : new ofstream(filename)),
     multiplexer(out_file.get() != nullptr ? *out_file : cout, max_threads),
     format(format), path_order_and_length(path_order_and_length), subpath_to_length(subpath_to_length),
     backing_files(max_threads, nullptr), sam_files(max_threads, nullptr),
     atomic_header(nullptr), sam_header(), header_mutex(), output_is_bgzf(format != "SAM"),
-    hts_mode() {
+    hts_mode(), sorter(sort ? new HTSSorter(max_threads, options.sort_memory) : nullptr),
+    index_filename(options.index_filename), mark_duplicates(options.mark_duplicates || options.remove_duplicates),
+    remove_duplicates(options.remove_duplicates), duplicate_stats_filename(options.duplicate_stats_filename),
+    sorted_out(out_file.get() != nullptr ? out_file.get() : &cout) {
     
     // We can't work with no streams to multiplex, because we need to be able
     // to write BGZF EOF blocks throught he multiplexer at destruction.
@@ -446,6 +453,17 @@ HTSWriter::HTSWriter(const string& filename, const string& format,
     // Make sure we have an HTS format
     assert(format == "SAM" || format == "BAM" || format == "CRAM");
     
+    if (!index_filename.empty() && (!sorter || format != "BAM")) {
+        cerr << "warning:[vg::HTSWriter] an index can only be made for sorted BAM output; not indexing" << endl;
+        index_filename.clear();
+    }
+    
+    if (mark_duplicates && !sorter) {
+        cerr << "warning:[vg::HTSWriter] duplicates can only be marked in sorted output; not marking" << endl;
+        mark_duplicates = false;
+        remove_duplicates = false;
+    }
+    
     // Compute the file mode to send to HTSlib depending on output format
     char out_mode[5];
     string out_format = "";
@@ -481,6 +499,12 @@ HTSWriter::HTSWriter(const string& filename, const string& format,
 HTSWriter::~HTSWriter() {
     // Note that the destructor runs in only one thread, and only when
     // destruction is safe. No need to lock the header.
+    
+    if (sorter) {
+        // Everything is still in the sorter, and nothing has been written.
+        write_sorted();
+    }
+    
     if (atomic_header.load() != nullptr) {
         // Delete the header
         bam_hdr_destroy(atomic_header.load());
@@ -505,7 +529,7 @@ HTSWriter::~HTSWriter() {
         }
     }
     
-    if (output_is_bgzf) {
+    if (output_is_bgzf && !sorter) {
         // Now put one BGZF EOF marker in thread 0's stream.
         // It will be the last thing, after all the barriers, and close the file.
         vg::io::finish(multiplexer.get_thread_stream(0), true);
@@ -539,9 +563,11 @@ bam_hdr_t* HTSWriter::ensure_header(const string& read_group,
             // Make the header
             header = hts_string_header(sam_header, path_order_and_length, rg_sample);
             
-            // Initialize the SAM file for this thread and actually keep the header
-            // we write, since we are the first thread.
-            initialize_sam_file(header, thread_number, true);
+            if (!sorter) {
+                // Initialize the SAM file for this thread and actually keep the header
+                // we write, since we are the first thread.
+                initialize_sam_file(header, thread_number, true);
+            }
             
             // Save back to the atomic only after the header has been written and
             // it is safe for other threads to use it.
@@ -555,7 +581,7 @@ bam_hdr_t* HTSWriter::ensure_header(const string& read_group,
     // Otherwise, someone else beat us to creating the header.
     // Header is ready. We just need to create the samFile* for this thread with it if it doesn't exist.
     
-    if (sam_files[thread_number] == nullptr) {
+    if (!sorter && sam_files[thread_number] == nullptr) {
         // The header has been created and written, but hasn't been used to initialize our samFile* yet.
         initialize_sam_file(header, thread_number);
     }
@@ -565,8 +591,15 @@ bam_hdr_t* HTSWriter::ensure_header(const string& read_group,
 
 
 void HTSWriter::save_records(bam_hdr_t* header, vector<bam1_t*>& records, size_t thread_number) {
-    // We need a header and an extant samFile*
     assert(header != nullptr);
+    
+    if (sorter) {
+        // Hand the records off to be written in order later.
+        sorter->add(header, records, thread_number);
+        return;
+    }
+    
+    // We need an extant samFile*
     assert(sam_files[thread_number] != nullptr);
     
     for (auto& b : records) {
@@ -591,6 +624,81 @@ void HTSWriter::save_records(bam_hdr_t* header, vector<bam1_t*>& records, size_t
     }
 }
 
+void HTSWriter::write_sorted() {
+    bam_hdr_t* header = atomic_header.load();
+    if (header == nullptr) {
+        // Nothing was ever emitted, but we still owe a file with a header.
+        header = hts_string_header(sam_header, path_order_and_length, map<string, string>());
+        atomic_header.store(header);
+    }
+    
+    // We don't go through the multiplexer here because we are the only writer
+    // left, and it would buffer the whole file waiting for a breakpoint.
+    hFILE* backing_file = vg::io::hfile_wrap(*sorted_out);
+    samFile* sam_file = hts_hopen(backing_file, "-", hts_mode.c_str());
+    if (sam_file == nullptr) {
+        cerr << "[vg::HTSWriter] failed to open internal stream for writing sorted " << format << " output" << endl;
+        exit(1);
+    }
+    // Mapping is over, so use all our threads to compress.
+    hts_set_threads(sam_file, sam_files.size());
+    
+    if (sam_hdr_write(sam_file, header) != 0) {
+        cerr << "[vg::HTSWriter] error: failed to write the SAM header" << endl;
+        exit(1);
+    }
+    
+    bool indexing = !index_filename.empty();
+    if (indexing) {
+        // Build the index as we go, since we know the file is sorted.
+        bool bai = index_filename.size() >= 4 && index_filename.substr(index_filename.size() - 4) == ".bai";
+        int min_shift = bai ? 0 : 14;
+        if (sam_idx_init(sam_file, header, min_shift, index_filename.c_str()) != 0) {
+            cerr << "[vg::HTSWriter] error: failed to start index " << index_filename << endl;
+            exit(1);
+        }
+    }
+    
+    auto write_record = [&](bam1_t* b) {
+        if (sam_write1(sam_file, header, b) < 0) {
+            cerr << "[vg::HTSWriter] error: writing to output file failed" << endl;
+            exit(1);
+        }
+    };
+    
+    if (mark_duplicates) {
+        // Mark duplicates as the sorted records stream past.
+        HTSDuplicateMarker marker(write_record, remove_duplicates);
+        sorter->merge(header, [&](bam1_t*& b) {
+            marker.add(b);
+        });
+        marker.flush();
+        
+        if (!duplicate_stats_filename.empty()) {
+            ofstream stats_file(duplicate_stats_filename);
+            if (!stats_file) {
+                cerr << "[vg::HTSWriter] error: could not write duplicate statistics to " << duplicate_stats_filename << endl;
+                exit(1);
+            }
+            marker.report(stats_file);
+        }
+    } else {
+        sorter->merge(header, write_record);
+    }
+    
+    if (indexing && sam_idx_save(sam_file) != 0) {
+        cerr << "[vg::HTSWriter] error: failed to save index " << index_filename << endl;
+        exit(1);
+    }
+    
+    // This writes the one and only BGZF EOF block, if needed.
+    if (sam_close(sam_file) != 0) {
+        cerr << "[vg::HTSWriter] error: failed to finish sorted " << format << " output" << endl;
+        exit(1);
+    }
+    sorted_out->flush();
+}
+
 void HTSWriter::initialize_sam_file(bam_hdr_t* header, size_t thread_number, bool keep_header) {
     if (sam_files[thread_number] != nullptr) {
         // A samFile* has been created already. Clear it out.
@@ -649,8 +757,8 @@ void HTSWriter::initialize_sam_file(bam_hdr_t* header, size_t thread_number, boo
 HTSAlignmentEmitter::HTSAlignmentEmitter(const string& filename, const string& format,
                                          const vector<pair<string, int64_t>>& path_order_and_length,
                                          const unordered_map<string, int64_t>& subpath_to_length,
-                                         size_t max_threads)
-    : HTSWriter(filename, format, path_order_and_length, subpath_to_length, max_threads)
+                                         size_t max_threads, bool sort, const HTSOutputOptions& options)
+    : HTSWriter(filename, format, path_order_and_length, subpath_to_length, max_threads, sort, options)
 {
     // nothing else to do
 }
@@ -747,7 +855,7 @@ void HTSAlignmentEmitter::emit_singles(vector<Alignment>&& aln_batch) {
     bam_hdr_t* header = ensure_header(aln_batch.front().read_group(),
                                       aln_batch.front().sample_name(), thread_number);
     assert(header != nullptr);
-    assert(sam_files[thread_number] != nullptr);
+    assert(sorter || sam_files[thread_number] != nullptr);
     
     vector<bam1_t*> records;
     records.reserve(aln_batch.size());
@@ -786,7 +894,7 @@ void HTSAlignmentEmitter::emit_mapped_singles(vector<vector<Alignment>>&& alns_b
     bam_hdr_t* header = ensure_header(sniff->read_group(), sniff->sample_name(),
                                       thread_number);
     assert(header != nullptr);
-    assert(sam_files[thread_number] != nullptr);
+    assert(sorter || sam_files[thread_number] != nullptr);
     
     vector<bam1_t*> records;
     records.reserve(count);
@@ -823,7 +931,7 @@ void HTSAlignmentEmitter::emit_pairs(vector<Alignment>&& aln1_batch,
     bam_hdr_t* header = ensure_header(aln1_batch.front().read_group(),
                                       aln1_batch.front().sample_name(), thread_number);
     assert(header != nullptr);
-    assert(sam_files[thread_number] != nullptr);
+    assert(sorter || sam_files[thread_number] != nullptr);
     
     vector<bam1_t*> records;
     records.reserve(aln1_batch.size() * 2);
@@ -874,7 +982,7 @@ void HTSAlignmentEmitter::emit_mapped_pairs(vector<vector<Alignment>>&& alns1_ba
     bam_hdr_t* header = ensure_header(sniff->read_group(), sniff->sample_name(),
                                       thread_number);
     assert(header != nullptr);
-    assert(sam_files[thread_number] != nullptr);
+    assert(sorter || sam_files[thread_number] != nullptr);
     
     vector<bam1_t*> records;
     records.reserve(count);
@@ -894,8 +1002,8 @@ SplicedHTSAlignmentEmitter::SplicedHTSAlignmentEmitter(const string& filename, c
                                                        const vector<pair<string, int64_t>>& path_order_and_length,
                                                        const unordered_map<string, int64_t>& subpath_to_length,
                                                        const PathPositionHandleGraph& graph,
-                                                       size_t max_threads) :
-    HTSAlignmentEmitter(filename, format, path_order_and_length, subpath_to_length, max_threads), graph(graph) {
+                                                       size_t max_threads, bool sort, const HTSOutputOptions& options) :
+    HTSAlignmentEmitter(filename, format, path_order_and_length, subpath_to_length, max_threads, sort, options), graph(graph) {
     
     // nothing else to do
 }
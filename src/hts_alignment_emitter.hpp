@@ -20,6 +20,7 @@
 #include <vg/io/protobuf_emitter.hpp>
 #include <vg/io/stream_multiplexer.hpp>
 #include "handle.hpp"
+#include "hts_sorter.hpp"
 #include "vg/io/alignment_emitter.hpp"
 
 namespace vg {
@@ -44,7 +45,28 @@ enum alignment_emitter_flags_t {
     ALIGNMENT_EMITTER_FLAG_HTS_PRUNE_SUSPICIOUS_ANCHORS = 4,
     /// Emit graph alignments in named segment (i.e. GFA space) instead of
     /// numerical node ID space.
-    ALIGNMENT_EMITTER_FLAG_VG_USE_SEGMENT_NAMES = 8
+    ALIGNMENT_EMITTER_FLAG_VG_USE_SEGMENT_NAMES = 8,
+    /// Coordinate-sort HTSlib output before writing it, instead of writing
+    /// alignments in the order they are emitted.
+    ALIGNMENT_EMITTER_FLAG_HTS_SORT = 16
+};
+
+/**
+ * Tunable settings for HTSlib output that don't fit in a flag.
+ */
+struct HTSOutputOptions {
+    /// When sorting, how many bytes of records can we hold in memory, over all
+    /// threads, before spilling sorted runs to temporary files?
+    size_t sort_memory = 768 * 1024 * 1024;
+    /// When sorting BAM, write an index to this file if set. Index is BAI if
+    /// the name ends in ".bai" and CSI otherwise.
+    string index_filename;
+    /// When sorting, should we flag duplicate reads as we write them?
+    bool mark_duplicates = false;
+    /// When marking duplicates, should we drop them instead of flagging them?
+    bool remove_duplicates = false;
+    /// When marking duplicates, write duplication statistics here if set.
+    string duplicate_stats_filename;
 };
 
 /// Get an AlignmentEmitter that can emit to the given file (or "-") in the
@@ -55,12 +77,14 @@ enum alignment_emitter_flags_t {
 /// and sequences. Other formats do not need a graph.
 ///
 /// flags is an ORed together set of flags from alignment_emitter_flags_t.
+/// hts_options is only used for HTSlib formats.
 ///
 /// Automatically applies per-thread buffering, but needs to know how many OMP
 /// threads will be in use.
 unique_ptr<AlignmentEmitter> get_alignment_emitter(const string& filename, const string& format, 
                                                    const vector<tuple<path_handle_t, size_t, size_t>>& paths, size_t max_threads,
-                                                   const HandleGraph* graph = nullptr, int flags = ALIGNMENT_EMITTER_FLAG_NONE);
+                                                   const HandleGraph* graph = nullptr, int flags = ALIGNMENT_EMITTER_FLAG_NONE,
+                                                   const HTSOutputOptions& hts_options = HTSOutputOptions());
 
 /**
  * Produce a list of path handles in a fixed order, suitable for use with
@@ -109,8 +133,12 @@ public:
     /// groups for the header will be guessed from the first reads. HTSlib
     /// positions will be read from the alignments' refpos, and the alignments
     /// must be surjected.
+    ///
+    /// If sort is set, records are held back and written in coordinate order
+    /// when the HTSWriter is destroyed, according to the given options.
     HTSWriter(const string& filename, const string& format, const vector<pair<string, int64_t>>& path_order_and_length,
-              const unordered_map<string, int64_t>& subpath_to_length, size_t max_threads);
+              const unordered_map<string, int64_t>& subpath_to_length, size_t max_threads,
+              bool sort = false, const HTSOutputOptions& options = HTSOutputOptions());
     
     /// Tear down an HTSWriter and destroy HTSlib structures.
     ~HTSWriter();
@@ -172,6 +200,25 @@ protected:
     /// Remember the HTSlib mode string we need to open our files.
     string hts_mode;
     
+    /// If we are sorting, this holds the records until we are destroyed.
+    /// When sorting, nothing goes through the multiplexer or sam_files.
+    unique_ptr<HTSSorter> sorter;
+    
+    /// If we are sorting, where should we put an index, if anywhere?
+    string index_filename;
+    
+    /// If we are sorting, how should we handle duplicates?
+    bool mark_duplicates;
+    bool remove_duplicates;
+    string duplicate_stats_filename;
+    
+    /// If we are sorting, this is the stream the sorted file goes to.
+    ostream* sorted_out;
+    
+    /// Write out everything held by the sorter, in order, with the header,
+    /// directly to the output stream.
+    void write_sorted();
+    
     /// Write and deallocate a bunch of BAM records. Takes care of locking the
     /// file. Header must have been written already.
     void save_records(bam_hdr_t* header, vector<bam1_t*>& records, size_t thread_number);
@@ -210,7 +257,8 @@ public:
     /// the alignments must be surjected.
     HTSAlignmentEmitter(const string& filename, const string& format,
                         const vector<pair<string, int64_t>>& path_order_and_length,
-                        const unordered_map<string, int64_t>& subpath_to_length, size_t max_threads);
+                        const unordered_map<string, int64_t>& subpath_to_length, size_t max_threads,
+                        bool sort = false, const HTSOutputOptions& options = HTSOutputOptions());
     
     /// Tear down an HTSAlignmentEmitter and destroy HTSlib structures.
     ~HTSAlignmentEmitter() = default;
@@ -261,7 +309,8 @@ public:
                                const vector<pair<string, int64_t>>& path_order_and_length,
                                const unordered_map<string, int64_t>& subpath_to_length,
                                const PathPositionHandleGraph& graph,
-                               size_t max_threads);
+                               size_t max_threads,
+                               bool sort = false, const HTSOutputOptions& options = HTSOutputOptions());
     
     ~SplicedHTSAlignmentEmitter() = default;
     
@@ -0,0 +1,189 @@
+/**
+ * \file hts_duplicate_marker.cpp
+ *
+ * Implements streaming duplicate marking for coordinate-sorted BAM records.
+ */
+
+#include "hts_duplicate_marker.hpp"
+
+#include <cstring>
+
+namespace vg {
+using namespace std;
+
+HTSDuplicateMarker::HTSDuplicateMarker(const function<void(bam1_t*)>& emit, bool remove, hts_pos_t max_clip) :
+    emit(emit), remove(remove), max_clip(max_clip) {
+    // Nothing to do
+}
+
+HTSDuplicateMarker::~HTSDuplicateMarker() {
+    // Don't leak, even if we weren't flushed.
+    for (auto& held : window) {
+        bam_destroy1(held.record);
+    }
+    for (auto& b : spare_records) {
+        bam_destroy1(b);
+    }
+}
+
+uint64_t HTSDuplicateMarker::quality_score(const bam1_t* b) {
+    const uint8_t* qual = bam_get_qual(b);
+    if (b->core.l_qseq == 0 || qual[0] == 0xff) {
+        // No qualities
+        return 0;
+    }
+    uint64_t score = 0;
+    for (int32_t i = 0; i < b->core.l_qseq; i++) {
+        if (qual[i] >= 15) {
+            score += qual[i];
+        }
+    }
+    return score;
+}
+
+/// Get the reference position the first base of a read would be at, if its
+/// leading soft and hard clips were aligned.
+static hts_pos_t unclipped_start(const bam1_t* b) {
+    const uint32_t* cigar = bam_get_cigar(b);
+    hts_pos_t start = b->core.pos;
+    for (uint32_t i = 0; i < b->core.n_cigar; i++) {
+        int op = bam_cigar_op(cigar[i]);
+        if (op != BAM_CSOFT_CLIP && op != BAM_CHARD_CLIP) {
+            break;
+        }
+        start -= bam_cigar_oplen(cigar[i]);
+    }
+    return start;
+}
+
+/// Get the reference position the last base of a read would be at, if its
+/// trailing soft and hard clips were aligned.
+static hts_pos_t unclipped_end(const bam1_t* b) {
+    const uint32_t* cigar = bam_get_cigar(b);
+    hts_pos_t end = bam_endpos(b) - 1;
+    for (uint32_t i = b->core.n_cigar; i > 0; i--) {
+        int op = bam_cigar_op(cigar[i - 1]);
+        if (op != BAM_CSOFT_CLIP && op != BAM_CHARD_CLIP) {
+            break;
+        }
+        end += bam_cigar_oplen(cigar[i - 1]);
+    }
+    return end;
+}
+
+HTSDuplicateMarker::fragment_key_t HTSDuplicateMarker::fragment_key(const bam1_t* b) {
+    // The contig is the same for everything in the window, so we don't need it.
+    bool paired = b->core.flag & BAM_FPAIRED;
+    if (paired) {
+        // We see one end; the mate's start stands in for the other end.
+        hts_pos_t five_prime = bam_is_rev(b) ? unclipped_end(b) : unclipped_start(b);
+        return make_tuple(true, bam_is_rev(b), five_prime, b->core.mtid, b->core.mpos, b->core.flag & (BAM_FREAD1 | BAM_FREAD2));
+    } else {
+        return make_tuple(false, bam_is_rev(b), unclipped_start(b), b->core.tid, unclipped_end(b), 0);
+    }
+}
+
+bool HTSDuplicateMarker::better(const bam1_t* a, const bam1_t* b) {
+    if (!(a->core.flag & BAM_FPAIRED)) {
+        uint64_t a_score = quality_score(a);
+        uint64_t b_score = quality_score(b);
+        if (a_score != b_score) {
+            return a_score > b_score;
+        }
+    }
+    // Fall back on (or, for pairs, only use) the name, which is stable.
+    return strcmp(bam_get_qname(a), bam_get_qname(b)) < 0;
+}
+
+void HTSDuplicateMarker::add(bam1_t*& b) {
+    if (b->core.tid != window_tid) {
+        // Nothing on a later contig can be a duplicate of what we hold.
+        flush();
+        window_tid = b->core.tid;
+    }
+    hts_pos_t position = b->core.pos;
+
+    // Take the record, and give the caller an empty one.
+    HeldRecord held;
+    held.record = b;
+    if (spare_records.empty()) {
+        b = bam_init1();
+    } else {
+        b = spare_records.back();
+        spare_records.pop_back();
+    }
+
+    held.candidate = !(held.record->core.flag & (BAM_FUNMAP | BAM_FSECONDARY | BAM_FSUPPLEMENTARY));
+    if (held.candidate) {
+        examined++;
+        held.key = fragment_key(held.record);
+        auto found = best_for_fragment.emplace(held.key, held.record);
+        if (!found.second) {
+            // We have seen this fragment before, so one of these is a duplicate.
+            bam1_t*& best = found.first->second;
+            bam1_t* loser = held.record;
+            if (better(held.record, best)) {
+                loser = best;
+                best = held.record;
+            }
+            loser->core.flag |= BAM_FDUP;
+            duplicates++;
+            if (loser->core.flag & BAM_FPAIRED) {
+                paired_duplicates++;
+            }
+        }
+    } else {
+        // Not a candidate, but keep it in order with the others.
+        skipped++;
+    }
+    window.push_back(held);
+
+    release(position);
+}
+
+void HTSDuplicateMarker::release(hts_pos_t position) {
+    while (!window.empty()) {
+        const HeldRecord& front = window.front();
+        // A later record has its 5' end at most max_clip before its position,
+        // so it can't share a key whose 5' end is further back than that.
+        if (front.candidate && get<2>(front.key) + max_clip >= position) {
+            break;
+        }
+        emit_front();
+    }
+}
+
+void HTSDuplicateMarker::emit_front() {
+    HeldRecord& front = window.front();
+    if (front.candidate) {
+        auto found = best_for_fragment.find(front.key);
+        if (found != best_for_fragment.end() && found->second == front.record) {
+            // The fragment is settled, and nothing else will be compared to this.
+            best_for_fragment.erase(found);
+        }
+    }
+    if (!(remove && (front.record->core.flag & BAM_FDUP))) {
+        emit(front.record);
+    }
+    spare_records.push_back(front.record);
+    window.pop_front();
+}
+
+void HTSDuplicateMarker::flush() {
+    while (!window.empty()) {
+        emit_front();
+    }
+    best_for_fragment.clear();
+}
+
+void HTSDuplicateMarker::report(ostream& out) const {
+    out << "READS_EXAMINED\t" << examined << endl;
+    out << "READS_SKIPPED\t" << skipped << endl;
+    out << "DUPLICATES\t" << duplicates << endl;
+    out << "PAIRED_DUPLICATES\t" << paired_duplicates << endl;
+    out << "UNIQUE_READS\t" << (examined - duplicates) << endl;
+    out << "PERCENT_DUPLICATION\t" << (examined == 0 ? 0.0 : (double) duplicates / examined) << endl;
+    out << "DUPLICATES_REMOVED\t" << (remove ? "true" : "false") << endl;
+}
+
+}
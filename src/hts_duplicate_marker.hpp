@@ -0,0 +1,131 @@
+#ifndef VG_HTS_DUPLICATE_MARKER_HPP_INCLUDED
+#define VG_HTS_DUPLICATE_MARKER_HPP_INCLUDED
+
+/**
+ * \file hts_duplicate_marker.hpp
+ *
+ * Defines a streaming PCR duplicate marker for coordinate-sorted BAM records.
+ */
+
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <tuple>
+#include <vector>
+
+#include <htslib/sam.h>
+
+namespace vg {
+using namespace std;
+
+/**
+ * Marks or removes duplicate reads in a coordinate-sorted stream of BAM
+ * records, as they pass through on their way to being written.
+ *
+ * Duplicates are defined by both ends of the fragment, which suits ancient
+ * DNA where reads are usually collapsed: for unpaired reads, two reads are
+ * duplicates if they have the same contig, unclipped start, unclipped end and
+ * strand. Paired reads are keyed on their own strand and unclipped 5' end and
+ * their mate's contig and start. Counting clipped bases means that copies of
+ * a molecule that were clipped differently still match.
+ *
+ * Since input is sorted, all reads that can be duplicates of each other
+ * arrive close together, so we only need to hold reads until the stream is
+ * more than max_clip bases past their 5' ends. Reads clipped by more than
+ * that may be missed as duplicates. Among unpaired duplicates we keep the one
+ * with the highest sum of base qualities of at least 15. For pairs we can
+ * only see one end at a time, so we keep the one with the smallest name,
+ * which both ends agree on.
+ *
+ * Unmapped, secondary and supplementary records are passed through
+ * untouched.
+ */
+class HTSDuplicateMarker {
+public:
+
+    /// Make a duplicate marker that sends records on to the given function.
+    /// If remove is set, duplicates are dropped instead of flagged.
+    HTSDuplicateMarker(const function<void(bam1_t*)>& emit, bool remove = false, hts_pos_t max_clip = 1000);
+
+    /// Destroy the marker. flush() must have been called.
+    ~HTSDuplicateMarker();
+
+    // Not copyable or movable
+    HTSDuplicateMarker(const HTSDuplicateMarker& other) = delete;
+    HTSDuplicateMarker& operator=(const HTSDuplicateMarker& other) = delete;
+    HTSDuplicateMarker(HTSDuplicateMarker&& other) = delete;
+    HTSDuplicateMarker& operator=(HTSDuplicateMarker&& other) = delete;
+
+    /// Take the next record in coordinate order. The marker takes the record
+    /// and gives the caller back an empty one in its place, so records are
+    /// never copied.
+    void add(bam1_t*& b);
+
+    /// Decide on and emit everything still held.
+    void flush();
+
+    /// Write duplication statistics as tab-separated name/value lines.
+    void report(ostream& out) const;
+
+    /// How many records were considered for duplicate marking?
+    size_t examined = 0;
+    /// How many of those were duplicates?
+    size_t duplicates = 0;
+    /// How many of the duplicates were paired?
+    size_t paired_duplicates = 0;
+    /// How many records were passed through without consideration?
+    size_t skipped = 0;
+
+private:
+
+    /// Where do records go?
+    function<void(bam1_t*)> emit;
+    /// Should we drop duplicates instead of marking them?
+    bool remove;
+    /// How much clipping do we wait for?
+    hts_pos_t max_clip;
+
+    /// Records starting at the same place with the same key are duplicates.
+    /// Holds paired flag, strand, own unclipped 5' position (or start, for
+    /// unpaired reads), and then either the contig and unclipped end and 0,
+    /// or the mate contig and position and read number flags.
+    using fragment_key_t = tuple<bool, bool, hts_pos_t, int32_t, hts_pos_t, uint16_t>;
+
+    /// A record we are holding on to until nothing more can be a duplicate of it.
+    struct HeldRecord {
+        bam1_t* record;
+        bool candidate;
+        fragment_key_t key;
+    };
+
+    /// Records held, in arrival order, all on the same contig.
+    deque<HeldRecord> window;
+    int32_t window_tid = -1;
+
+    /// The record we are keeping for each fragment still held.
+    map<fragment_key_t, bam1_t*> best_for_fragment;
+
+    /// Emptied records to hand back to callers.
+    vector<bam1_t*> spare_records;
+
+    /// Emit held records from the front of the window until we reach one
+    /// that a record at or after the given position could still duplicate.
+    void release(hts_pos_t position);
+
+    /// Emit the record at the front of the window.
+    void emit_front();
+
+    /// Get the score of a read for choosing which duplicate to keep.
+    static uint64_t quality_score(const bam1_t* b);
+
+    /// Get the key of a record for finding its duplicates.
+    static fragment_key_t fragment_key(const bam1_t* b);
+
+    /// Return true if the first of two duplicates should be kept over the second.
+    static bool better(const bam1_t* a, const bam1_t* b);
+};
+
+}
+
+#endif
@@ -0,0 +1,273 @@
+/**
+ * \file hts_sorter.cpp
+ *
+ * Implements coordinate sorting of BAM records produced in parallel.
+ */
+
+#include "hts_sorter.hpp"
+#include "utility.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <queue>
+
+#include <omp.h>
+
+//#define debug
+
+namespace vg {
+using namespace std;
+
+HTSSorter::HTSSorter(size_t max_threads, size_t memory_budget) : thread_runs(max_threads),
+    thread_budget(max<size_t>(memory_budget / max<size_t>(max_threads, 1), 1024 * 1024)) {
+    // Nothing else to do
+}
+
+HTSSorter::~HTSSorter() {
+    for (auto& run : thread_runs) {
+        for (auto& b : run.records) {
+            bam_destroy1(b);
+        }
+    }
+    for (auto& filename : run_files) {
+        temp_file::remove(filename);
+    }
+}
+
+bool HTSSorter::less_than(const bam1_t* a, const bam1_t* b) {
+    // Cast to unsigned so that unplaced reads (-1) go at the end.
+    uint32_t a_tid = (uint32_t) a->core.tid;
+    uint32_t b_tid = (uint32_t) b->core.tid;
+    if (a_tid != b_tid) {
+        return a_tid < b_tid;
+    }
+    if (a->core.pos != b->core.pos) {
+        return a->core.pos < b->core.pos;
+    }
+    bool a_rev = bam_is_rev(a);
+    bool b_rev = bam_is_rev(b);
+    if (a_rev != b_rev) {
+        return !a_rev;
+    }
+    // Break ties by name and mate flags, so output doesn't depend on which
+    // thread mapped what.
+    int name_order = strcmp(bam_get_qname(a), bam_get_qname(b));
+    if (name_order != 0) {
+        return name_order < 0;
+    }
+    return (a->core.flag & (BAM_FREAD1 | BAM_FREAD2 | BAM_FSECONDARY | BAM_FSUPPLEMENTARY)) <
+           (b->core.flag & (BAM_FREAD1 | BAM_FREAD2 | BAM_FSECONDARY | BAM_FSUPPLEMENTARY));
+}
+
+void HTSSorter::add(bam_hdr_t* header, vector<bam1_t*>& records, size_t thread_number) {
+    ThreadRun& run = thread_runs.at(thread_number);
+    for (auto& b : records) {
+        run.bytes += sizeof(bam1_t) + b->l_data;
+        run.records.push_back(b);
+    }
+    records.clear();
+
+    if (run.bytes >= thread_budget) {
+        // Spill the run from this thread, while the others keep mapping.
+        string filename = write_run(header, run.records);
+        run.bytes = 0;
+
+        lock_guard<mutex> lock(run_files_mutex);
+        run_files.push_back(filename);
+    }
+}
+
+size_t HTSSorter::spilled_runs() const {
+    return run_files.size();
+}
+
+string HTSSorter::write_run(bam_hdr_t* header, vector<bam1_t*>& records) {
+    std::sort(records.begin(), records.end(), less_than);
+
+    string filename = temp_file::create("vg-sort-");
+    // Temporary runs only need to be small, not very small.
+    samFile* out = sam_open(filename.c_str(), "wb1");
+    if (out == nullptr || sam_hdr_write(out, header) != 0) {
+        cerr << "error[vg::HTSSorter]: could not write sorted run to " << filename << endl;
+        exit(1);
+    }
+    for (auto& b : records) {
+        if (sam_write1(out, header, b) < 0) {
+            cerr << "error[vg::HTSSorter]: could not write sorted run to " << filename << endl;
+            exit(1);
+        }
+        bam_destroy1(b);
+    }
+    records.clear();
+    if (sam_close(out) != 0) {
+        cerr << "error[vg::HTSSorter]: could not finish sorted run " << filename << endl;
+        exit(1);
+    }
+
+#ifdef debug
+    #pragma omp critical (cerr)
+    cerr << "Spilled sorted run to " << filename << endl;
+#endif
+
+    return filename;
+}
+
+void HTSSorter::merge(bam_hdr_t* header, const function<void(bam1_t*&)>& emit) {
+
+    vector<string> files = std::move(run_files);
+    run_files.clear();
+
+    // One pool compresses and decompresses for every run, however many are open.
+    hts_tpool* pool = files.empty() ? nullptr : hts_tpool_init(max<size_t>(thread_runs.size(), 1));
+    htsThreadPool shared_pool = {pool, 0};
+
+    while (files.size() > MAX_FAN_IN) {
+        // Too many runs to have open at once, so merge groups of them into
+        // bigger runs first. Groups are independent so do them in parallel.
+        size_t group_count = (files.size() + MAX_FAN_IN - 1) / MAX_FAN_IN;
+        vector<string> merged(group_count);
+        #pragma omp parallel for schedule(dynamic, 1)
+        for (size_t i = 0; i < group_count; i++) {
+            vector<string> group(files.begin() + i * MAX_FAN_IN,
+                                 files.begin() + min(files.size(), (i + 1) * MAX_FAN_IN));
+            merged[i] = temp_file::create("vg-sort-");
+            samFile* out = sam_open(merged[i].c_str(), "wb1");
+            if (out == nullptr || sam_hdr_write(out, header) != 0) {
+                cerr << "error[vg::HTSSorter]: could not write merged run to " << merged[i] << endl;
+                exit(1);
+            }
+            if (pool != nullptr) {
+                hts_set_opt(out, HTS_OPT_THREAD_POOL, &shared_pool);
+            }
+            vector<vector<bam1_t*>> no_memory_runs;
+            merge_runs(group, no_memory_runs, pool, [&](bam1_t* b) {
+                if (sam_write1(out, header, b) < 0) {
+                    cerr << "error[vg::HTSSorter]: could not write merged run to " << merged[i] << endl;
+                    exit(1);
+                }
+            });
+            if (sam_close(out) != 0) {
+                cerr << "error[vg::HTSSorter]: could not finish merged run " << merged[i] << endl;
+                exit(1);
+            }
+        }
+        files = std::move(merged);
+    }
+
+    // Whatever is still in memory becomes one more run per thread.
+    vector<vector<bam1_t*>> in_memory;
+    for (auto& run : thread_runs) {
+        if (!run.records.empty()) {
+            std::sort(run.records.begin(), run.records.end(), less_than);
+            in_memory.emplace_back(std::move(run.records));
+            run.records.clear();
+        }
+        run.bytes = 0;
+    }
+
+    merge_runs(files, in_memory, pool, emit);
+
+    if (pool != nullptr) {
+        hts_tpool_destroy(pool);
+    }
+}
+
+void HTSSorter::merge_runs(const vector<string>& files, vector<vector<bam1_t*>>& in_memory,
+                           hts_tpool* pool, const function<void(bam1_t*&)>& emit) {
+
+    htsThreadPool shared_pool = {pool, 0};
+
+    // A run we are reading from, either a file or a vector.
+    struct Source {
+        string filename;
+        samFile* file = nullptr;
+        bam_hdr_t* file_header = nullptr;
+        vector<bam1_t*>* records = nullptr;
+        size_t next = 0;
+        bam1_t* current = nullptr;
+
+        /// Load the next record into current, or null it out.
+        void advance() {
+            if (file != nullptr) {
+                int status = sam_read1(file, file_header, current);
+                if (status < -1) {
+                    // Only -1 is the end of the run; anything else means it is truncated or corrupt.
+                    cerr << "error[vg::HTSSorter]: could not read record from sorted run " << filename << endl;
+                    exit(1);
+                }
+                if (status == -1) {
+                    bam_destroy1(current);
+                    current = nullptr;
+                }
+            } else {
+                current = next < records->size() ? records->at(next++) : nullptr;
+            }
+        }
+    };
+
+    vector<Source> sources(files.size() + in_memory.size());
+    for (size_t i = 0; i < files.size(); i++) {
+        sources[i].filename = files[i];
+        sources[i].file = sam_open(files[i].c_str(), "r");
+        if (sources[i].file == nullptr) {
+            cerr << "error[vg::HTSSorter]: could not read sorted run " << files[i] << endl;
+            exit(1);
+        }
+        if (pool != nullptr) {
+            // Let htslib decompress ahead of us in the shared pool.
+            hts_set_opt(sources[i].file, HTS_OPT_THREAD_POOL, &shared_pool);
+        }
+        sources[i].file_header = sam_hdr_read(sources[i].file);
+        if (sources[i].file_header == nullptr) {
+            cerr << "error[vg::HTSSorter]: could not read header of sorted run " << files[i] << endl;
+            exit(1);
+        }
+        sources[i].current = bam_init1();
+    }
+    for (size_t i = 0; i < in_memory.size(); i++) {
+        sources[files.size() + i].records = &in_memory[i];
+    }
+
+    // Priority queues put the greatest item first, so reverse the order.
+    auto source_order = [&](const Source* a, const Source* b) {
+        return less_than(b->current, a->current);
+    };
+    priority_queue<Source*, vector<Source*>, decltype(source_order)> queue(source_order);
+    for (auto& source : sources) {
+        source.advance();
+        if (source.current != nullptr) {
+            queue.push(&source);
+        }
+    }
+
+    while (!queue.empty()) {
+        Source* winner = queue.top();
+        queue.pop();
+
+        emit(winner->current);
+        if (winner->file == nullptr) {
+            // We own in-memory records and are done with this one.
+            bam_destroy1(winner->current);
+        }
+
+        winner->advance();
+        if (winner->current != nullptr) {
+            queue.push(winner);
+        }
+    }
+
+    for (auto& source : sources) {
+        if (source.file != nullptr) {
+            bam_hdr_destroy(source.file_header);
+            sam_close(source.file);
+        } else {
+            source.records->clear();
+        }
+    }
+    for (auto& filename : files) {
+        temp_file::remove(filename);
+    }
+}
+
+}
@@ -0,0 +1,101 @@
+#ifndef VG_HTS_SORTER_HPP_INCLUDED
+#define VG_HTS_SORTER_HPP_INCLUDED
+
+/**
+ * \file hts_sorter.hpp
+ *
+ * Defines a coordinate sorter for HTSlib BAM records that are produced in
+ * parallel, so that mappers can write sorted BAM without a separate sort pass.
+ */
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <htslib/sam.h>
+#include <htslib/thread_pool.h>
+
+namespace vg {
+using namespace std;
+
+/**
+ * Collects bam1_t records from multiple threads and produces them again in
+ * coordinate order (reference index, position, strand, name).
+ *
+ * Each thread keeps its own in-memory run. When a thread's run goes over its
+ * share of the memory budget, that thread sorts it and spills it to a
+ * lightly-compressed temporary BAM file, so compression of spilled runs
+ * overlaps with the other threads' mapping. At the end, all runs are k-way
+ * merged.
+ *
+ * Thread safe as long as each thread uses only its own thread number.
+ */
+class HTSSorter {
+public:
+
+    /// Make a sorter for the given number of threads, keeping at most about
+    /// memory_budget bytes of records in memory across all threads.
+    HTSSorter(size_t max_threads, size_t memory_budget);
+
+    /// Destroy any records not yet merged and remove temporary files.
+    ~HTSSorter();
+
+    // Not copyable or movable
+    HTSSorter(const HTSSorter& other) = delete;
+    HTSSorter& operator=(const HTSSorter& other) = delete;
+    HTSSorter(HTSSorter&& other) = delete;
+    HTSSorter& operator=(HTSSorter&& other) = delete;
+
+    /// Take ownership of a batch of records from the given thread. The records
+    /// vector is left empty. The header is used if the thread needs to spill.
+    void add(bam_hdr_t* header, vector<bam1_t*>& records, size_t thread_number);
+
+    /// Merge all the records added so far and call the given function on each
+    /// in sorted order. Records are destroyed after the callback returns. The
+    /// callback may keep a record by swapping in another one for us to own.
+    /// Must be called from one thread, after all calls to add() have finished.
+    void merge(bam_hdr_t* header, const function<void(bam1_t*&)>& emit);
+
+    /// Return true if record a must come before record b in coordinate order.
+    /// Unplaced records (tid -1) sort last.
+    static bool less_than(const bam1_t* a, const bam1_t* b);
+
+    /// How many runs were spilled to disk?
+    size_t spilled_runs() const;
+
+private:
+
+    /// Maximum number of runs to merge at once. Beyond this we merge runs
+    /// into bigger runs first.
+    static const size_t MAX_FAN_IN = 256;
+
+    /// Each thread's current in-memory run.
+    struct ThreadRun {
+        vector<bam1_t*> records;
+        size_t bytes = 0;
+    };
+    vector<ThreadRun> thread_runs;
+
+    /// Memory to allow each thread before it spills.
+    size_t thread_budget;
+
+    /// Temporary files holding sorted runs.
+    vector<string> run_files;
+    mutex run_files_mutex;
+
+    /// Sort the given records and write them to a new temporary BAM file,
+    /// destroying them. Returns the file name.
+    static string write_run(bam_hdr_t* header, vector<bam1_t*>& records);
+
+    /// Merge the given sorted runs on disk and in memory, calling emit on each
+    /// record in order. Run files are deleted and in-memory records are
+    /// destroyed. If a pool is given, run files are decompressed ahead in it.
+    static void merge_runs(const vector<string>& files, vector<vector<bam1_t*>>& in_memory,
+                           hts_tpool* pool, const function<void(bam1_t*&)>& emit);
+};
+
+}
+
+#endif
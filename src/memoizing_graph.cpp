@@ -225,5 +225,27 @@ using namespace std;
                                                           const std::function<bool(const step_handle_t&, const bool&, const size_t&)>& iteratee) const {
         return graph->for_each_step_position_on_handle(handle, iteratee);
     }
+    
+    void MemoizingGraph::forget_before(id_t node_id) {
+        for (auto it = get_handle_memo.begin(); it != get_handle_memo.end();) {
+            if (it->first < node_id) {
+                it = get_handle_memo.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+        for (auto it = steps_of_handle_memo.begin(); it != steps_of_handle_memo.end();) {
+            if (graph->get_id(it->first) < node_id) {
+                it = steps_of_handle_memo.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+    }
+    
+    size_t MemoizingGraph::memo_size() const {
+        return get_handle_memo.size() + steps_of_handle_memo.size();
+    }
 }
-
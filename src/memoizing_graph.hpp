@@ -196,6 +196,13 @@ using namespace std;
         
     public:
         
+        /// Forget the memoized results for nodes with IDs below the given ID, so
+        /// that a long-lived memo can slide along input sorted by node ID
+        void forget_before(id_t node_id);
+        
+        /// Returns the number of memoized results currently held
+        size_t memo_size() const;
+        
         /// The largest number of calls to get_handle we will memoize
         size_t max_handle_memo_size = 500;
         
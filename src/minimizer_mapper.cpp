@@ -19,6 +19,7 @@
 #include <gbwtgraph/cached_gbwtgraph.h>
 #include <iostream>
 #include <algorithm>
+#include <numeric>
 #include <cmath>
 #include <cfloat>
 #include <map>
@@ -71,6 +72,12 @@ MinimizerMapper::MinimizerMapper(
     dmg.initDeamProbabilities(deam5pfreqE,deam3pfreqE);
 }
 
+void MinimizerMapper::set_damage_profiles(const string& deam3pfreqE, const string& deam5pfreqE) {
+    this->deam3pfreqE = deam3pfreqE;
+    this->deam5pfreqE = deam5pfreqE;
+    dmg.initDeamProbabilities(deam5pfreqE,deam3pfreqE);
+}
+
 //-----------------------------------------------------------------------------
 
 /// Accessors for attributes of a type when used as a seed.
@@ -112,8 +119,8 @@ struct seed_traits<SnarlDistanceIndexClusterer::Seed> {
 
     /// How do we convert chain info to an actual seed of the type we are using?
     /// Also needs to know the hit position, and the minimizer number.
-    inline static SnarlDistanceIndexClusterer::Seed chain_info_to_seed(const pos_t& hit, size_t minimizer, const chain_info_t& chain_info, const string seq="") {
-        return {hit, minimizer, chain_info, seq};
+    inline static SnarlDistanceIndexClusterer::Seed chain_info_to_seed(const pos_t& hit, size_t minimizer, const chain_info_t& chain_info) {
+        return {hit, minimizer, chain_info};
     }
 };
 
@@ -636,14 +643,22 @@ bool MinimizerMapper::validate_clusters(const std::vector<std::vector<Cluster>>&
 
 
 template<typename SeedType>
-void MinimizerMapper::dump_debug_seeds(const std::vector<Minimizer>& minimizers, const std::vector<SeedType>& seeds, const std::vector<size_t>& selected_seeds) {
+void MinimizerMapper::dump_debug_seeds(const std::vector<Minimizer>& minimizers, const std::vector<SeedType>& seeds, const std::vector<size_t>& selected_seeds,
+                                       const MinimizerSideTable* side_table) {
     if (selected_seeds.size() < MANY_LIMIT) {
         // There are a few seeds so describe them individually.
         for (auto seed_index : selected_seeds) {
             const SeedType& seed = seeds[seed_index];
             const Minimizer& minimizer = minimizers[seed.source];
             cerr << log_name() << "Seed read:" << minimizer.value.offset << (minimizer.value.is_reverse ? '-' : '+') << " = " << seed.pos
-                << " from minimizer " << seed.source << "(" << minimizer.hits << "), #" << seed_index << endl;
+                << " from minimizer " << seed.source << "(" << minimizer.hits << "), #" << seed_index;
+            if (side_table) {
+                cerr << " " << side_table->sequence(seed.source);
+                for (auto& mismatch : side_table->mismatch_positions(seed.source)) {
+                    cerr << " *" << mismatch;
+                }
+            }
+            cerr << endl;
         }
     } else {
         // Describe the seeds in aggregate
@@ -767,76 +782,156 @@ vector<Alignment> MinimizerMapper::map(Alignment& aln) {
         return aln.sequence();
     });
 
-// Get minimizers
+// If we are in a sweep, we may have kept some of the way to seeds from the last run.
+ReadStageCache::Entry* cached = (this->stage_cache != nullptr && !this->track_provenance) ?
+    this->stage_cache->get(aln, ReadStageCache::SINGLE) : nullptr;
 
-std::vector<Minimizer> minimizers = this->find_minimizers(aln.sequence(), funnel, false);
-std::vector<Minimizer> minimizers_rymer = this->find_minimizers(aln.sequence(), funnel, true);
+std::vector<Minimizer> minimizers;
+vector<Seed> seeds;
 
-//std::set<int> key_set;
-//for (const auto& m : minimizers) {
-//    key_set.insert(m.value.key);
-//}
+//Since there can be two different versions of a distance index, find seeds and clusters differently
+std::vector<Cluster> clusters;
 
+FuncType calculate_posterior_odds_ptr = calculate_posterior_odds;
 
-for (auto & r : minimizers_rymer) {
-    r.value.key = rymer_index.kmer2rymer(r.value.key, rymer_index.k());
-    r.value.hash = r.value.key.hash();
-                                  }
+// Call visit with the posterior odds and read sequence for each minimizer
+// sequence the rymer could have come from, in order, until it returns false.
+auto for_each_rymer_candidate = [&](const Minimizer& m, const function<bool(double, const string&)>& visit) {
+    auto rymerKey = m.value.key;
+    string rymer_seq_in_read = m.value.is_reverse ? rymerKey.reverse_complement_rymer(rymer_index.k()).decode_rymer(rymer_index.k())
+                                                  : rymerKey.decode_rymer(rymer_index.k());
 
-rymers_start_index = minimizers.size();
+    vector<string> minimizer_seqs = rymer_index.get_minimizer_seq(m, rymer_index);
 
-//Since there can be two different versions of a distance index, find seeds and clusters differently
-std::vector<Cluster> clusters;
+    for (auto & minimizer_seq : minimizer_seqs) {
+        if (std::all_of(minimizer_seq.begin(), minimizer_seq.end(), [](char c) { return c == 'N'; })){continue;}
+        auto [kmer_seq, aln_seq, pos] = get_read_seq(aln.sequence(), rymer_seq_in_read, minimizer_seq);
 
-    // Cluster the seeds. Get sets of input seed indexes that go together.
-    if (track_provenance) {
-        funnel.stage("cluster");
-        funnel_rymer.stage("cluster");
-    }
+        double posterior_odds = calculate_posterior_odds_ptr(minimizer_seq, kmer_seq, aln.sequence().size(), \
+                                                             this->spurious_alignment_prior, dmg, this->minimizer_index.k(), pos);
 
-
-FuncType calculate_posterior_odds_ptr = calculate_posterior_odds;
+        if (!visit(posterior_odds, aln_seq)) {
+            break;
+        }
+    }
+};
 
 auto apply_rymer_filter = [&](auto &minimizers_rymer) {
     if(this->posterior_threshold == 0.0){this->posterior_threshold = 0.0000000001;}
     vector<Minimizer> passing_minimizers;
     for (auto &m : minimizers_rymer) {
-        auto rymerKey = m.value.key;
-        string rymer_seq_in_read = m.value.is_reverse ? rymerKey.reverse_complement_rymer(rymer_index.k()).decode_rymer(rymer_index.k())
-                                                      : rymerKey.decode_rymer(rymer_index.k());
-
-        vector<string> minimizer_seqs = rymer_index.get_minimizer_seq(m, rymer_index);
-
-        for (auto & minimizer_seq : minimizer_seqs) {
-            if (std::all_of(minimizer_seq.begin(), minimizer_seq.end(), [](char c) { return c == 'N'; })){continue;}
-            auto [kmer_seq, aln_seq, pos] = get_read_seq(aln.sequence(), rymer_seq_in_read, minimizer_seq);
-
-            double posterior_odds = calculate_posterior_odds_ptr(minimizer_seq, kmer_seq, aln.sequence().size(), \
-                                                                 this->spurious_alignment_prior, dmg, this->minimizer_index.k(), pos);
-
+        for_each_rymer_candidate(m, [&](double posterior_odds, const string& aln_seq) {
             if (posterior_odds > this->posterior_threshold) {
                 auto fm = find_minimizers(aln_seq, funnel, false, true);
                 passing_minimizers.insert(passing_minimizers.end(), fm.begin(), fm.end());
-                break;
+                return false;
             }
-                                                    }
+            return true;
+        });
      }
     minimizers_rymer.clear();
     minimizers_rymer.insert(minimizers_rymer.end(), passing_minimizers.begin(), passing_minimizers.end());
 };
 
+// Find every candidate that some posterior threshold would pick, so the
+// filter can be redone for any threshold without recomputing the odds.
+auto find_rymer_candidates = [&](const vector<Minimizer>& minimizers_rymer) {
+    vector<vector<pair<double, vector<Minimizer>>>> candidates(minimizers_rymer.size());
+    for (size_t i = 0; i < minimizers_rymer.size(); i++) {
+        double best_odds = -numeric_limits<double>::infinity();
+        for_each_rymer_candidate(minimizers_rymer[i], [&](double posterior_odds, const string& aln_seq) {
+            if (posterior_odds > best_odds) {
+                // Only a candidate that beats all the ones before it can be picked.
+                candidates[i].emplace_back(posterior_odds, find_minimizers(aln_seq, funnel, false, true));
+                best_odds = posterior_odds;
+            }
+            return true;
+        });
+    }
+    return candidates;
+};
+
+// Get the minimizers apply_rymer_filter would have kept, from the candidates.
+auto pick_rymer_candidates = [&](const vector<vector<pair<double, vector<Minimizer>>>>& candidates) {
+    if(this->posterior_threshold == 0.0){this->posterior_threshold = 0.0000000001;}
+    vector<Minimizer> passing_minimizers;
+    for (auto& rymer_candidates : candidates) {
+        for (auto& candidate : rymer_candidates) {
+            if (candidate.first > this->posterior_threshold) {
+                passing_minimizers.insert(passing_minimizers.end(), candidate.second.begin(), candidate.second.end());
+                break;
+            }
+        }
+    }
+    return passing_minimizers;
+};
+
+if (cached != nullptr && cached->have_seeds) {
+    // Nothing that seeding depends on has changed.
+    minimizers = cached->seed_minimizers;
+    seeds = cached->seeds;
+    rymers_start_index = cached->rymers_start;
+} else {
+
+    // Get minimizers
+
+    std::vector<Minimizer> minimizers_rymer;
+    if (cached != nullptr && cached->have_minimizers) {
+        minimizers = cached->minimizers;
+        minimizers_rymer = cached->rymers;
+    } else {
+        minimizers = this->find_minimizers(aln.sequence(), funnel, false);
+        minimizers_rymer = this->find_minimizers(aln.sequence(), funnel, true);
+
+        for (auto & r : minimizers_rymer) {
+            r.value.key = rymer_index.kmer2rymer(r.value.key, rymer_index.k());
+            r.value.hash = r.value.key.hash();
+        }
+
+        if (cached != nullptr) {
+            cached->minimizers = minimizers;
+            cached->rymers = minimizers_rymer;
+            cached->have_minimizers = true;
+        }
+    }
+
+    rymers_start_index = minimizers.size();
+
+    // Cluster the seeds. Get sets of input seed indexes that go together.
+    if (track_provenance) {
+        funnel.stage("cluster");
+        funnel_rymer.stage("cluster");
+    }
 
 #ifdef RYMER
-if (!minimizers_rymer.empty()){
-    apply_rymer_filter(minimizers_rymer);
-}
+    if (!minimizers_rymer.empty()){
+        if (cached == nullptr) {
+            apply_rymer_filter(minimizers_rymer);
+        } else {
+            if (!cached->have_rymer_candidates) {
+                cached->rymer_candidates = find_rymer_candidates(minimizers_rymer);
+                cached->have_rymer_candidates = true;
+            }
+            minimizers_rymer = pick_rymer_candidates(cached->rymer_candidates);
+        }
+    }
 #endif
 
+    minimizers.insert(minimizers.end(), minimizers_rymer.begin(), minimizers_rymer.end());
+    sort(minimizers.begin(), minimizers.end());
 
-minimizers.insert(minimizers.end(), minimizers_rymer.begin(), minimizers_rymer.end());
-sort(minimizers.begin(), minimizers.end());
+    seeds = this->find_seeds<Seed>(minimizers, aln, funnel);
+
+    if (cached != nullptr) {
+        cached->seed_minimizers = minimizers;
+        cached->seeds = seeds;
+        cached->rymers_start = rymers_start_index;
+        cached->have_seeds = true;
+    }
+}
 
-vector<Seed> seeds = this->find_seeds<Seed>(minimizers, aln, funnel);
+// Strings for the minimizers, computed only if something needs them.
+MinimizerSideTable minimizer_side_table(minimizers, aln.sequence());
 
  if (!seeds.empty()){
  clusters = clusterer.cluster_seeds(seeds, get_distance_limit(aln.sequence().size()));
@@ -995,7 +1090,7 @@ vector<Seed> seeds = this->find_seeds<Seed>(minimizers, aln, funnel);
                 std::vector<size_t> cluster_seeds_sorted = cluster.seeds;
                 
                 if (show_work) {
-                    dump_debug_seeds(minimizers, seeds, cluster.seeds);
+                    dump_debug_seeds(minimizers, seeds, cluster.seeds, &minimizer_side_table);
                 }
                 
                 // Define a space to chain in.
@@ -1104,7 +1199,8 @@ vector<Seed> seeds = this->find_seeds<Seed>(minimizers, aln, funnel);
     // Now start the alignment step. Everything has to become an alignment.
 
     // We will fill this with all computed alignments in estimated score order.
-    vector<Alignment> alignments;
+    // They stay compact candidates until we know which ones we will output.
+    vector<AlignmentCandidate> alignments;
     alignments.reserve(cluster_alignment_score_estimates.size());
 
     // This maps from alignment index back to cluster extension index, for
@@ -1181,7 +1277,7 @@ vector<Seed> seeds = this->find_seeds<Seed>(minimizers, aln, funnel);
             }
 
             // Collect the top alignments. Make sure we have at least one always, starting with unaligned.
-            vector<Alignment> best_alignments(1, aln);
+            vector<AlignmentCandidate> best_alignments(1);
 
             if (align_from_chains) {
                 // Align from the chained-up seeds
@@ -1206,7 +1302,9 @@ vector<Seed> seeds = this->find_seeds<Seed>(minimizers, aln, funnel);
                         &gbwt_graph);
 
                     // Do the DP between the items in the cluster as specified by the chain we got for it.
-                    best_alignments[0] = find_chain_alignment(aln, {seeds, cluster_seeds_sorted}, space, chain);
+                    best_alignments[0].wfa = find_chain_alignment(aln, {seeds, cluster_seeds_sorted}, space, chain);
+                    best_alignments[0].kind = AlignmentCandidate::WFA;
+                    best_alignments[0].score = best_alignments[0].wfa.score;
 
                     // TODO: Come up with a good secondary for the cluster somehow.
                     // Traceback over the remaining extensions?
@@ -1227,7 +1325,10 @@ vector<Seed> seeds = this->find_seeds<Seed>(minimizers, aln, funnel);
                     }
                     
                     //Fill in the best alignments from the extension. We know the top one is always full length and exists.
-                    this->extension_to_alignment(extensions.front(), best_alignments.front());
+                    //They only become real Alignments if they get output.
+                    best_alignments.front().kind = AlignmentCandidate::EXTENSION;
+                    best_alignments.front().extension = &extensions.front();
+                    best_alignments.front().score = extensions.front().score;
                     
                     if (show_work) {
                         #pragma omp critical (cerr)
@@ -1239,8 +1340,10 @@ vector<Seed> seeds = this->find_seeds<Seed>(minimizers, aln, funnel);
                     for (auto next_ext_it = extensions.begin() + 1; next_ext_it != extensions.end() && next_ext_it->full(); ++next_ext_it) {
                         // For all subsequent full length extensions, make them into alignments too.
                         // We want them all to go on to the pairing stage so we don't miss a possible pairing in a tandem repeat.
-                        best_alignments.emplace_back(aln);
-                        this->extension_to_alignment(*next_ext_it, best_alignments.back());
+                        best_alignments.emplace_back();
+                        best_alignments.back().kind = AlignmentCandidate::EXTENSION;
+                        best_alignments.back().extension = &*next_ext_it;
+                        best_alignments.back().score = next_ext_it->score;
                         
                         if (show_work) {
                             #pragma omp critical (cerr)
@@ -1263,8 +1366,21 @@ vector<Seed> seeds = this->find_seeds<Seed>(minimizers, aln, funnel);
                     }
                 
                     // Do the DP and compute up to 2 alignments from the individual gapless extensions
-                    best_alignments.emplace_back(aln);
-                    find_optimal_tail_alignments(aln, extensions, rng, best_alignments[0], best_alignments[1]);
+                    Alignment best = candidate_pool.take(aln);
+                    Alignment second_best = candidate_pool.take(aln);
+                    find_optimal_tail_alignments(aln, extensions, rng, best, second_best);
+                    // The tail alignments come back as Paths, so keep those
+                    // rather than converting them again.
+                    best_alignments.emplace_back();
+                    for (auto& candidate_and_result : {make_pair(&best_alignments[0], &best), make_pair(&best_alignments[1], &second_best)}) {
+                        AlignmentCandidate& candidate = *candidate_and_result.first;
+                        Alignment& result = *candidate_and_result.second;
+                        candidate.kind = AlignmentCandidate::PATH;
+                        candidate.path.Swap(result.mutable_path());
+                        candidate.score = result.score();
+                        candidate.identity = result.identity();
+                        candidate_pool.recycle(result);
+                    }
                     if (show_work) {
                         #pragma omp critical (cerr)
                         {
@@ -1283,25 +1399,28 @@ vector<Seed> seeds = this->find_seeds<Seed>(minimizers, aln, funnel);
             }
            
             // Have a function to process the best alignments we obtained
-            auto observe_alignment = [&](Alignment& aln) {
-                alignments.emplace_back(std::move(aln));
+            auto observe_alignment = [&](AlignmentCandidate& candidate) {
+                alignments.emplace_back(std::move(candidate));
                 alignments_to_source.push_back(processed_num);
 
                 if (track_provenance) {
     
                     funnel.project(processed_num);
-                    funnel.score(alignments.size() - 1, alignments.back().score());
+                    funnel.score(alignments.size() - 1, alignments.back().score);
                 }
                 if (show_work) {
+                    // Only for logging, materialize a copy.
+                    AlignmentCandidate copy = alignments.back();
+                    Alignment materialized = candidate_to_alignment(copy, aln);
                     #pragma omp critical (cerr)
                     {
                         cerr << log_name() << "Produced alignment from processed cluster " << processed_num
-                            << " with score " << alignments.back().score() << ": " << log_alignment(alignments.back()) << endl;
+                            << " with score " << alignments.back().score << ": " << log_alignment(materialized) << endl;
                     }
                 }
             };
             
-            for(auto aln_it = best_alignments.begin() ; aln_it != best_alignments.end() && aln_it->score() != 0 && aln_it->score() >= best_alignments[0].score() * 0.8; ++aln_it) {
+            for(auto aln_it = best_alignments.begin() ; aln_it != best_alignments.end() && aln_it->score != 0 && aln_it->score >= best_alignments[0].score * 0.8; ++aln_it) {
                 //For each additional alignment with score at least 0.8 of the best score
                 observe_alignment(*aln_it);
             }
@@ -1345,7 +1464,7 @@ vector<Seed> seeds = this->find_seeds<Seed>(minimizers, aln, funnel);
     
     if (alignments.size() == 0) {
         // Produce an unaligned Alignment
-        alignments.emplace_back(aln);
+        alignments.emplace_back();
         alignments_to_source.push_back(numeric_limits<size_t>::max());
         
         if (track_provenance) {
@@ -1368,16 +1487,16 @@ vector<Seed> seeds = this->find_seeds<Seed>(minimizers, aln, funnel);
     scores.reserve(alignments.size());
     
     process_until_threshold_a(alignments.size(), (std::function<double(size_t)>) [&](size_t i) -> double {
-        return alignments.at(i).score();
+        return alignments.at(i).score;
     }, 0, 1, max_multimaps, rng, [&](size_t alignment_num) {
         // This alignment makes it
         // Called in score order
         
         // Remember the score at its rank
-        scores.emplace_back(alignments[alignment_num].score());
+        scores.emplace_back(alignments[alignment_num].score);
         
-        // Remember the output alignment
-        mappings.emplace_back(std::move(alignments[alignment_num]));
+        // Remember the output alignment, which is the only place we make a real Alignment
+        mappings.emplace_back(candidate_to_alignment(alignments[alignment_num], aln));
         
         if (track_provenance) {
             // Tell the funnel
@@ -1391,7 +1510,7 @@ vector<Seed> seeds = this->find_seeds<Seed>(minimizers, aln, funnel);
         // We already have enough alignments, although this one has a good score
         
         // Remember the score at its rank anyway
-        scores.emplace_back(alignments[alignment_num].score());
+        scores.emplace_back(alignments[alignment_num].score);
         
         if (track_provenance) {
             funnel.fail("max-multimaps", alignment_num);
@@ -1768,13 +1887,34 @@ pair<vector<Alignment>, vector<Alignment>> MinimizerMapper::map_paired(Alignment
     
     // Minimizers for both reads, sorted by score in descending order.
     std::vector<std::vector<Minimizer>> minimizers_by_read(2);
-    minimizers_by_read[0] = this->find_minimizers(aln1.sequence(), funnels[0]);
-    minimizers_by_read[1] = this->find_minimizers(aln2.sequence(), funnels[1]);
-
     // Seeds for both reads, stored in separate vectors.
     std::vector<std::vector<Seed>> seeds_by_read(2);
-    seeds_by_read[0] = this->find_seeds<Seed>(minimizers_by_read[0], aln1, funnels[0]);
-    seeds_by_read[1 ]= this->find_seeds<Seed>(minimizers_by_read[1], aln2, funnels[1]);
+    for (size_t read_num = 0; read_num < 2; read_num++) {
+        Alignment& aln = read_num == 0 ? aln1 : aln2;
+        // If we are in a sweep, we may have kept some of the way to seeds from the last run.
+        ReadStageCache::Entry* cached = (this->stage_cache != nullptr && !this->track_provenance) ?
+            this->stage_cache->get(aln, read_num == 0 ? ReadStageCache::MATE_1 : ReadStageCache::MATE_2) : nullptr;
+        if (cached != nullptr && cached->have_seeds) {
+            // With no rymers, seeds come straight from the minimizers.
+            minimizers_by_read[read_num] = cached->minimizers;
+            seeds_by_read[read_num] = cached->seeds;
+            continue;
+        }
+        if (cached != nullptr && cached->have_minimizers) {
+            minimizers_by_read[read_num] = cached->minimizers;
+        } else {
+            minimizers_by_read[read_num] = this->find_minimizers(aln.sequence(), funnels[read_num]);
+        }
+        seeds_by_read[read_num] = this->find_seeds<Seed>(minimizers_by_read[read_num], aln, funnels[read_num]);
+        if (cached != nullptr) {
+            if (!cached->have_minimizers) {
+                cached->minimizers = minimizers_by_read[read_num];
+                cached->have_minimizers = true;
+            }
+            cached->seeds = seeds_by_read[read_num];
+            cached->have_seeds = true;
+        }
+    }
 
     // Cluster the seeds. Get sets of input seed indexes that go together.
     if (track_provenance) {
@@ -2132,7 +2272,8 @@ pair<vector<Alignment>, vector<Alignment>> MinimizerMapper::map_paired(Alignment
                 auto& extensions = cluster_extensions[processed_num].first;
                 
                 // Collect the top alignments. Make sure we have at least one always, starting with unaligned.
-                vector<Alignment> best_alignments(1, aln);
+                vector<Alignment> best_alignments;
+                best_alignments.emplace_back(candidate_pool.take(aln));
                 
                 if (GaplessExtender::full_length_extensions(extensions)) {
                     // We got full-length extensions, so directly convert to an Alignment.
@@ -2155,7 +2296,7 @@ pair<vector<Alignment>, vector<Alignment>> MinimizerMapper::map_paired(Alignment
                     for (auto next_ext_it = extensions.begin() + 1; next_ext_it != extensions.end() && next_ext_it->full(); ++next_ext_it) {
                         // For all subsequent full length extensions, make them into alignments too.
                         // We want them all to go on to the pairing stage so we don't miss a possible pairing in a tandem repeat.
-                        best_alignments.emplace_back(aln);
+                        best_alignments.emplace_back(candidate_pool.take(aln));
                         this->extension_to_alignment(*next_ext_it, best_alignments.back());
                         
                         if (show_work) {
@@ -2179,7 +2320,7 @@ pair<vector<Alignment>, vector<Alignment>> MinimizerMapper::map_paired(Alignment
                     }
                     
                     // Do the DP and compute up to 2 alignments
-                    best_alignments.emplace_back(aln);
+                    best_alignments.emplace_back(candidate_pool.take(aln));
                     find_optimal_tail_alignments(aln, extensions, rng, best_alignments[0], best_alignments[1]);
 
                     
@@ -2223,10 +2364,15 @@ pair<vector<Alignment>, vector<Alignment>> MinimizerMapper::map_paired(Alignment
                     }
                 };
                 
-                for(auto aln_it = best_alignments.begin() ; aln_it != best_alignments.end() && aln_it->score() != 0 && aln_it->score() >= best_alignments[0].score() * 0.8; ++aln_it) {
+                auto aln_it = best_alignments.begin();
+                for(; aln_it != best_alignments.end() && aln_it->score() != 0 && aln_it->score() >= best_alignments[0].score() * 0.8; ++aln_it) {
                     //For each additional extension with score at least 0.8 of the best score
                     observe_alignment(*aln_it);
                 }
+                for (; aln_it != best_alignments.end(); ++aln_it) {
+                    // The rest are never looked at again.
+                    candidate_pool.recycle(*aln_it);
+                }
 
                 if (track_provenance) {
                     // We're done with this input item
@@ -3194,8 +3340,13 @@ void MinimizerMapper::for_each_agglomeration_interval(const vector<Minimizer>& m
         return;
     }
 
-    // Items currently being iterated over
-    list<const Minimizer*> stack = {&minimizers[minimizer_indices.front()]};
+    // Items currently being iterated over. Items only leave from the front,
+    // so this is a queue starting at stack_front, which we keep in a vector
+    // to avoid allocating for every item.
+    vector<const Minimizer*> stack;
+    stack.reserve(minimizer_indices.size());
+    stack.push_back(&minimizers[minimizer_indices.front()]);
+    size_t stack_front = 0;
     // The left end of an item interval
     size_t left = stack.front()->agglomeration_start;
     // The index of the first item in the interval in the sequence of selected items
@@ -3204,21 +3355,22 @@ void MinimizerMapper::for_each_agglomeration_interval(const vector<Minimizer>& m
     // Emit all intervals that precede a given point "right"
     auto emit_preceding_intervals = [&](size_t right) {
         while (left < right) {
+            size_t stack_size = stack.size() - stack_front;
             // Work out the end position of the top thing on the stack
-            size_t stack_top_end = stack.front()->agglomeration_start + stack.front()->agglomeration_length;
+            size_t stack_top_end = stack[stack_front]->agglomeration_start + stack[stack_front]->agglomeration_length;
             if (stack_top_end <= right) {
                 // Case where the left-most item ends before the start of the new item
-                iteratee(left, stack_top_end, bottom, bottom + stack.size());
+                iteratee(left, stack_top_end, bottom, bottom + stack_size);
 
                 // If the stack contains only one item there is a gap between the item
                 // and the new item, otherwise just shift to the end of the leftmost item
-                left = stack.size() == 1 ? right : stack_top_end;
+                left = stack_size == 1 ? right : stack_top_end;
 
                 bottom += 1;
-                stack.pop_front();
+                stack_front++;
             } else {
                 // Case where the left-most item ends at or after the beginning of the new new item
-                iteratee(left, right, bottom, bottom + stack.size());
+                iteratee(left, right, bottom, bottom + stack_size);
                 left = right;
             }
         }
@@ -3228,7 +3380,7 @@ void MinimizerMapper::for_each_agglomeration_interval(const vector<Minimizer>& m
         // For each item in turn
         auto& item = minimizers[*it];
         
-        assert(stack.size() > 0);
+        assert(stack.size() > stack_front);
 
         // For each new item we return all intervals that
         // precede its start
@@ -3256,18 +3408,48 @@ double MinimizerMapper::get_log10_prob_of_disruption_in_interval(const vector<Mi
         return 0;
     }
    
+    // Work out all the columns' probabilities of disruption together. Every
+    // column starts at its base error probability, and then each minimizer
+    // multiplies in its chance of being beaten over just the columns in its
+    // flanks. The minimizers multiply in the same order that
+    // get_prob_of_disruption_in_column() takes them, so the results are the
+    // same, but we never test every minimizer against every column.
+    thread_local vector<double> column_probs;
+    column_probs.resize(right - left);
+    for (size_t i = left; i < right; i++) {
+        column_probs[i - left] = phred_to_prob((uint8_t)quality_bytes[i]);
+    }
+    for (auto it = disrupt_begin; it != disrupt_end; ++it) {
+        auto& m = minimizers[*it];
+        size_t core_start = m.forward_offset();
+        size_t core_end = core_start + m.length;
+        size_t agglomeration_end = m.agglomeration_start + m.agglomeration_length;
+        // Multiply in the flank columns from from to to.
+        auto disrupt_flank = [&](size_t from, size_t to) {
+            for (size_t i = from; i < to; i++) {
+                // How many new possible minimizers would an error here create
+                // in this agglomeration, to compete with its minimizer?
+                size_t possible_minimizers = min((size_t) m.length,
+                                                 min(i - m.agglomeration_start + 1, agglomeration_end - i));
+                column_probs[i - left] *= prob_for_at_least_one(m.value.hash, possible_minimizers);
+            }
+        };
+        disrupt_flank(left, min(right, core_start));
+        disrupt_flank(max(left, core_end), right);
+    }
+   
     // We want an OR over all the columns, but some of the probabilities are tiny.
     // So instead of NOT(AND(NOT())), which also would assume independence the
     // way we calculate AND by multiplication, we just assume independence and
     // compute OR as (p1 + p2 - (p1 * p2)).
     // Start with the first column.
-    double p = get_prob_of_disruption_in_column(minimizers, sequence, quality_bytes, disrupt_begin, disrupt_end, left);
+    double p = column_probs[0];
 #ifdef debug
     cerr << "\tProbability disrupted at column " << left << ": " << p << endl;
 #endif
     for(size_t i = left + 1 ; i < right; i++) {
         // OR up probability of all the other columns
-        double col_p = get_prob_of_disruption_in_column(minimizers, sequence, quality_bytes, disrupt_begin, disrupt_end, i);
+        double col_p = column_probs[i - left];
 #ifdef debug
         cerr << "\tProbability disrupted at column " << i << ": " << col_p << endl;
 #endif
@@ -3347,7 +3529,7 @@ void MinimizerMapper::attempt_rescue(const Alignment& aligned_read, Alignment& r
     if (this->rescue_algorithm == rescue_none) { return; }
 
     // We are traversing the same small subgraph repeatedly, so it's better to use a cache.
-    gbwtgraph::CachedGBWTGraph cached_graph(this->gbwt_graph);
+    const gbwtgraph::CachedGBWTGraph& cached_graph = gbwt_cache.get(*this);
 
     if (show_work) {
         #pragma omp critical (cerr)
@@ -3418,6 +3600,9 @@ void MinimizerMapper::attempt_rescue(const Alignment& aligned_read, Alignment& r
         dozeu_seed.back().nodes.push_back(node);
     }
 
+    // GSSW fills the whole DP matrix, so it gets a smaller limit than dozeu.
+    size_t max_rescue_cells = (this->rescue_algorithm == rescue_dozeu) ? max_dozeu_cells : max_gssw_cells;
+
     // GSSW and dozeu assume that the graph is a DAG.
     std::vector<handle_t> topological_order = gbwtgraph::topological_order(cached_graph, rescue_nodes);
     if (!topological_order.empty()) {
@@ -3426,13 +3611,13 @@ void MinimizerMapper::attempt_rescue(const Alignment& aligned_read, Alignment& r
         for (auto& h : topological_order) {
             rescue_subgraph_bases += cached_graph.get_length(h);
         }
-        if (rescue_subgraph_bases * rescued_alignment.sequence().size() > max_dozeu_cells) {
+        if (rescue_subgraph_bases * rescued_alignment.sequence().size() > max_rescue_cells) {
             if (!warned_about_rescue_size.test_and_set()) {
                 cerr << "warning[vg::safari]: Refusing to perform too-large rescue alignment of "
                     << rescued_alignment.sequence().size() << " bp against "
                     << rescue_subgraph_bases << " bp ordered subgraph for read " << rescued_alignment.name()
-                    << " which would use more than " << max_dozeu_cells
-                    << " cells and might exhaust Dozeu's allocator; suppressing further warnings." << endl;
+                    << " which would use more than " << max_rescue_cells
+                    << " cells; suppressing further warnings." << endl;
             }
             return; 
         }
@@ -3463,13 +3648,13 @@ void MinimizerMapper::attempt_rescue(const Alignment& aligned_read, Alignment& r
         handlealgs::dagify(&split_graph, &dagified, rescued_alignment.sequence().size());
 
     size_t rescue_subgraph_bases = dagified.get_total_length();
-    if (rescue_subgraph_bases * rescued_alignment.sequence().size() > max_dozeu_cells) {
+    if (rescue_subgraph_bases * rescued_alignment.sequence().size() > max_rescue_cells) {
         if (!warned_about_rescue_size.test_and_set()) {
             cerr << "warning[vg::safari]: Refusing to perform too-large rescue alignment of "
                 << rescued_alignment.sequence().size() << " bp against "
                 << rescue_subgraph_bases << " bp dagified subgraph for read " << rescued_alignment.name()
-                << " which would use more than " << max_dozeu_cells
-                << " cells and might exhaust Dozeu's allocator; suppressing further warnings." << endl;
+                << " which would use more than " << max_rescue_cells
+                << " cells; suppressing further warnings." << endl;
         }
         return; 
     }
@@ -3560,7 +3745,8 @@ int64_t MinimizerMapper::unoriented_distance_between(pos_t pos1, pos_t pos2) con
 }
 
 void MinimizerMapper::extension_to_alignment(const GaplessExtension& extension, Alignment& alignment) const {
-    *(alignment.mutable_path()) = extension.to_path(this->gbwt_graph, alignment.sequence());
+    // Fill in place, so a recycled candidate's Mappings get reused.
+    extension.to_path(this->gbwt_graph, alignment.sequence(), *alignment.mutable_path());
     alignment.set_score(extension.score);
     double identity = 0.0;
     if (!alignment.sequence().empty()) {
@@ -3571,7 +3757,7 @@ void MinimizerMapper::extension_to_alignment(const GaplessExtension& extension,
 }
 
 void MinimizerMapper::wfa_alignment_to_alignment(const WFAAlignment& wfa_alignment, Alignment& alignment) const {
-    *(alignment.mutable_path()) = wfa_alignment.to_path(this->gbwt_graph, alignment.sequence());
+    wfa_alignment.to_path(this->gbwt_graph, alignment.sequence(), *alignment.mutable_path());
     alignment.set_score(wfa_alignment.score);
     if (!alignment.sequence().empty()) {
         alignment.set_identity(identity(alignment.path()));
@@ -3580,6 +3766,217 @@ void MinimizerMapper::wfa_alignment_to_alignment(const WFAAlignment& wfa_alignme
 
 //-----------------------------------------------------------------------------
 
+MinimizerMapper::MinimizerSideTable::MinimizerSideTable(const vector<Minimizer>& minimizers, const string& sequence) :
+    minimizers(minimizers), read_sequence(sequence) {
+    // Don't allocate anything until someone actually asks.
+}
+
+const string& MinimizerMapper::MinimizerSideTable::sequence(size_t minimizer_num) const {
+    if (computed.empty()) {
+        computed.resize(minimizers.size(), 0);
+    }
+    if (sequences.empty()) {
+        sequences.resize(minimizers.size());
+    }
+    if (!(computed[minimizer_num] & HAVE_SEQUENCE)) {
+        sequences[minimizer_num] = minimizers[minimizer_num].forward_sequence();
+        computed[minimizer_num] |= HAVE_SEQUENCE;
+    }
+    return sequences[minimizer_num];
+}
+
+const string& MinimizerMapper::MinimizerSideTable::rymer_sequence(size_t minimizer_num) const {
+    // This also makes sure computed is allocated.
+    const string& forward = sequence(minimizer_num);
+    if (rymer_sequences.empty()) {
+        rymer_sequences.resize(minimizers.size());
+    }
+    if (!(computed[minimizer_num] & HAVE_RYMER_SEQUENCE)) {
+        rymer_sequences[minimizer_num] = gbwtgraph::convertToRymerSpace(forward);
+        computed[minimizer_num] |= HAVE_RYMER_SEQUENCE;
+    }
+    return rymer_sequences[minimizer_num];
+}
+
+const vector<int>& MinimizerMapper::MinimizerSideTable::mismatch_positions(size_t minimizer_num) const {
+    const string& forward = sequence(minimizer_num);
+    if (mismatches.empty()) {
+        mismatches.resize(minimizers.size());
+    }
+    if (!(computed[minimizer_num] & HAVE_MISMATCHES)) {
+        // Minimizers found through rymers can differ from the read where it
+        // has (possibly damaged) bases that agree in rymer space.
+        size_t start = minimizers[minimizer_num].forward_offset();
+        vector<int>& found = mismatches[minimizer_num];
+        for (size_t i = 0; i < forward.size() && start + i < read_sequence.size(); i++) {
+            if (forward[i] != read_sequence[start + i]) {
+                found.push_back(start + i);
+            }
+        }
+        computed[minimizer_num] |= HAVE_MISMATCHES;
+    }
+    return mismatches[minimizer_num];
+}
+
+Alignment MinimizerMapper::candidate_to_alignment(AlignmentCandidate& candidate, const Alignment& read) const {
+    Alignment result = candidate_pool.take(read);
+    switch (candidate.kind) {
+    case AlignmentCandidate::UNALIGNED:
+        // A recycled candidate may still have an empty Path.
+        result.clear_path();
+        break;
+    case AlignmentCandidate::EXTENSION:
+        extension_to_alignment(*candidate.extension, result);
+        break;
+    case AlignmentCandidate::WFA:
+        wfa_alignment_to_alignment(candidate.wfa, result);
+        break;
+    case AlignmentCandidate::PATH:
+        result.mutable_path()->Swap(&candidate.path);
+        result.set_score(candidate.score);
+        result.set_identity(candidate.identity);
+        break;
+    }
+    return result;
+}
+
+//-----------------------------------------------------------------------------
+
+thread_local MinimizerMapper::GBWTCache MinimizerMapper::gbwt_cache;
+atomic<size_t> MinimizerMapper::next_gbwt_cache_owner(0);
+atomic<size_t> MinimizerMapper::GBWTCache::total_uses(0);
+atomic<size_t> MinimizerMapper::GBWTCache::total_records_decompressed(0);
+atomic<size_t> MinimizerMapper::GBWTCache::total_clears(0);
+
+const gbwtgraph::CachedGBWTGraph& MinimizerMapper::GBWTCache::get(const MinimizerMapper& mapper) {
+    if (owner != mapper.gbwt_cache_owner) {
+        // First use on this thread, or a different mapper's graph.
+        cached_graph = gbwtgraph::CachedGBWTGraph(mapper.gbwt_graph);
+        owner = mapper.gbwt_cache_owner;
+        last_size = 0;
+    }
+
+    // Whatever the cache gained since we last handed it out was decompressed.
+    size_t size = cached_graph.cache.cacheSize();
+    total_records_decompressed.fetch_add(size - last_size, memory_order_relaxed);
+
+    if (size > mapper.gbwt_cache_records) {
+        cached_graph.cache.clearCache();
+        total_clears.fetch_add(1, memory_order_relaxed);
+    }
+    last_size = cached_graph.cache.cacheSize();
+
+    total_uses.fetch_add(1, memory_order_relaxed);
+    return cached_graph;
+}
+
+MinimizerMapper::GBWTCache::Statistics MinimizerMapper::GBWTCache::get_statistics() {
+    Statistics statistics;
+    statistics.uses = total_uses.load();
+    statistics.records_decompressed = total_records_decompressed.load();
+    statistics.clears = total_clears.load();
+    return statistics;
+}
+
+//-----------------------------------------------------------------------------
+
+thread_local MinimizerMapper::CandidatePool MinimizerMapper::candidate_pool;
+
+Alignment MinimizerMapper::CandidatePool::take(const Alignment& read) {
+    Alignment candidate;
+    if (free_candidates.empty()) {
+        candidate = read;
+        return candidate;
+    }
+
+    // Moving a message just swaps its guts.
+    candidate = std::move(free_candidates.back());
+    free_candidates.pop_back();
+
+    // Copying clears, and clearing throws away the Path along with all its
+    // Mappings, so hold on to it ourselves.
+    Path* path = candidate.release_path();
+    candidate.CopyFrom(read);
+    if (path != nullptr && !candidate.has_path()) {
+        // Clearing the Path itself keeps its Mappings and Edits for reuse.
+        path->Clear();
+        candidate.set_allocated_path(path);
+    } else {
+        delete path;
+    }
+    return candidate;
+}
+
+void MinimizerMapper::CandidatePool::recycle(Alignment& candidate) {
+    if (free_candidates.size() < MAX_FREE) {
+        free_candidates.emplace_back(std::move(candidate));
+    }
+}
+
+void MinimizerMapper::ReadStageCache::update(const MinimizerMapper& mapper) {
+    // Each stage is only good if the ones before it are.
+    bool keep_minimizers = have_settings && hard_hit_cap == mapper.hard_hit_cap;
+    bool keep_rymer_candidates = keep_minimizers && spurious_alignment_prior == mapper.spurious_alignment_prior;
+    bool keep_seeds = keep_rymer_candidates &&
+        posterior_threshold == mapper.posterior_threshold &&
+        hit_cap == mapper.hit_cap &&
+        minimizer_score_fraction == mapper.minimizer_score_fraction &&
+        max_unique_min == mapper.max_unique_min &&
+        num_bp_per_min == mapper.num_bp_per_min &&
+        exclude_overlapping_min == mapper.exclude_overlapping_min;
+
+    if (!keep_minimizers) {
+        clear();
+    } else if (!keep_seeds) {
+        for (auto& table : entries) {
+            for (auto& kv : table) {
+                Entry& entry = kv.second;
+                if (!keep_rymer_candidates) {
+                    entry.have_rymer_candidates = false;
+                    entry.rymer_candidates = vector<vector<pair<double, vector<Minimizer>>>>();
+                }
+                entry.have_seeds = false;
+                entry.seed_minimizers = vector<Minimizer>();
+                entry.seeds = vector<Seed>();
+            }
+        }
+    }
+
+    run++;
+    have_settings = true;
+    hard_hit_cap = mapper.hard_hit_cap;
+    spurious_alignment_prior = mapper.spurious_alignment_prior;
+    posterior_threshold = mapper.posterior_threshold;
+    hit_cap = mapper.hit_cap;
+    minimizer_score_fraction = mapper.minimizer_score_fraction;
+    max_unique_min = mapper.max_unique_min;
+    num_bp_per_min = mapper.num_bp_per_min;
+    exclude_overlapping_min = mapper.exclude_overlapping_min;
+}
+
+void MinimizerMapper::ReadStageCache::clear() {
+    for (auto& table : entries) {
+        table.clear();
+    }
+}
+
+MinimizerMapper::ReadStageCache::Entry* MinimizerMapper::ReadStageCache::get(const Alignment& aln, Table table) {
+    std::lock_guard<mutex> lock(entries_mutex);
+    // References to unordered_map values survive other insertions.
+    auto found = entries[table].emplace(aln.name(), Entry());
+    Entry& entry = found.first->second;
+    if (found.second) {
+        entry.sequence = aln.sequence();
+    } else if (entry.last_run == run || entry.sequence != aln.sequence()) {
+        // Some other read with this name has the entry.
+        return nullptr;
+    }
+    entry.last_run = run;
+    return &entry;
+}
+
+//-----------------------------------------------------------------------------
+
 std::vector<MinimizerMapper::Minimizer> MinimizerMapper::find_minimizers(const std::string& sequence, Funnel& funnel, bool rymer, bool testing) const {
 
     if (this->track_provenance) {
@@ -3605,8 +4002,6 @@ std::vector<MinimizerMapper::Minimizer> MinimizerMapper::find_minimizers(const s
 
     for (auto& m : minimizers) {
 
-        int window_start = get<1>(m);
-        int run_length = get<2>(m);
         double score = 0.0;
 
         std::pair<size_t, gbwtgraph::hit_type*> hits;
@@ -3643,7 +4038,7 @@ std::vector<MinimizerMapper::Minimizer> MinimizerMapper::find_minimizers(const s
         }
 
         result.push_back({ value, agglomeration_start, agglomeration_length, hits.first, hits.second,
-                            match_length, candidate_count, score, "", window_start, run_length});
+                            match_length, candidate_count, score });
 
 
     }
@@ -3787,13 +4182,7 @@ std::vector<SeedType> MinimizerMapper::find_seeds(std::vector<Minimizer>& minimi
                     chain_info = minimizer.occs[j].payload;
                 }
 
-                SnarlDistanceIndexClusterer::Seed chain_info_to_push_back;
-
-                chain_info_to_push_back = ST::chain_info_to_seed(hit, i, chain_info, minimizer.forward_sequence());
-
-                chain_info_to_push_back.mismatch_positions = minimizer.mismatch_positions;
-
-                seeds.push_back(chain_info_to_push_back);
+                seeds.push_back(ST::chain_info_to_seed(hit, i, chain_info));
             }
 
             // Remember that we took this minimizer
@@ -3994,7 +4383,8 @@ vector<GaplessExtension> MinimizerMapper::extend_cluster(const Cluster& cluster,
         }
     }
     
-    vector<GaplessExtension> cluster_extension = extender.extend(seed_matchings, sequence);
+    vector<GaplessExtension> cluster_extension = extender.extend(seed_matchings, sequence,
+                                                                 &gbwt_cache.get(*this));
 
     kept_cluster_count++;
     
@@ -4460,7 +4850,7 @@ void MinimizerMapper::find_optimal_tail_alignments(const Alignment& aln, const v
                 
                 // Do right-pinned alignment
                 left_tail_result = std::move(get_best_alignment_against_any_tree(forest, before_sequence,
-                    extension.starting_position(gbwt_graph), false, longest_detectable_gap, rng));
+                    extension.starting_position(gbwt_graph), false, longest_detectable_gap));
             }
             
             if (!extension.right_full) {
@@ -4477,7 +4867,7 @@ void MinimizerMapper::find_optimal_tail_alignments(const Alignment& aln, const v
         
                 // Do left-pinned alignment
                 right_tail_result = std::move(get_best_alignment_against_any_tree(forest, trailing_sequence,
-                    extension.tail_position(gbwt_graph), true, longest_detectable_gap, rng));
+                    extension.tail_position(gbwt_graph), true, longest_detectable_gap));
             }
             
             // Compute total score
@@ -4618,7 +5008,7 @@ void MinimizerMapper::find_optimal_tail_alignments(const Alignment& aln, const v
 //-----------------------------------------------------------------------------
 
 pair<Path, size_t> MinimizerMapper::get_best_alignment_against_any_tree(const vector<TreeSubgraph>& trees,
-    const string& sequence, const Position& default_position, bool pin_left, size_t longest_detectable_gap, LazyRNG& rng) const {
+    const string& sequence, const Position& default_position, bool pin_left, size_t longest_detectable_gap) const {
 
     // We want the best alignment, to the base graph, done against any target path
     Path best_path;
@@ -4644,91 +5034,118 @@ pair<Path, size_t> MinimizerMapper::get_best_alignment_against_any_tree(const ve
         }
     }
     
-    // We can align it once per target tree
+    const GSSWAligner* aligner = get_regular_aligner();
+    
+    // Work out the best score each tree could possibly give: every base of
+    // the sequence that fits along the tree's longest path matches, and we get
+    // the full length bonus at the unpinned end.
+    vector<int32_t> score_bounds;
+    score_bounds.reserve(trees.size());
     for (auto& subgraph : trees) {
+        size_t max_matches = min(sequence.size(), subgraph.get_longest_path_length());
+        score_bounds.push_back((int32_t) max_matches * aligner->match + aligner->full_length_bonus);
+    }
+    // And the best any alignment of the sequence could give.
+    int32_t max_score = (int32_t) sequence.size() * aligner->match + aligner->full_length_bonus;
+    
+    // Keep the alignments we make, so we can take the best one's path.
+    vector<Alignment> tree_alignments(trees.size());
+    
+    // We can align it once per target tree
+    auto best_tree = find_best_tree(score_bounds, max_score, best_score, [&](size_t tree_num) -> int32_t {
         // For each tree we can map against, map pinning the correct edge of the sequence to the root.
+        auto& subgraph = trees[tree_num];
+        Alignment& current_alignment = tree_alignments[tree_num];
         
-        if (subgraph.get_node_count() != 0) {
-            // This path has bases in it and could potentially be better than
-            // the default full-length softclip
-
-            // Do alignment to the subgraph with GSSWAligner.
-            Alignment current_alignment;
-            // If pinning right, we need to reverse the sequence, since we are
-            // always pinning left to the left edge of the tree subgraph.
-            current_alignment.set_sequence(pin_left ? sequence : reverse_complement(sequence));
-            
-            if (show_work) {
-                #pragma omp critical (cerr)
-                {
-                    cerr << log_name() << "Align " << log_alignment(current_alignment) << " pinned left" << endl;
-                }
+        if (subgraph.get_node_count() == 0) {
+            // An empty tree can't be better than the default full-length
+            // softclip.
+            return numeric_limits<int32_t>::min();
+        }
+
+        // Do alignment to the subgraph with GSSWAligner.
+        // If pinning right, we need to reverse the sequence, since we are
+        // always pinning left to the left edge of the tree subgraph.
+        current_alignment.set_sequence(pin_left ? sequence : reverse_complement(sequence));
+        
+        if (show_work) {
+            #pragma omp critical (cerr)
+            {
+                cerr << log_name() << "Align " << log_alignment(current_alignment) << " pinned left to tree " << tree_num
+                    << " that can score at most " << score_bounds[tree_num] << endl;
             }
+        }
 
 #ifdef debug_dump_graph
-            cerr << "Vs graph:" << endl;
-            subgraph.for_each_handle([&](const handle_t& here) {
-                cerr << subgraph.get_id(here) << " (" << subgraph.get_sequence(here) << "): " << endl;
-                subgraph.follow_edges(here, true, [&](const handle_t& there) {
-                    cerr << "\t" << subgraph.get_id(there) << " (" << subgraph.get_sequence(there) << ") ->" << endl;
-                });
-                subgraph.follow_edges(here, false, [&](const handle_t& there) {
-                    cerr << "\t-> " << subgraph.get_id(there) << " (" << subgraph.get_sequence(there) << ")" << endl;
-                });
+        cerr << "Vs graph:" << endl;
+        subgraph.for_each_handle([&](const handle_t& here) {
+            cerr << subgraph.get_id(here) << " (" << subgraph.get_sequence(here) << "): " << endl;
+            subgraph.follow_edges(here, true, [&](const handle_t& there) {
+                cerr << "\t" << subgraph.get_id(there) << " (" << subgraph.get_sequence(there) << ") ->" << endl;
+            });
+            subgraph.follow_edges(here, false, [&](const handle_t& there) {
+                cerr << "\t-> " << subgraph.get_id(there) << " (" << subgraph.get_sequence(there) << ")" << endl;
             });
+        });
 #endif
 
-            if (show_work) {
-                #pragma omp critical (cerr)
-                {
-                    cerr << log_name() << "Limit gap length to " << longest_detectable_gap << " bp" << endl;
-                }
+        if (show_work) {
+            #pragma omp critical (cerr)
+            {
+                cerr << log_name() << "Limit gap length to " << longest_detectable_gap << " bp" << endl;
             }
-            
-            size_t tail_subgraph_bases = subgraph.get_total_length();
-            if (tail_subgraph_bases * sequence.size() > max_dozeu_cells) {
-                if (!warned_about_tail_size.test_and_set()) {
-                    cerr << "warning[vg::safari]: Refusing to perform too-large tail alignment of "
-                        << sequence.size() << " bp against "
-                        << tail_subgraph_bases << " bp tree which would use more than " << max_dozeu_cells
-                        << " cells and might exhaust Dozeu's allocator; suppressing further warnings." << endl;
-                }
-            } else {
-                // X-drop align, accounting for full length bonus.
-                // We *always* do left-pinned alignment internally, since that's the shape of trees we get.
-                // Make sure to pass through the gap length limit so we don't just get the default.
-                get_regular_aligner()->align_pinned(current_alignment, subgraph, true, true, longest_detectable_gap);
+        }
+        
+        size_t tail_subgraph_bases = subgraph.get_total_length();
+        if (tail_subgraph_bases * sequence.size() > max_dozeu_cells) {
+            if (!warned_about_tail_size.test_and_set()) {
+                cerr << "warning[vg::safari]: Refusing to perform too-large tail alignment of "
+                    << sequence.size() << " bp against "
+                    << tail_subgraph_bases << " bp tree which would use more than " << max_dozeu_cells
+                    << " cells; suppressing further warnings." << endl;
             }
-            
-            if (show_work) {
-                #pragma omp critical (cerr)
-                {
-                    cerr << log_name() << "\tScore: " << current_alignment.score() << endl;
-                }
+        } else {
+            // X-drop align, accounting for full length bonus.
+            // We *always* do left-pinned alignment internally, since that's the shape of trees we get.
+            // Make sure to pass through the gap length limit so we don't just get the default.
+            aligner->align_pinned(current_alignment, subgraph, true, true, longest_detectable_gap);
+        }
+        
+        if (show_work) {
+            #pragma omp critical (cerr)
+            {
+                cerr << log_name() << "\tScore: " << current_alignment.score() << endl;
             }
-            
-            if (current_alignment.path().mapping_size() > 0 && deterministic_beats(current_alignment.score(), best_score, rng)) {
-                // This is a new best alignment, and it is nonempty.
-                best_path = current_alignment.path();
-                
-                if (!pin_left) {
-                    // Un-reverse it if we were pinning right
-                    best_path = reverse_complement_path(best_path, [&](id_t node) { 
-                        return subgraph.get_length(subgraph.get_handle(node, false));
-                    });
-                }
-                
-                // Translate from subgraph into base graph and keep it.
-                best_path = subgraph.translate_down(best_path);
-                best_score = current_alignment.score();
-                
-                if (show_work) {
-                    #pragma omp critical (cerr)
-                    {
-                        cerr << log_name() << "New best alignment is "
-                            << log_alignment(best_path) << " score " << best_score << endl;
-                    }
-                }
+        }
+        
+        if (current_alignment.path().mapping_size() == 0) {
+            // We didn't actually get an alignment.
+            return numeric_limits<int32_t>::min();
+        }
+        return current_alignment.score();
+    });
+    
+    if (best_tree.first < trees.size()) {
+        // This is a new best alignment, and it is nonempty.
+        auto& subgraph = trees[best_tree.first];
+        best_path = std::move(*tree_alignments[best_tree.first].mutable_path());
+        
+        if (!pin_left) {
+            // Un-reverse it if we were pinning right
+            best_path = reverse_complement_path(best_path, [&](id_t node) { 
+                return subgraph.get_length(subgraph.get_handle(node, false));
+            });
+        }
+        
+        // Translate from subgraph into base graph and keep it.
+        best_path = subgraph.translate_down(best_path);
+        best_score = best_tree.second;
+        
+        if (show_work) {
+            #pragma omp critical (cerr)
+            {
+                cerr << log_name() << "New best alignment is "
+                    << log_alignment(best_path) << " score " << best_score << endl;
             }
         }
     }
@@ -4736,6 +5153,42 @@ pair<Path, size_t> MinimizerMapper::get_best_alignment_against_any_tree(const ve
     return make_pair(best_path, best_score);
 }
 
+pair<size_t, int32_t> MinimizerMapper::find_best_tree(const vector<int32_t>& score_bounds, int32_t max_score, int32_t start_score,
+    const function<int32_t(size_t)>& align_to_tree) {
+    
+    // Try the most promising trees first, keeping forest order among equals.
+    vector<size_t> order(score_bounds.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return score_bounds[a] > score_bounds[b];
+    });
+    
+    size_t best_tree = score_bounds.size();
+    int32_t best_score = start_score;
+    for (size_t tree_num : order) {
+        if (best_score >= max_score) {
+            // Nothing can do better than this.
+            break;
+        }
+        if (score_bounds[tree_num] < best_score) {
+            // Neither this tree nor any after it can beat or tie what we have.
+            break;
+        }
+        if (score_bounds[tree_num] == best_score && (best_tree == score_bounds.size() || tree_num > best_tree)) {
+            // This tree could at best tie, and would lose the tie.
+            continue;
+        }
+        
+        int32_t score = align_to_tree(tree_num);
+        if (score > best_score || (score == best_score && best_tree != score_bounds.size() && tree_num < best_tree)) {
+            best_tree = tree_num;
+            best_score = score;
+        }
+    }
+    
+    return make_pair(best_tree, best_score);
+}
+
 vector<TreeSubgraph> MinimizerMapper::get_tail_forest(const GaplessExtension& extended_seed,
     size_t read_length, bool left_tails, size_t* longest_detectable_gap) const {
 
@@ -4894,15 +5347,31 @@ void MinimizerMapper::dfs_gbwt(const Position& from, size_t walk_distance,
 void MinimizerMapper::dfs_gbwt(handle_t from_handle, size_t from_offset, size_t walk_distance,
     const function<void(const handle_t&)>& enter_handle, const function<void(void)> exit_handle) const {
     
+    // Neighboring tails and reads walk the same haplotypes, so keep the records.
+    const gbwtgraph::CachedGBWTGraph& cached_graph = gbwt_cache.get(*this);
+    
     // Turn from_handle into a SearchState for everything on it.
-    gbwt::SearchState start_state = gbwt_graph.get_state(from_handle);
+    gbwt::SearchState start_state = cached_graph.get_state(from_handle);
     
-    // Delegate to the state-based version
-    dfs_gbwt(start_state, from_offset, walk_distance, enter_handle, exit_handle);
+    // Delegate to the state-based version, with the same cache
+    dfs_gbwt(cached_graph, start_state, from_offset, walk_distance, enter_handle, exit_handle);
 }
     
 void MinimizerMapper::dfs_gbwt(const gbwt::SearchState& start_state, size_t from_offset, size_t walk_distance,
     const function<void(const handle_t&)>& enter_handle, const function<void(void)> exit_handle) const {
+    
+    if (start_state.empty()) {
+        // No haplotypes even visit the first node. Stop.
+        return;
+    }
+    
+    // Neighboring tails and reads walk the same haplotypes, so keep the records.
+    dfs_gbwt(gbwt_cache.get(*this), start_state, from_offset, walk_distance, enter_handle, exit_handle);
+}
+
+void MinimizerMapper::dfs_gbwt(const gbwtgraph::CachedGBWTGraph& cached_graph, const gbwt::SearchState& start_state,
+    size_t from_offset, size_t walk_distance,
+    const function<void(const handle_t&)>& enter_handle, const function<void(void)> exit_handle) const {
 
     if (start_state.empty()) {
         // No haplotypes even visit the first node. Stop.
@@ -4975,7 +5444,7 @@ void MinimizerMapper::dfs_gbwt(const gbwt::SearchState& start_state, size_t from
                 // If we haven't used up all our distance yet
                 
                 // Stack up all the paths onto the stack to be processed.
-                gbwt_graph.follow_paths(frame.here_state, [&](const gbwt::SearchState& there_state) -> bool {
+                cached_graph.follow_paths(frame.here_state, [&](const gbwt::SearchState& there_state) -> bool {
                     // For each next state
                     
                     // Do it with the new distance value.
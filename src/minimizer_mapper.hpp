@@ -23,6 +23,8 @@
 #include <structures/immutable_list.hpp>
 
 #include <atomic>
+#include <mutex>
+#include <unordered_map>
 
 namespace vg {
 
@@ -58,6 +60,13 @@ public:
      */
     vector<Alignment> map(Alignment& aln);
     
+    /**
+     * Score deamination with the given 3' and 5' profiles (.prof files) from
+     * now on, instead of the ones we were made with. Not safe to call while
+     * mapping.
+     */
+    void set_damage_profiles(const string& deam3pfreqE, const string& deam5pfreqE);
+    
     // The idea here is that the subcommand feeds all the reads to the version
     // of map_paired that takes a buffer, and then empties the buffer by
     // iterating over it in parallel with the version that doesn't.
@@ -229,13 +238,21 @@ public:
 
     /// For paired end mapping, how many times should we attempt rescue (per read)?
     size_t max_rescue_attempts = 15;
+
+    /// How many decompressed GBWT records can each thread keep cached between
+    /// reads before the cache is thrown away and started over?
+    size_t gbwt_cache_records = 32768;
     
     /// How big of an alignment in POA cells should we ever try to do with Dozeu?
-    /// TODO: Lift this when Dozeu's allocator is able to work with >4 MB of memory.
-    /// Each cell is 16 bits in Dozeu, and we leave some room for the query and
-    /// padding to full SSE registers. Note that a very chopped graph might
-    /// still break this!
-    size_t max_dozeu_cells = (size_t)(1.5 * 1024 * 1024);
+    /// Dozeu's per-thread arena grows to fit whatever we give it, so this is
+    /// a guard on the memory each thread can take at once. Each cell is 16
+    /// bits, and X-drop only fills a band of the full matrix counted here. The
+    /// default fits in the arena kept between problems.
+    size_t max_dozeu_cells = (size_t)(16 * 1024 * 1024);
+    
+    /// How big of an alignment in DP cells should we ever try to do with GSSW
+    /// for rescue? GSSW fills the whole matrix, so this stays small.
+    size_t max_gssw_cells = (size_t)(1.5 * 1024 * 1024);
     
     /// And have we complained about hitting it for rescue?
     atomic_flag warned_about_rescue_size = ATOMIC_FLAG_INIT;
@@ -262,6 +279,11 @@ public:
     void force_fragment_length_distr(double mean, double stdev) {
         fragment_length_distr.force_parameters(mean, stdev);
     }
+    /// Forget the fragment length distribution learned or forced so far, so
+    /// the next pairs start estimating a new one.
+    void reset_fragment_length_distr() {
+        fragment_length_distr = FragmentLengthDistribution(1000, 1000, 0.95);
+    }
     double get_fragment_length_mean() const { return fragment_length_distr.mean(); }
     double get_fragment_length_stdev() const {return fragment_length_distr.std_dev(); }
     size_t get_fragment_length_sample_size() const { return fragment_length_distr.curr_sample_size(); }
@@ -290,12 +312,6 @@ protected:
         int32_t length; // How long is the minimizer (index's k)
         int32_t candidates_per_window; // How many minimizers compete to be the best (index's w), or 1 for syncmers.
         double score; // Scores as 1 + ln(hard_hit_cap) - ln(hits).
-        string read_seq;
-        int window_start;
-        int run_length;
-        //bool rymer=false;
-        //int m_index=-1;
-        vector<int> mismatch_positions;
 
         // Sort the minimizers in descending order by score and group identical minimizers together.
         inline bool operator< (const Minimizer& another) const {
@@ -344,7 +360,169 @@ protected:
         }
 
     };
-    
+
+    /**
+     * Per-read side table for the string-valued information about a read's
+     * minimizers, which we don't want to carry around in every Minimizer or
+     * Seed. Seeds refer to it through their source minimizer number.
+     *
+     * Nothing is computed up front: each entry is filled in the first time a
+     * consumer asks for it. The table refers to, and must not outlive, the
+     * minimizers and read sequence it was made for. It is not thread safe.
+     */
+    class MinimizerSideTable {
+    public:
+        MinimizerSideTable(const vector<Minimizer>& minimizers, const string& sequence);
+
+        /// Get the sequence of the given minimizer, in read orientation.
+        const string& sequence(size_t minimizer_num) const;
+
+        /// Get the sequence of the given minimizer in rymer (purine/pyrimidine) space, in read orientation.
+        const string& rymer_sequence(size_t minimizer_num) const;
+
+        /// Get the read positions covered by the given minimizer where the
+        /// minimizer sequence disagrees with the read. This is only nonempty
+        /// for minimizers recovered through rymers.
+        const vector<int>& mismatch_positions(size_t minimizer_num) const;
+
+    private:
+        const vector<Minimizer>& minimizers;
+        const string& read_sequence;
+
+        /// Bits for which entries have been computed.
+        enum : uint8_t { HAVE_SEQUENCE = 1, HAVE_RYMER_SEQUENCE = 2, HAVE_MISMATCHES = 4 };
+        mutable vector<uint8_t> computed;
+        mutable vector<string> sequences;
+        mutable vector<string> rymer_sequences;
+        mutable vector<vector<int>> mismatches;
+    };
+
+    /**
+     * Recycling bin for candidate Alignments.
+     *
+     * Most candidates lose to a better one and are thrown away. Instead of
+     * freeing all their Mappings and Edits only to allocate them again for the
+     * next read, we keep the losers around, since protobuf reuses cleared
+     * elements of repeated fields and the capacity of cleared strings.
+     * Winners leave the pool for good.
+     *
+     * This does the job a protobuf Arena would, but works with our generated
+     * messages, which are not arena-enabled. It is not thread safe; use one
+     * per thread.
+     */
+    class CandidatePool {
+    public:
+        /// Get a candidate to fill in for the given read, starting as a copy
+        /// of it but with storage from a recycled candidate if we have one.
+        Alignment take(const Alignment& read);
+
+        /// Give back a candidate that will not be output.
+        void recycle(Alignment& candidate);
+
+    private:
+        vector<Alignment> free_candidates;
+
+        /// Don't hold on to more than this many candidates.
+        static constexpr size_t MAX_FREE = 32;
+    };
+
+    /// Each thread recycles its own candidates.
+    static thread_local CandidatePool candidate_pool;
+
+public:
+    /**
+     * A CachedGBWTGraph that outlives a single cluster or read, so that when
+     * reads keep landing in the same region we don't decompress the same GBWT
+     * records for every extension, rescue and tail search. gbwt::CachedGBWT
+     * only grows, so to keep it bounded we throw its records away once it
+     * holds more than a limit.
+     *
+     * It is not thread safe; use one per thread.
+     */
+    class GBWTCache {
+    public:
+        /// Get the cached view of the given mapper's graph. It stays valid
+        /// until the next call, which may clear it if it has grown past the
+        /// mapper's gbwt_cache_records.
+        const gbwtgraph::CachedGBWTGraph& get(const MinimizerMapper& mapper);
+
+        /// Counters for sizing the cache, summed over all threads.
+        struct Statistics {
+            /// How many times was a cache handed out?
+            size_t uses = 0;
+            /// How many GBWT records were decompressed into caches?
+            size_t records_decompressed = 0;
+            /// How many times was a full cache cleared?
+            size_t clears = 0;
+        };
+
+        /// Get the counters so far. Decompressions during each thread's
+        /// latest use are not counted until its next use.
+        static Statistics get_statistics();
+
+    private:
+        gbwtgraph::CachedGBWTGraph cached_graph;
+        /// Which mapper are the records for? Graphs can come and go at the
+        /// same address, so we don't go by the graph.
+        size_t owner = 0;
+        /// How many records did the cache hold when we last handed it out?
+        size_t last_size = 0;
+
+        static atomic<size_t> total_uses;
+        static atomic<size_t> total_records_decompressed;
+        static atomic<size_t> total_clears;
+    };
+
+protected:
+    /// Each thread keeps its own GBWT records.
+    static thread_local GBWTCache gbwt_cache;
+
+    /// Source of the mapper IDs that say whose records a GBWTCache holds.
+    static atomic<size_t> next_gbwt_cache_owner;
+    /// Our ID for GBWTCache purposes. IDs start at 1.
+    const size_t gbwt_cache_owner = ++next_gbwt_cache_owner;
+
+    /**
+     * A candidate alignment of a read, in a compact form that is cheap to
+     * score, rank and throw away. Only the candidates we actually output are
+     * turned into protobuf Alignments, with candidate_to_alignment().
+     */
+    struct AlignmentCandidate {
+        /// What the candidate holds.
+        enum Kind : uint8_t {
+            /// Nothing aligned.
+            UNALIGNED,
+            /// A full-length gapless extension, pointed to by extension.
+            EXTENSION,
+            /// Node handles and edits in wfa.
+            WFA,
+            /// A Path that had to be built anyway for tail alignment, in path.
+            PATH
+        } kind = UNALIGNED;
+
+        /// The extension for EXTENSION candidates. It belongs to the caller
+        /// and must outlive the candidate.
+        const GaplessExtension* extension = nullptr;
+
+        /// The node handles, edits and read interval for WFA candidates.
+        WFAAlignment wfa;
+
+        /// The already-built path for PATH candidates.
+        Path path;
+
+        /// Alignment score.
+        int32_t score = 0;
+
+        /// Identity, for PATH candidates.
+        double identity = 0.0;
+    };
+
+    /**
+     * Turn a candidate into a vg Alignment of the given read. The candidate
+     * may be emptied in the process.
+     */
+    Alignment candidate_to_alignment(AlignmentCandidate& candidate, const Alignment& read) const;
+
     /// Convert an integer distance, with limits standing for no distance, to a
     /// double annotation that can safely be parsed back from JSON into an
     /// integer if it is integral.
@@ -356,6 +534,95 @@ protected:
     /// The information we store for each cluster.
     typedef SnarlDistanceIndexClusterer::Cluster Cluster;
 
+public:
+    /**
+     * Each read's minimizers, rymer candidates and seeds, kept between runs
+     * of a mapper over the same reads, like the runs of a parameter sweep.
+     * When a run only changes settings that come into play after a stage,
+     * reads pick up from the stages kept for them instead of starting over.
+     *
+     * Reads are told apart by name, and everything is kept until the cache
+     * is cleared, so this needs memory in proportion to the number of reads.
+     */
+    class ReadStageCache {
+    public:
+        /// Get ready for a run with the given mapper's current settings, by
+        /// dropping every stage those settings would compute differently.
+        /// Must not be called while mapping.
+        void update(const MinimizerMapper& mapper);
+
+        /// Forget all the reads.
+        void clear();
+
+    protected:
+        friend class MinimizerMapper;
+
+        /// Everything kept for one read.
+        struct Entry {
+            /// The sequence the stages were computed for, so two reads with
+            /// the same name don't share stages.
+            string sequence;
+            /// The last run the entry was used in, so a read that appears
+            /// twice doesn't share it with itself.
+            size_t last_run = 0;
+
+            /// The minimizers in the read, and the rymers, in rymer space.
+            bool have_minimizers = false;
+            vector<Minimizer> minimizers;
+            vector<Minimizer> rymers;
+
+            /// For each rymer, the minimizer sequences it could have come
+            /// from that some posterior threshold would pick, with their
+            /// posterior odds and the minimizers found from them. A
+            /// candidate is only picked if no earlier one passed, so the
+            /// odds rise along each list.
+            bool have_rymer_candidates = false;
+            vector<vector<pair<double, vector<Minimizer>>>> rymer_candidates;
+
+            /// The minimizers the seeds were found from, where the rymers
+            /// among them start, and the seeds.
+            bool have_seeds = false;
+            size_t rymers_start = 0;
+            vector<Minimizer> seed_minimizers;
+            vector<Seed> seeds;
+        };
+
+        /// Which entries to look in. Paired-end mapping doesn't look for
+        /// rymers, so its reads get entries of their own.
+        enum Table { SINGLE = 0, MATE_1 = 1, MATE_2 = 2, TABLE_COUNT = 3 };
+
+        /// Get the entry for the given read, making it if needed, or nullptr
+        /// if a different read with the same name already has it, or the
+        /// same read was already seen in this run. Thread safe; the entry
+        /// returned belongs to the caller for the rest of the run.
+        Entry* get(const Alignment& aln, Table table);
+
+        mutex entries_mutex;
+        unordered_map<string, Entry> entries[TABLE_COUNT];
+
+        /// Which run we are on. Entries made before the first update() count
+        /// as run 0.
+        size_t run = 0;
+
+        /// The settings the kept stages were computed with.
+        bool have_settings = false;
+        size_t hard_hit_cap = 0;
+        double spurious_alignment_prior = 0.0;
+        double posterior_threshold = 0.0;
+        size_t hit_cap = 0;
+        double minimizer_score_fraction = 0.0;
+        size_t max_unique_min = 0;
+        size_t num_bp_per_min = 0;
+        bool exclude_overlapping_min = false;
+    };
+
+    /// If set, reads reuse the stages kept here whenever they can. It is not
+    /// used when tracking provenance, since the funnel has to watch every
+    /// stage happen.
+    ReadStageCache* stage_cache = nullptr;
+
+protected:
+
     // These are our indexes
     const PathPositionHandleGraph* path_graph; // Can be nullptr; only needed for correctness tracking.
 
@@ -453,14 +720,15 @@ protected:
     std::vector<int> score_extensions(const std::vector<std::pair<std::vector<GaplessExtension>, size_t>>& extensions, const Alignment& aln, Funnel& funnel) const;
     
     /**
-     * Turn a chain into an Alignment.
+     * Turn a chain into an alignment.
      *
      * Operating on the given input alignment, align the tails and intervening
      * sequences along the given chain of perfect-match seeds, and return an
-     * optimal Alignment.
+     * optimal alignment. It comes back as a WFAAlignment, which can be made
+     * into a vg Alignment with wfa_alignment_to_alignment().
      */
     template<typename Item, typename Source = void>
-    Alignment find_chain_alignment(const Alignment& aln, const algorithms::VectorView<Item>& to_chain, const algorithms::ChainingSpace<Item, Source>& space, const std::vector<size_t>& chain) const;
+    WFAAlignment find_chain_alignment(const Alignment& aln, const algorithms::VectorView<Item>& to_chain, const algorithms::ChainingSpace<Item, Source>& space, const std::vector<size_t>& chain) const;
      
      /**
      * Operating on the given input alignment, align the tails dangling off the
@@ -699,10 +967,31 @@ protected:
      *
      * Limits the length of the longest gap to longest_detectable_gap.
      *
+     * Trees are tried in the order given by find_best_tree(), so trees that
+     * can't beat the best alignment found so far are never aligned. Ties go
+     * to the tree that comes first in the forest.
+     *
      * Returns alignments in gbwt_graph space.
      */
     pair<Path, size_t> get_best_alignment_against_any_tree(const vector<TreeSubgraph>& trees, const string& sequence,
-        const Position& default_position, bool pin_left, size_t longest_detectable_gap, LazyRNG& rng) const;
+        const Position& default_position, bool pin_left, size_t longest_detectable_gap) const;
+    
+    /**
+     * Pick the best of a forest of trees, given the most each tree could
+     * possibly score and a function to actually align to a tree and get its
+     * score.
+     *
+     * Trees are aligned in descending order of their bounds, and we stop as
+     * soon as no tree left could beat or tie the best score, or the best score
+     * reaches max_score. Ties between trees go to the one with the lower index
+     * in the forest. A tree must beat start_score, the score of not aligning
+     * at all, to win.
+     *
+     * Returns the index of the best tree and its score, or the number of trees
+     * and start_score if no tree beat start_score.
+     */
+    static pair<size_t, int32_t> find_best_tree(const vector<int32_t>& score_bounds, int32_t max_score, int32_t start_score,
+        const function<int32_t(size_t)>& align_to_tree);
         
     /// We define a type for shared-tail lists of Mappings, to avoid constantly
     /// copying Path objects.
@@ -751,6 +1040,15 @@ protected:
      */ 
     void dfs_gbwt(const gbwt::SearchState& start_state, size_t from_offset, size_t walk_distance,
         const function<void(const handle_t&)>& enter_handle, const function<void(void)> exit_handle) const;
+    
+    /**
+     * The same as dfs_gbwt on a gbwt::SearchState, but reads the GBWT
+     * through the given cache, which the caller has already taken from
+     * gbwt_cache.
+     */ 
+    void dfs_gbwt(const gbwtgraph::CachedGBWTGraph& cached_graph, const gbwt::SearchState& start_state,
+        size_t from_offset, size_t walk_distance,
+        const function<void(const handle_t&)>& enter_handle, const function<void(void)> exit_handle) const;
  
     /**
      * Score a pair of alignments given the distance between them
@@ -839,8 +1137,10 @@ protected:
     bool validate_clusters(const std::vector<std::vector<Cluster>>& clusters, const std::vector<std::vector<SeedType>>& seeds, size_t read_limit, size_t fragment_limit) const;
     
     /// Print information about a selected set of seeds.
+    /// If a side table is given, also print the minimizer sequence and any mismatches for each seed.
     template<typename SeedType>
-    static void dump_debug_seeds(const std::vector<Minimizer>& minimizers, const std::vector<SeedType>& seeds, const std::vector<size_t>& selected_seeds);
+    static void dump_debug_seeds(const std::vector<Minimizer>& minimizers, const std::vector<SeedType>& seeds, const std::vector<size_t>& selected_seeds,
+                                 const MinimizerSideTable* side_table = nullptr);
     
     /// Print information about a read to be aligned
     static void dump_debug_query(const Alignment& aln);
@@ -949,7 +1249,7 @@ void MinimizerMapper::process_until_threshold_c(size_t items, const function<Sco
 }
 
 template<typename Item, typename Source>
-Alignment MinimizerMapper::find_chain_alignment(
+WFAAlignment MinimizerMapper::find_chain_alignment(
     const Alignment& aln,
     const algorithms::VectorView<Item>& to_chain,
     const algorithms::ChainingSpace<Item, Source>& space,
@@ -1267,11 +1567,7 @@ Alignment MinimizerMapper::find_chain_alignment(
     
     aligned.check_lengths(gbwt_graph);
     
-    // Convert to a vg Alignment.
-    Alignment result(aln);
-    wfa_alignment_to_alignment(aligned, result);
-    
-    return result;
+    return aligned;
 }
 
 }
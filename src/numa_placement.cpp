@@ -0,0 +1,192 @@
+/**
+ * \file numa_placement.cpp
+ * Implements NUMA-aware placement of indexes and threads.
+ */
+
+#include "numa_placement.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <sstream>
+
+#include <omp.h>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#endif
+
+namespace vg {
+using namespace std;
+
+#ifdef __linux__
+
+/// Parse a Linux CPU list like "0-3,8-11".
+static vector<int> parse_cpu_list(const string& list) {
+    vector<int> cpus;
+    stringstream in(list);
+    string range;
+    while (getline(in, range, ',')) {
+        if (range.empty() || range == "\n") {
+            continue;
+        }
+        size_t dash = range.find('-');
+        try {
+            int first = stoi(range.substr(0, dash));
+            int last = (dash == string::npos) ? first : stoi(range.substr(dash + 1));
+            for (int cpu = first; cpu <= last; cpu++) {
+                cpus.push_back(cpu);
+            }
+        } catch (const logic_error& e) {
+            // Not a list we understand
+            return vector<int>();
+        }
+    }
+    return cpus;
+}
+
+vector<NumaNode> get_numa_nodes() {
+    vector<NumaNode> nodes;
+
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        return nodes;
+    }
+
+    DIR* node_dir = opendir("/sys/devices/system/node");
+    if (node_dir != nullptr) {
+        while (struct dirent* entry = readdir(node_dir)) {
+            string name = entry->d_name;
+            if (name.size() <= 4 || name.compare(0, 4, "node") != 0 ||
+                !all_of(name.begin() + 4, name.end(), ::isdigit)) {
+                continue;
+            }
+            ifstream cpu_list("/sys/devices/system/node/" + name + "/cpulist");
+            string list;
+            getline(cpu_list, list);
+
+            NumaNode node;
+            node.id = stoi(name.substr(4));
+            for (int cpu : parse_cpu_list(list)) {
+                if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)) {
+                    node.cpus.push_back(cpu);
+                }
+            }
+            if (!node.cpus.empty()) {
+                nodes.push_back(std::move(node));
+            }
+        }
+        closedir(node_dir);
+    }
+
+    if (nodes.empty()) {
+        // No NUMA here, so everything is one node.
+        NumaNode node;
+        node.id = 0;
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu, &allowed)) {
+                node.cpus.push_back(cpu);
+            }
+        }
+        if (!node.cpus.empty()) {
+            nodes.push_back(std::move(node));
+        }
+    }
+
+    sort(nodes.begin(), nodes.end(), [](const NumaNode& a, const NumaNode& b) {
+        return a.id < b.id;
+    });
+    return nodes;
+}
+
+NumaInterleave::NumaInterleave(const vector<NumaNode>& nodes) {
+    if (nodes.size() < 2) {
+        return;
+    }
+    const size_t bits_per_word = sizeof(unsigned long) * 8;
+    vector<unsigned long> mask;
+    for (const NumaNode& node : nodes) {
+        size_t word = node.id / bits_per_word;
+        if (word >= mask.size()) {
+            mask.resize(word + 1, 0);
+        }
+        mask[word] |= 1UL << (node.id % bits_per_word);
+    }
+    // The kernel wants one more than the number of bits in the mask.
+    active = syscall(SYS_set_mempolicy, MPOL_INTERLEAVE, mask.data(), mask.size() * bits_per_word + 1) == 0;
+}
+
+NumaInterleave::~NumaInterleave() {
+    if (active) {
+        // Go back to allocating on the local node.
+        syscall(SYS_set_mempolicy, MPOL_DEFAULT, nullptr, 0);
+    }
+}
+
+bool pin_omp_threads(const vector<NumaNode>& nodes) {
+    if (nodes.empty()) {
+        return false;
+    }
+    atomic<bool> all_pinned(true);
+    #pragma omp parallel
+    {
+        size_t thread = omp_get_thread_num();
+        // Thread 0 is the calling thread. Threads it starts later, like
+        // htslib's compression and sorting threads, inherit its affinity, so
+        // leave it free to run anywhere.
+        if (thread != 0) {
+            const NumaNode& node = nodes[thread % nodes.size()];
+            int cpu = node.cpus[(thread / nodes.size()) % node.cpus.size()];
+
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(cpu, &cpus);
+            if (sched_setaffinity(0, sizeof(cpus), &cpus) != 0) {
+                all_pinned = false;
+            }
+        }
+    }
+    return all_pinned;
+}
+
+#else
+
+vector<NumaNode> get_numa_nodes() {
+    return vector<NumaNode>();
+}
+
+NumaInterleave::NumaInterleave(const vector<NumaNode>& nodes) {
+    // Nothing to do
+}
+
+NumaInterleave::~NumaInterleave() {
+    // Nothing to do
+}
+
+bool pin_omp_threads(const vector<NumaNode>& nodes) {
+    return false;
+}
+
+#endif
+
+bool NumaInterleave::is_active() const {
+    return active;
+}
+
+string describe_numa_nodes(const vector<NumaNode>& nodes) {
+    stringstream s;
+    for (size_t i = 0; i < nodes.size(); i++) {
+        if (i != 0) {
+            s << ", ";
+        }
+        s << "node " << nodes[i].id << " (" << nodes[i].cpus.size() << " CPUs)";
+    }
+    return s.str();
+}
+
+}
@@ -0,0 +1,66 @@
+#ifndef VG_NUMA_PLACEMENT_HPP_INCLUDED
+#define VG_NUMA_PLACEMENT_HPP_INCLUDED
+
+/**
+ * \file numa_placement.hpp
+ * Spreading a mapper's indexes and threads over the NUMA nodes of a
+ * multi-socket machine, so that no one socket's memory serves every thread.
+ */
+
+#include <string>
+#include <vector>
+
+namespace vg {
+using namespace std;
+
+/// A NUMA node, and the CPUs on it that we are allowed to run on.
+struct NumaNode {
+    int id;
+    vector<int> cpus;
+};
+
+/// Find the NUMA nodes that have CPUs we are allowed to run on, in order of
+/// node ID. If the system has no NUMA information, returns a single node
+/// with all our CPUs, or nothing if we can't even tell what those are.
+vector<NumaNode> get_numa_nodes();
+
+/// Describe the nodes and their CPU counts, for logging.
+string describe_numa_nodes(const vector<NumaNode>& nodes);
+
+/**
+ * While one of these exists, memory that the thread that made it touches for
+ * the first time is spread page by page over the given nodes, instead of all
+ * landing on the node the thread is running on. Large read-only indexes that
+ * every thread probes at random should be loaded this way, so that reading
+ * them costs the same from every socket and no one interconnect link takes
+ * all the traffic.
+ *
+ * Does nothing if there is only one node, or the system can't do it.
+ */
+class NumaInterleave {
+public:
+    NumaInterleave(const vector<NumaNode>& nodes);
+    ~NumaInterleave();
+
+    NumaInterleave(const NumaInterleave& other) = delete;
+    NumaInterleave& operator=(const NumaInterleave& other) = delete;
+
+    /// Is memory actually being interleaved?
+    bool is_active() const;
+
+private:
+    bool active = false;
+};
+
+/// Pin each thread of the OpenMP team to a CPU of its own, dealing the
+/// threads out to the nodes in turn so the sockets get equal shares. Memory
+/// that threads allocate for themselves, like their caches and scratch
+/// space, then stays on their own node. The calling thread, which is thread
+/// 0 of the team, keeps its affinity, so that threads it starts later are
+/// not all confined to one CPU. Returns false if any thread could not be
+/// pinned.
+bool pin_omp_threads(const vector<NumaNode>& nodes);
+
+}
+
+#endif
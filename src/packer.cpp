@@ -2,6 +2,7 @@
 #include <vg/io/protobuf_iterator.hpp>
 #include "packer.hpp"
 #include "statistics.hpp"
+#include "damage_mask.hpp"
 #include "../vg.hpp"
 
 //#define debug
@@ -30,8 +31,8 @@ size_t Packer::estimate_bin_count(size_t num_threads) {
 
 Packer::Packer(const HandleGraph* graph) : graph(graph), data_width(8), cov_bin_size(0), edge_cov_bin_size(0), num_bases_dynamic(0), base_locks(nullptr), num_edges_dynamic(0), edge_locks(nullptr), node_quality_locks(nullptr), tmpfstream_locks(nullptr) { }
 
-Packer::Packer(const HandleGraph* graph, bool record_bases, bool record_edges, bool record_edits, bool record_qualities, size_t bin_size, size_t coverage_bins, size_t data_width) :
-    graph(graph), data_width(data_width), bin_size(bin_size), record_bases(record_bases), record_edges(record_edges), record_edits(record_edits), record_qualities(record_qualities) {
+Packer::Packer(const HandleGraph* graph, bool record_bases, bool record_edges, bool record_edits, bool record_qualities, size_t bin_size, size_t coverage_bins, size_t data_width, size_t thread_buffer_size) :
+    graph(graph), data_width(data_width), thread_buffer_size(thread_buffer_size), bin_size(bin_size), record_bases(record_bases), record_edges(record_edges), record_edits(record_edits), record_qualities(record_qualities) {
     // get the size of the base coverage counter
     num_bases_dynamic = 0;
     if (record_bases) {
@@ -101,6 +102,13 @@ Packer::Packer(const HandleGraph* graph, bool record_bases, bool record_edges, b
     for (size_t i = 0; i < get_thread_count(); ++i) {
         quality_cache.push_back(new LRUCache<pair<int, int>, int>(lru_cache_size));
     }
+
+    // let each thread count privately if asked
+    if (thread_buffer_size) {
+        for (size_t i = 0; i < (size_t)get_thread_count(); ++i) {
+            thread_buffers.push_back(new ThreadBuffer());
+        }
+    }
     
 #ifdef debug
     cerr << "Packing across " << num_edges_dynamic << " edge slots and " << num_bases_dynamic << " base slots in " << coverage_bins << " bins" << endl;
@@ -108,6 +116,10 @@ Packer::Packer(const HandleGraph* graph, bool record_bases, bool record_edges, b
 }
 
 void Packer::clear() {
+    for (auto& buffer : thread_buffers) {
+        delete buffer;
+    }
+    thread_buffers.clear();
     for (auto& counter : coverage_dynamic) {
         delete counter;
         counter = nullptr;
@@ -201,6 +213,7 @@ void Packer::merge_from_dynamic(vector<Packer*>& packers) {
     for (auto& p : packers) {
         auto& c = *p;
         c.close_edit_tmpfiles(); // flush and close temporaries
+        c.flush_thread_buffers();
         // take bin size and counts from the first, assume they are all the same
         if (first) {
             bin_size = c.get_bin_size();
@@ -253,6 +266,9 @@ void Packer::write_edits(ostream& out, size_t bin) const {
 void Packer::collect_coverage(const vector<Packer*>& packers) {
     // assume the same basis vector
     assert(!is_compacted);
+    for (auto& packer : packers) {
+        packer->flush_thread_buffers();
+    }
     if (record_bases) {
 #pragma omp parallel for
         for (size_t i = 0; i < coverage_dynamic.size(); ++i) {
@@ -329,6 +345,7 @@ void Packer::make_compact(void) {
     }
     // sync edit file
     close_edit_tmpfiles();
+    flush_thread_buffers();
     
     // temporaries for construction
     size_t basis_length = coverage_size();
@@ -468,7 +485,8 @@ void Packer::add(const Alignment& aln, int min_mapq, int min_baseq, int trim_end
     int prev_bq_count = 0;
     size_t position_in_read = 0;
     size_t read_length = aln.sequence().length();
-    if (trim_ends > 0 && read_length == 0) {
+    bool masking_damage = !damage_mask_5p.empty() || !damage_mask_3p.empty();
+    if ((trim_ends > 0 || masking_damage) && read_length == 0) {
         // could happen in gaf, where we don't bother parsing the sequence
         for (auto& mapping : aln.path().mapping()) {
             for (auto& edit : mapping.edit()) {
@@ -501,6 +519,12 @@ void Packer::add(const Alignment& aln, int min_mapq, int min_baseq, int trim_end
         int bq_count = 0;
         int ei = 0;
         size_t prev_position_in_read = position_in_read; //snapshot position at first base of mapping
+        // the reference bases the read is compared against, for damage masking
+        handle_t handle;
+        size_t offset_in_node = mapping.position().offset();
+        if (masking_damage) {
+            handle = graph->get_handle(mapping.position().node_id(), mapping.position().is_reverse());
+        }
         if (record_bases || record_qualities || trim_ends > 0) {
             for (auto& edit : mapping.edit()) {
                 if (edit_is_match(edit)) {
@@ -516,32 +540,41 @@ void Packer::add(const Alignment& aln, int min_mapq, int min_baseq, int trim_end
                         // base quality threshold filter (only if we found some kind of quality)
                         if (record_bases && (base_quality < 0 || base_quality >= min_baseq) &&
                             position_in_read >= trim_ends && position_in_read <= trim_last) {
-                            increment_coverage(coverage_idx);
+                            buffer_coverage(coverage_idx);
                             if (record_qualities && mapping_quality > 0) {
                                 total_node_quality += mapping_quality;
                             }
                         }
                     }         
                 } else if (record_edits) {
-                    // we represent things on the forward strand
-                    string pos_repr = pos_key(i);
-                    string edit_repr = edit_value(edit, mapping.position().is_reverse());
-                    size_t bin = bin_for_position(i);
-                    std::lock_guard<std::mutex> guard(tmpfstream_locks[bin]);
-                    *tmpfstreams[bin] << pos_repr << edit_repr;
+                    // substitutions that damage explains are not evidence for a variant
+                    bool damaged = masking_damage && edit_is_sub(edit) && !edit.sequence().empty();
+                    for (size_t j = 0; damaged && j < edit.sequence().size(); ++j) {
+                        damaged = looks_damaged(position_in_read + j, read_length, edit.sequence()[j],
+                                                graph->get_base(handle, offset_in_node + j));
+                    }
+                    if (!damaged) {
+                        // we represent things on the forward strand
+                        string pos_repr = pos_key(i);
+                        string edit_repr = edit_value(edit, mapping.position().is_reverse());
+                        size_t bin = bin_for_position(i);
+                        std::lock_guard<std::mutex> guard(tmpfstream_locks[bin]);
+                        *tmpfstreams[bin] << pos_repr << edit_repr;
+                    }
                 } 
                 if (mapping.position().is_reverse()) {
                     i -= edit.from_length();
                 } else {
                     i += edit.from_length();
                 }
+                offset_in_node += edit.from_length();
                 if (!edit_is_match(edit)) {
                     position_in_read += edit.to_length();
                 }
                 ++ei;
             }
             if (total_node_quality > 0) {
-                increment_node_quality(node_quality_index, total_node_quality);
+                buffer_node_quality(node_quality_index, total_node_quality);
             }
         }
         
@@ -570,7 +603,7 @@ void Packer::add(const Alignment& aln, int min_mapq, int min_baseq, int trim_end
                 }
                 // base quality threshold filter (only if we found some kind of quality)
                 if (avg_base_quality < 0 || avg_base_quality >= min_baseq) {
-                    increment_edge_coverage(edge_idx);
+                    buffer_edge_coverage(edge_idx);
                 }
             }
         }
@@ -809,6 +842,105 @@ bool Packer::has_qualities() const {
     return false;
 }
 
+void Packer::set_damage_mask(const string& deam5p_file, const string& deam3p_file, double min_damage_prob) {
+    make_damage_masks(deam5p_file, deam3p_file, min_damage_prob, damage_mask_5p, damage_mask_3p);
+}
+
+bool Packer::looks_damaged(size_t position_in_read, size_t read_length, char read_base, char ref_base) const {
+    if (position_in_read >= read_length) {
+        return false;
+    }
+    uint16_t bits = 0;
+    if (position_in_read < damage_mask_5p.size()) {
+        bits |= damage_mask_5p[position_in_read];
+    }
+    if (read_length - 1 - position_in_read < damage_mask_3p.size()) {
+        bits |= damage_mask_3p[read_length - 1 - position_in_read];
+    }
+    return (bits & damage_mask_bit(ref_base, read_base)) != 0;
+}
+
+void Packer::buffer_coverage(size_t i) {
+    if (thread_buffers.empty()) {
+        increment_coverage(i);
+    } else {
+        auto& buffer = thread_buffers[omp_get_thread_num()]->bases;
+        buffer.emplace_back(i, 1);
+        if (buffer.size() >= thread_buffer_size) {
+            apply_increments(buffer, coverage_dynamic, base_locks,
+                             &Packer::coverage_bin_offset, &Packer::init_coverage_bin);
+        }
+    }
+}
+
+void Packer::buffer_edge_coverage(size_t i) {
+    if (thread_buffers.empty()) {
+        increment_edge_coverage(i);
+    } else {
+        auto& buffer = thread_buffers[omp_get_thread_num()]->edges;
+        buffer.emplace_back(i, 1);
+        if (buffer.size() >= thread_buffer_size) {
+            apply_increments(buffer, edge_coverage_dynamic, edge_locks,
+                             &Packer::edge_coverage_bin_offset, &Packer::init_edge_coverage_bin);
+        }
+    }
+}
+
+void Packer::buffer_node_quality(size_t i, size_t v) {
+    if (thread_buffers.empty()) {
+        increment_node_quality(i, v);
+    } else {
+        auto& buffer = thread_buffers[omp_get_thread_num()]->node_qualities;
+        buffer.emplace_back(i, v);
+        if (buffer.size() >= thread_buffer_size) {
+            apply_increments(buffer, node_quality_dynamic, node_quality_locks,
+                             &Packer::node_quality_bin_offset, &Packer::init_node_quality_bin);
+        }
+    }
+}
+
+void Packer::apply_increments(vector<pair<size_t, size_t>>& increments, vector<gcsa::CounterArray*>& counters,
+                              std::mutex* locks, pair<size_t, size_t> (Packer::*bin_offset)(size_t) const,
+                              void (Packer::*init_bin)(size_t)) {
+    // sorting puts repeated indexes together and visits the bins in order, so we
+    // lock each bin once, and always in the same order as other threads
+    std::sort(increments.begin(), increments.end());
+    std::unique_lock<std::mutex> guard;
+    size_t locked_bin = numeric_limits<size_t>::max();
+    for (size_t i = 0; i < increments.size();) {
+        size_t index = increments[i].first;
+        size_t total = 0;
+        for (; i < increments.size() && increments[i].first == index; ++i) {
+            total += increments[i].second;
+        }
+        if (total == 0) {
+            continue;
+        }
+        pair<size_t, size_t> bin_and_offset = (this->*bin_offset)(index);
+        if (bin_and_offset.first != locked_bin) {
+            if (guard.owns_lock()) {
+                guard.unlock();
+            }
+            guard = std::unique_lock<std::mutex>(locks[bin_and_offset.first]);
+            locked_bin = bin_and_offset.first;
+            (this->*init_bin)(locked_bin);
+        }
+        counters[locked_bin]->increment(bin_and_offset.second, total);
+    }
+    increments.clear();
+}
+
+void Packer::flush_thread_buffers() {
+    for (auto& buffer : thread_buffers) {
+        apply_increments(buffer->bases, coverage_dynamic, base_locks,
+                         &Packer::coverage_bin_offset, &Packer::init_coverage_bin);
+        apply_increments(buffer->edges, edge_coverage_dynamic, edge_locks,
+                         &Packer::edge_coverage_bin_offset, &Packer::init_edge_coverage_bin);
+        apply_increments(buffer->node_qualities, node_quality_dynamic, node_quality_locks,
+                         &Packer::node_quality_bin_offset, &Packer::init_node_quality_bin);
+    }
+}
+
 size_t Packer::coverage_at_position(size_t i) const {
     if (is_compacted) {
         return coverage_civ[i];
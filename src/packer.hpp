@@ -49,8 +49,12 @@ public:
     /// coverage_bins : Use this many coverage objects.  Using one / thread allows faster merge
     /// coverage_locks : Number of mutexes to use for each of node and edge coverage.
     /// data_width : Number of bits per entry in the dynamic coverage vector.  Higher values get stored in a map
+    /// thread_buffer_size : If nonzero, add() collects up to this many increments per thread and applies them
+    ///                      to the bins in sorted batches, taking each bin's mutex once per batch instead of
+    ///                      once per base.  Each buffered increment takes 16 bytes.  flush_thread_buffers()
+    ///                      must be called before reading coverage.
     Packer(const HandleGraph* graph, bool record_bases, bool record_edges, bool record_edits, bool record_qualities,
-           size_t bin_size = 0, size_t coverage_bins = 1, size_t data_width = 8);
+           size_t bin_size = 0, size_t coverage_bins = 1, size_t data_width = 8, size_t thread_buffer_size = 0);
     ~Packer();
     void clear();
 
@@ -61,6 +65,16 @@ public:
     /// trim_ends : ignore first and last <trim_ends> bases
     void add(const Alignment& aln, int min_mapq = 0, int min_baseq = 0, int trim_ends = 0);
 
+    /// Don't count substitutions that could be ancient DNA damage: C->T and G->A changes
+    /// that happen with at least min_damage_prob probability at their distance from the read
+    /// ends, and more often than in the interior, according to the 5' and 3' .prof matrices
+    /// giraffe takes.  Such substitutions record no edit.
+    void set_damage_mask(const string& deam5p_file, const string& deam3p_file, double min_damage_prob);
+
+    /// Apply all increments still waiting in the per-thread buffers.  Must not be
+    /// called while other threads are adding.  Done automatically when compacting or merging.
+    void flush_thread_buffers();
+
     void merge_from_files(const vector<string>& file_names);
     void merge_from_dynamic(vector<Packer*>& packers);
     void load_from_file(const string& file_name);
@@ -126,6 +140,26 @@ private:
     void init_coverage_bin(size_t i);
     void init_edge_coverage_bin(size_t i);
     void init_node_quality_bin(size_t i);
+
+    /// Increments that one thread has collected but not yet applied to the bins,
+    /// as (index, amount) pairs
+    struct ThreadBuffer {
+        vector<pair<size_t, size_t>> bases;
+        vector<pair<size_t, size_t>> edges;
+        vector<pair<size_t, size_t>> node_qualities;
+    };
+    /// Is the substitution from ref_base to read_base at the given position a likely damage product?
+    bool looks_damaged(size_t position_in_read, size_t read_length, char read_base, char ref_base) const;
+
+    /// Route an increment from add() through this thread's buffer if we have one
+    void buffer_coverage(size_t i);
+    void buffer_edge_coverage(size_t i);
+    void buffer_node_quality(size_t i, size_t v);
+    /// Sort and combine the buffered increments, then apply them to the counters,
+    /// locking each bin once.  The buffer is left empty.
+    void apply_increments(vector<pair<size_t, size_t>>& increments, vector<gcsa::CounterArray*>& counters,
+                          std::mutex* locks, pair<size_t, size_t> (Packer::*bin_offset)(size_t) const,
+                          void (Packer::*init_bin)(size_t));
     
     void ensure_edit_tmpfiles_open(void);
     void close_edit_tmpfiles(void);
@@ -164,6 +198,14 @@ private:
     size_t num_nodes_dynamic;
     // one mutex per element of node_quality_dynamic
     std::mutex* node_quality_locks;
+    // buffered increments (one per thread, empty if not buffering)
+    vector<ThreadBuffer*> thread_buffers;
+    // flush a thread's buffer when it gets this many increments
+    size_t thread_buffer_size = 0;
+    // damage substitutions (bit ref * 4 + read) at or over the damage probability threshold,
+    // by distance from the 5' and 3' read ends (empty if not masking)
+    vector<uint16_t> damage_mask_5p;
+    vector<uint16_t> damage_mask_3p;
     
     vector<string> edit_tmpfile_names;
     vector<ofstream*> tmpfstreams;
@@ -14,6 +14,7 @@
 #include "IntervalTree.h"
 #include "annotation.hpp"
 #include "multipath_alignment_emitter.hpp"
+#include "gaf_reader.hpp"
 #include <vg/io/alignment_emitter.hpp>
 #include <vg/vg.pb.h>
 #include <vg/io/stream.hpp>
@@ -113,6 +114,17 @@ public:
      */
     int filter(istream* alignment_stream);
     
+    /**
+     * Filter the alignments in the GAF file with the given name ("-" for
+     * standard input), writing GAF to standard output. Requires the graph.
+     * Reads that fail the filters that can be checked on the GAF fields
+     * alone (name prefix, mapping quality, and score) are dropped without
+     * being converted to Alignments, unless we are reporting counts or taking
+     * the complement. Reads cannot be filtered by refpos contig, since GAF
+     * does not record refpos. Returns 0 on success, exit code to use on error.
+     */
+    int filter_gaf(const string& filename);
+    
     /**
      * Look at either end of the given alignment, up to k bases in from the end.
      * See if that tail of the alignment is mapped such that another embedding
@@ -174,7 +186,13 @@ private:
     /**
      * Does the read name have one of the indicated prefixes?
      */
-    bool matches_name(const Read& read) const;
+    bool matches_name(const string& name) const;
+    
+    /**
+     * Does the GAF record fail any of the filters that can be checked on its
+     * GAF fields, before conversion to a Read?
+     */
+    bool fails_gaf_fields(const gafkluge::GafRecord& record) const;
     
     /**
      * Does the read match one of the excluded refpos contigs?
@@ -253,6 +271,11 @@ private:
     
     /// Helper function for filter
     void filter_internal(istream* in);
+    
+    /// Helper function for filter and filter_gaf, which filters the reads
+    /// that the given function passes to either the single-read or the pair
+    /// callback
+    void filter_internal(const function<void(const function<void(Read&)>&, const function<void(Read&, Read&)>&)>& for_each_read);
 };
 
 // Keep some basic counts for when verbose mode is enabled
@@ -306,6 +329,17 @@ ostream& operator<<(ostream& os, const Counts& counts);
 
 template <typename Read>
 void ReadFilter<Read>::filter_internal(istream* in) {
+    filter_internal([&](const function<void(Read&)>& lambda, const function<void(Read&, Read&)>& pair_lambda) {
+        if (interleaved) {
+            vg::io::for_each_interleaved_pair_parallel(*in, pair_lambda);
+        } else {
+            vg::io::for_each_parallel(*in, lambda);
+        }
+    });
+}
+
+template <typename Read>
+void ReadFilter<Read>::filter_internal(const function<void(const function<void(Read&)>&, const function<void(Read&, Read&)>&)>& for_each_read) {
     
     // keep counts of what's filtered to report (in verbose mode)
     vector<Counts> counts_vec(threads);
@@ -339,11 +373,7 @@ void ReadFilter<Read>::filter_internal(istream* in) {
         }
     };
     
-    if (interleaved) {
-        vg::io::for_each_interleaved_pair_parallel(*in, pair_lambda);
-    } else {
-        vg::io::for_each_parallel(*in, lambda);
-    }
+    for_each_read(lambda, pair_lambda);
     
     if (verbose) {
         Counts& counts = counts_vec[0];
@@ -372,6 +402,60 @@ inline int ReadFilter<Alignment>::filter(istream* alignment_stream) {
     return 0;
 }
 
+template<>
+inline int ReadFilter<Alignment>::filter_gaf(const string& filename) {
+    
+    if (graph == nullptr) {
+        cerr << "HandleGraph (e.g. XG) required to filter GAF" << endl;
+        return 1;
+    }
+    
+    if (!excluded_refpos_contigs.empty()) {
+        // GAF has no refpos annotations to filter on
+        cerr << "Cannot filter GAF alignments by ref pos" << endl;
+        return 1;
+    }
+    
+    if (write_output) {
+        // Keep an AlignmentEmitter to multiplex output from multiple threads.
+        aln_emitter = get_non_hts_alignment_emitter("-", "GAF", map<string, int64_t>(), get_thread_count(), graph);
+    }
+    
+    // Dropping reads before conversion is only safe if nobody needs to see
+    // the failed reads or what they failed.
+    bool prefilter = !verbose && !complement_filter;
+    
+    filter_internal([&](const function<void(Alignment&)>& lambda, const function<void(Alignment&, Alignment&)>& pair_lambda) {
+        if (interleaved) {
+            function<bool(const gafkluge::GafRecord&, const gafkluge::GafRecord&)> keep_pair;
+            if (prefilter) {
+                keep_pair = [&](const gafkluge::GafRecord& record1, const gafkluge::GafRecord& record2) {
+                    bool fails1 = fails_gaf_fields(record1);
+                    bool fails2 = fails_gaf_fields(record2);
+                    return filter_on_all ? !(fails1 && fails2) : !(fails1 || fails2);
+                };
+            }
+            gaf_filtered_paired_for_each_parallel(*graph, filename, keep_pair, pair_lambda);
+        } else {
+            function<bool(const gafkluge::GafRecord&)> keep;
+            if (prefilter) {
+                keep = [&](const gafkluge::GafRecord& record) {
+                    return !fails_gaf_fields(record);
+                };
+            }
+            gaf_filtered_for_each_parallel(*graph, filename, keep, lambda);
+        }
+    });
+    
+    return 0;
+}
+
+template<>
+inline int ReadFilter<MultipathAlignment>::filter_gaf(const string& filename) {
+    cerr << "Cannot read multipath alignments from GAF" << endl;
+    return 1;
+}
+
 template<>
 inline int ReadFilter<MultipathAlignment>::filter(istream* alignment_stream) {
     
@@ -427,7 +511,7 @@ Counts ReadFilter<Read>::filter_alignment(Read& read) {
     bool keep = true;
     // filter (current) alignment
     if (!name_prefixes.empty()) {
-        if (!matches_name(read)) {
+        if (!matches_name(read.name())) {
             // There are prefixes and we don't match any, so drop the read.
             ++counts.counts[Counts::FilterName::wrong_name];
             keep = false;
@@ -595,7 +679,7 @@ inline double ReadFilter<MultipathAlignment>::get_score(const MultipathAlignment
 }
 
 template<typename Read>
-bool ReadFilter<Read>::matches_name(const Read& aln) const {
+bool ReadFilter<Read>::matches_name(const string& name) const {
     bool keep = true;
     // filter (current) alignment
     if (!name_prefixes.empty()) {
@@ -608,8 +692,8 @@ bool ReadFilter<Read>::matches_name(const Read& aln) const {
         size_t left_bound = 0;
         size_t left_match = 0;
         while (left_match < name_prefixes[left_bound].size() &&
-               left_match < aln.name().size() &&
-               name_prefixes[left_bound][left_match] == aln.name()[left_match]) {
+               left_match < name.size() &&
+               name_prefixes[left_bound][left_match] == name[left_match]) {
             // Scan all the matches at the start
             left_match++;
         }
@@ -617,8 +701,8 @@ bool ReadFilter<Read>::matches_name(const Read& aln) const {
         size_t right_bound = name_prefixes.size() - 1;
         size_t right_match = 0;
         while (right_match < name_prefixes[right_bound].size() &&
-               right_match < aln.name().size() &&
-               name_prefixes[right_bound][right_match] == aln.name()[right_match]) {
+               right_match < name.size() &&
+               name_prefixes[right_bound][right_match] == name[right_match]) {
             // Scan all the matches at the end
             right_match++;
         }
@@ -634,8 +718,8 @@ bool ReadFilter<Read>::matches_name(const Read& aln) const {
                 size_t center_match = min(left_match, right_match);
                 
                 while (center_match < name_prefixes[center].size() &&
-                       center_match < aln.name().size() &&
-                       name_prefixes[center][center_match] == aln.name()[center_match]) {
+                       center_match < name.size() &&
+                       name_prefixes[center][center_match] == name[center_match]) {
                     // Scan all the matches here
                     center_match++;
                 }
@@ -646,8 +730,8 @@ bool ReadFilter<Read>::matches_name(const Read& aln) const {
                     break;
                 }
                 
-                if (center_match == aln.name().size() ||
-                    name_prefixes[center][center_match] > aln.name()[center_match]) {
+                if (center_match == name.size() ||
+                    name_prefixes[center][center_match] > name[center_match]) {
                     // The match, if it exists, must be before us
                     right_bound = center;
                     right_match = center_match;
@@ -668,6 +752,28 @@ bool ReadFilter<Read>::matches_name(const Read& aln) const {
     return keep;
 }
 
+template<typename Read>
+bool ReadFilter<Read>::fails_gaf_fields(const gafkluge::GafRecord& record) const {
+    if (!name_prefixes.empty() && !matches_name(record.query_name)) {
+        return true;
+    }
+    if (min_mapq > 0 && gaf_mapping_quality(record) < min_mapq) {
+        return true;
+    }
+    if (!sub_score && !rescore) {
+        // We don't know if the read is secondary yet, so it has to fail both
+        // score thresholds.
+        double score = gaf_score(record);
+        if (frac_score && record.query_length > 0) {
+            score /= record.query_length;
+        }
+        if (score < min(min_primary, min_secondary)) {
+            return true;
+        }
+    }
+    return false;
+}
+
 template<>
 inline bool ReadFilter<MultipathAlignment>::has_excluded_refpos(const MultipathAlignment& read) const {
     // TODO: multipath alignments don't record refpos
@@ -0,0 +1,590 @@
+/**
+ * \file safari_server.cpp
+ * Implements the persistent "vg safari" mapping server and its client side.
+ */
+
+#include "safari_server.hpp"
+
+#include "alignment.hpp"
+#include "hts_alignment_emitter.hpp"
+#include "utility.hpp"
+
+#include <vg/io/stream.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+#include <omp.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace vg {
+using namespace std;
+
+/// How many ambiguous pairs do we hold while learning a job's fragment length
+/// distribution, before we give up and finalize it? Matches "vg safari".
+static const size_t MAX_BUFFERED_PAIRS = 100000;
+
+void SafariJob::serialize(ostream& out) const {
+    if (shutdown) {
+        out << "shutdown\n\n";
+        return;
+    }
+    if (!fastq_1.empty()) {
+        out << "fastq-in " << fastq_1 << "\n";
+    }
+    if (!fastq_2.empty()) {
+        out << "fastq-in " << fastq_2 << "\n";
+    }
+    if (!gam_filename.empty()) {
+        out << "gam-in " << gam_filename << "\n";
+    }
+    if (interleaved) {
+        out << "interleaved\n";
+    }
+    out << "output " << output_filename << "\n";
+    out << "output-format " << output_format << "\n";
+    if (!deam_3p.empty()) {
+        out << "deam-3p " << deam_3p << "\n";
+    }
+    if (!deam_5p.empty()) {
+        out << "deam-5p " << deam_5p << "\n";
+    }
+    for (auto& setting : settings) {
+        out << setting.first << " " << setting.second << "\n";
+    }
+    out << "\n";
+}
+
+SafariJob SafariJob::parse(const string& text) {
+    SafariJob job;
+    stringstream in(text);
+    string line;
+    while (getline(in, line) && !line.empty()) {
+        // Everything after the first space is the value, so file names can
+        // have spaces in them.
+        size_t space = line.find(' ');
+        string key = line.substr(0, space);
+        string value = (space == string::npos ? "" : line.substr(space + 1));
+
+        if (key == "shutdown") {
+            job.shutdown = true;
+        } else if (key == "interleaved") {
+            job.interleaved = true;
+        } else if (value.empty()) {
+            throw runtime_error("no value for " + key);
+        } else if (key == "fastq-in") {
+            if (job.fastq_1.empty()) {
+                job.fastq_1 = value;
+            } else if (job.fastq_2.empty()) {
+                job.fastq_2 = value;
+            } else {
+                throw runtime_error("more than two FASTQ files");
+            }
+        } else if (key == "gam-in") {
+            job.gam_filename = value;
+        } else if (key == "output") {
+            job.output_filename = value;
+        } else if (key == "output-format") {
+            job.output_format = value;
+        } else if (key == "deam-3p") {
+            job.deam_3p = value;
+        } else if (key == "deam-5p") {
+            job.deam_5p = value;
+        } else {
+            // Anything else is a mapper setting, which gets checked when the
+            // job runs.
+            job.settings[key] = value;
+        }
+    }
+    return job;
+}
+
+/// Something that can change one mapper setting from its string form, and
+/// returns a function that puts the old value back.
+using SettingChanger = function<function<void()>(MinimizerMapper&, const string&)>;
+
+template<typename T>
+static SettingChanger change_setting(T MinimizerMapper::* field) {
+    return [field](MinimizerMapper& mapper, const string& value) {
+        T parsed;
+        stringstream in(value);
+        if (!(in >> parsed) || !(in >> ws).eof()) {
+            throw runtime_error("could not parse \"" + value + "\"");
+        }
+        T old_value = mapper.*field;
+        mapper.*field = parsed;
+        return function<void()>([&mapper, field, old_value]() {
+            mapper.*field = old_value;
+        });
+    };
+}
+
+/// Get the mapper settings a job can change, by "vg safari" long option name.
+static const map<string, SettingChanger>& get_job_settings() {
+    static const map<string, SettingChanger> job_settings = {
+        {"hit-cap", change_setting(&MinimizerMapper::hit_cap)},
+        {"hard-hit-cap", change_setting(&MinimizerMapper::hard_hit_cap)},
+        {"score-fraction", change_setting(&MinimizerMapper::minimizer_score_fraction)},
+        {"max-min", change_setting(&MinimizerMapper::max_unique_min)},
+        {"num-bp-per-min", change_setting(&MinimizerMapper::num_bp_per_min)},
+        {"distance-limit", change_setting(&MinimizerMapper::distance_limit)},
+        {"max-extensions", change_setting(&MinimizerMapper::max_extensions)},
+        {"max-alignments", change_setting(&MinimizerMapper::max_alignments)},
+        {"cluster-score", change_setting(&MinimizerMapper::cluster_score_threshold)},
+        {"pad-cluster-score", change_setting(&MinimizerMapper::pad_cluster_score_threshold)},
+        {"cluster-coverage", change_setting(&MinimizerMapper::cluster_coverage_threshold)},
+        {"extension-score", change_setting(&MinimizerMapper::extension_score_threshold)},
+        {"extension-set", change_setting(&MinimizerMapper::extension_set_score_threshold)},
+        {"max-multimaps", change_setting(&MinimizerMapper::max_multimaps)},
+        {"rescue-attempts", change_setting(&MinimizerMapper::max_rescue_attempts)},
+        {"paired-distance-limit", change_setting(&MinimizerMapper::paired_distance_stdevs)},
+        {"rescue-subgraph-size", change_setting(&MinimizerMapper::rescue_subgraph_stdevs)},
+        {"rescue-seed-limit", change_setting(&MinimizerMapper::rescue_seed_limit)},
+        {"gbwt-cache-records", change_setting(&MinimizerMapper::gbwt_cache_records)},
+        {"max-dozeu-cells", change_setting(&MinimizerMapper::max_dozeu_cells)},
+        {"max-fragment-length", change_setting(&MinimizerMapper::max_fragment_length)},
+        {"posterior-odds-threshold", change_setting(&MinimizerMapper::posterior_threshold)},
+        {"spurious-alignment-prior", change_setting(&MinimizerMapper::spurious_alignment_prior)},
+        {"sample", change_setting(&MinimizerMapper::sample_name)},
+        {"read-group", change_setting(&MinimizerMapper::read_group)}
+    };
+    return job_settings;
+}
+
+SafariServer::SafariServer(MinimizerMapper& mapper, const HandleGraph& graph,
+                           const PathPositionHandleGraph* path_graph, const string& ref_paths_name) :
+    mapper(mapper), graph(graph), path_graph(path_graph), ref_paths_name(ref_paths_name),
+    default_deam_3p(mapper.deam3pfreqE), default_deam_5p(mapper.deam5pfreqE),
+    default_fragment_forced(mapper.fragment_distr_is_finalized()),
+    default_fragment_mean(mapper.get_fragment_length_mean()),
+    default_fragment_stdev(mapper.get_fragment_length_stdev()) {
+    // Jobs change settings and map different reads, and the stages a sweep
+    // keeps are only right for the settings they were computed with.
+    mapper.stage_cache = nullptr;
+}
+
+/// Could we write to the given file, without changing it or creating it?
+static bool can_write(const string& filename) {
+    if (access(filename.c_str(), F_OK) == 0) {
+        return access(filename.c_str(), W_OK) == 0;
+    }
+    // It would have to be created in its directory.
+    size_t slash = filename.rfind('/');
+    string directory = (slash == string::npos) ? "." : (slash == 0 ? "/" : filename.substr(0, slash));
+    return access(directory.c_str(), W_OK | X_OK) == 0;
+}
+
+size_t SafariServer::run(const SafariJob& job, const function<void(const string&)>& report) {
+
+    // Check the job over before we change anything.
+    if (job.fastq_1.empty() == job.gam_filename.empty()) {
+        throw runtime_error("job needs either FASTQ or GAM input");
+    }
+    if (!job.fastq_2.empty() && job.interleaved) {
+        throw runtime_error("job can't have both a second FASTQ file and interleaved input");
+    }
+    for (const string& input : {job.fastq_1, job.fastq_2, job.gam_filename}) {
+        if (!input.empty() && !ifstream(input).is_open()) {
+            throw runtime_error("could not open " + input);
+        }
+    }
+    if (job.output_filename.empty() || job.output_filename == "-") {
+        throw runtime_error("job needs an output file");
+    }
+    if (!can_write(job.output_filename)) {
+        throw runtime_error("could not write to " + job.output_filename);
+    }
+    static const set<string> output_formats = { "GAM", "GAF", "JSON", "TSV", "SAM", "BAM", "CRAM" };
+    if (!output_formats.count(job.output_format)) {
+        throw runtime_error("unknown output format " + job.output_format);
+    }
+    bool hts_output = (job.output_format == "SAM" || job.output_format == "BAM" || job.output_format == "CRAM");
+    if (hts_output && path_graph == nullptr) {
+        throw runtime_error("server has no path positions for " + job.output_format + " output");
+    }
+    if (job.deam_3p.empty() != job.deam_5p.empty()) {
+        throw runtime_error("job needs both deamination profiles, or neither");
+    }
+
+    // Apply the job's settings, remembering how to put the server's back.
+    vector<function<void()>> undo;
+    auto restore = [&]() {
+        for (auto it = undo.rbegin(); it != undo.rend(); ++it) {
+            (*it)();
+        }
+        undo.clear();
+    };
+
+    try {
+        auto& job_settings = get_job_settings();
+        for (auto& setting : job.settings) {
+            if (setting.first == "fragment-mean" || setting.first == "fragment-stdev") {
+                // These go to the fragment length distribution instead.
+                continue;
+            }
+            auto found = job_settings.find(setting.first);
+            if (found == job_settings.end()) {
+                throw runtime_error("unknown setting " + setting.first);
+            }
+            try {
+                undo.push_back(found->second(mapper, setting.second));
+            } catch (runtime_error& e) {
+                throw runtime_error("bad value for " + setting.first + ": " + e.what());
+            }
+        }
+
+        // Damage tables are expensive, so only rebuild them when the job
+        // wants different ones than we have.
+        string deam_3p = job.deam_3p.empty() ? default_deam_3p : job.deam_3p;
+        string deam_5p = job.deam_5p.empty() ? default_deam_5p : job.deam_5p;
+        if (deam_3p != mapper.deam3pfreqE || deam_5p != mapper.deam5pfreqE) {
+            mapper.set_damage_profiles(deam_3p, deam_5p);
+        }
+
+        // Each job is its own library, with its own fragment lengths, unless
+        // the server was told what they are.
+        mapper.reset_fragment_length_distr();
+        if (default_fragment_forced) {
+            mapper.force_fragment_length_distr(default_fragment_mean, default_fragment_stdev);
+        }
+        auto mean = job.settings.find("fragment-mean");
+        auto stdev = job.settings.find("fragment-stdev");
+        if ((mean == job.settings.end()) != (stdev == job.settings.end())) {
+            throw runtime_error("job needs both fragment-mean and fragment-stdev, or neither");
+        }
+        if (mean != job.settings.end()) {
+            double fragment_mean;
+            double fragment_stdev;
+            bool parsed;
+            try {
+                parsed = parse<double>(mean->second, fragment_mean) && parse<double>(stdev->second, fragment_stdev);
+            } catch (exception& e) {
+                parsed = false;
+            }
+            if (!parsed) {
+                throw runtime_error("could not parse fragment-mean and fragment-stdev");
+            }
+            mapper.force_fragment_length_distr(fragment_mean, fragment_stdev);
+        }
+
+        size_t reads_mapped = map_reads(job, hts_output, report);
+        restore();
+        return reads_mapped;
+    } catch (...) {
+        restore();
+        throw;
+    }
+}
+
+size_t SafariServer::map_reads(const SafariJob& job, bool hts_output, const function<void(const string&)>& report) {
+
+    size_t thread_count = omp_get_max_threads();
+
+    // Look up all the paths we might need to surject to.
+    vector<tuple<path_handle_t, size_t, size_t>> paths;
+    if (hts_output) {
+        paths = get_sequence_dictionary(ref_paths_name, {}, *path_graph);
+    }
+
+    atomic<size_t> reads_mapped(0);
+    // Count some mapped reads, and tell the client when we pass a multiple of
+    // the progress interval.
+    auto count_reads = [&](size_t count) {
+        size_t before = reads_mapped.fetch_add(count);
+        if ((before + count) / progress_interval != before / progress_interval) {
+            #pragma omp critical (safari_server_report)
+            report("progress " + to_string(before + count));
+        }
+    };
+
+    {
+        const HandleGraph* emitter_graph = path_graph ? (const HandleGraph*)path_graph : &graph;
+        unique_ptr<AlignmentEmitter> alignment_emitter = get_alignment_emitter(job.output_filename, job.output_format,
+                                                                               paths, thread_count, emitter_graph,
+                                                                               emitter_flags);
+
+        if (job.interleaved || !job.fastq_2.empty()) {
+            // Pairs that can't be placed until we know the fragment length
+            // distribution. Only one thread runs while they are collected.
+            vector<pair<Alignment, Alignment>> ambiguous_pair_buffer;
+
+            auto distribution_is_ready = [&]() {
+                return mapper.fragment_distr_is_finalized();
+            };
+
+            auto emit_pair = [&](pair<vector<Alignment>, vector<Alignment>>& mapped_pairs) {
+                int64_t tlen_limit = 0;
+                if (hts_output && mapper.fragment_distr_is_finalized()) {
+                    tlen_limit = mapper.get_fragment_length_mean() + 6 * mapper.get_fragment_length_stdev();
+                }
+                alignment_emitter->emit_mapped_pair(std::move(mapped_pairs.first), std::move(mapped_pairs.second), tlen_limit);
+                count_reads(2);
+            };
+
+            auto map_read_pair = [&](Alignment& aln1, Alignment& aln2) {
+                toUppercaseInPlace(*aln1.mutable_sequence());
+                toUppercaseInPlace(*aln2.mutable_sequence());
+
+                auto mapped_pairs = mapper.map_paired(aln1, aln2, ambiguous_pair_buffer);
+                if (!mapped_pairs.first.empty() && !mapped_pairs.second.empty()) {
+                    emit_pair(mapped_pairs);
+                }
+                if (!mapper.fragment_distr_is_finalized() && ambiguous_pair_buffer.size() >= MAX_BUFFERED_PAIRS) {
+                    // Don't run out of memory waiting for unambiguous pairs.
+                    mapper.finalize_fragment_length_distr();
+                }
+            };
+
+            if (!job.gam_filename.empty()) {
+                get_input_file(job.gam_filename, [&](istream& in) {
+                    vg::io::for_each_interleaved_pair_parallel_after_wait<Alignment>(in, map_read_pair, distribution_is_ready);
+                });
+            } else if (!job.fastq_2.empty()) {
+                fastq_paired_two_files_for_each_parallel_after_wait(job.fastq_1, job.fastq_2, map_read_pair, distribution_is_ready);
+            } else {
+                fastq_paired_interleaved_for_each_parallel_after_wait(job.fastq_1, map_read_pair, distribution_is_ready);
+            }
+
+            // Now place the ambiguous pairs.
+            mapper.finalize_fragment_length_distr();
+            for (auto& alignment_pair : ambiguous_pair_buffer) {
+                auto mapped_pairs = mapper.map_paired(alignment_pair.first, alignment_pair.second);
+                emit_pair(mapped_pairs);
+            }
+        } else {
+            auto map_read = [&](Alignment& aln) {
+                toUppercaseInPlace(*aln.mutable_sequence());
+                mapper.map(aln, *alignment_emitter);
+                count_reads(1);
+            };
+
+            if (!job.gam_filename.empty()) {
+                get_input_file(job.gam_filename, [&](istream& in) {
+                    vg::io::for_each_parallel<Alignment>(in, map_read);
+                });
+            } else {
+                fastq_unpaired_for_each_parallel(job.fastq_1, map_read);
+            }
+        }
+    } // Make sure the emitter is destroyed and all alignments are on disk.
+
+    return reads_mapped;
+}
+
+/// Make the address for a UNIX socket at the given path.
+static sockaddr_un get_socket_address(const string& socket_path) {
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socket_path.empty() || socket_path.size() >= sizeof(address.sun_path)) {
+        throw runtime_error("socket path \"" + socket_path + "\" is empty or too long");
+    }
+    strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+    return address;
+}
+
+/// Write all of the given data to a socket. Returns false if the other end
+/// has gone away.
+static bool send_all(int fd, const string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        // Don't get killed by SIGPIPE if the other end is gone.
+        ssize_t written = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        sent += written;
+    }
+    return true;
+}
+
+/// How long can a job's text be? Real jobs are a few lines.
+static const size_t MAX_JOB_BYTES = 1024 * 1024;
+
+/// Read a job's text from a socket, up to the empty line that ends it or
+/// until the other end closes. Throws runtime_error if the socket's receive
+/// timeout passes first, or the text is too long.
+static string receive_job_text(int fd) {
+    string text;
+    char buffer[4096];
+    while (text.find("\n\n") == string::npos) {
+        ssize_t got = recv(fd, buffer, sizeof(buffer), 0);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            throw runtime_error("timed out waiting for job");
+        }
+        if (got <= 0) {
+            break;
+        }
+        text.append(buffer, got);
+        if (text.size() > MAX_JOB_BYTES) {
+            throw runtime_error("job is too long");
+        }
+    }
+    return text;
+}
+
+/// Is the process on the other end of a UNIX socket run by the same user as
+/// this one?
+static bool is_same_user(int fd) {
+#ifdef SO_PEERCRED
+    ucred credentials;
+    socklen_t length = sizeof(credentials);
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &length) != 0) {
+        return false;
+    }
+    return credentials.uid == getuid();
+#else
+    // Without a way to ask, rely on the socket's permissions.
+    return true;
+#endif
+}
+
+void SafariServer::serve(const string& socket_path) {
+    sockaddr_un address;
+    try {
+        address = get_socket_address(socket_path);
+    } catch (runtime_error& e) {
+        cerr << "error[vg::SafariServer]: " << e.what() << endl;
+        exit(1);
+    }
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        cerr << "error[vg::SafariServer]: could not create socket: " << strerror(errno) << endl;
+        exit(1);
+    }
+    // Replace any socket left behind by a server that didn't clean up.
+    unlink(socket_path.c_str());
+    // Jobs read and write files as us, so nobody else gets to connect. Make
+    // the socket with no permissions for others, so there's no window where
+    // it is open to them.
+    mode_t old_umask = umask(0177);
+    int bound = ::bind(listener, (sockaddr*) &address, sizeof(address));
+    umask(old_umask);
+    if (bound != 0 || chmod(socket_path.c_str(), 0600) != 0 || listen(listener, 64) != 0) {
+        cerr << "error[vg::SafariServer]: could not listen on " << socket_path << ": " << strerror(errno) << endl;
+        exit(1);
+    }
+    if (show_progress) {
+        cerr << "Serving mapping jobs on " << socket_path << endl;
+    }
+
+    bool running = true;
+    while (running) {
+        int client = accept(listener, nullptr, nullptr);
+        if (client < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            cerr << "error[vg::SafariServer]: could not accept connection: " << strerror(errno) << endl;
+            exit(1);
+        }
+
+        if (!is_same_user(client)) {
+            if (show_progress) {
+                cerr << "Refused connection from another user" << endl;
+            }
+            close(client);
+            continue;
+        }
+
+        // Don't wait forever on a client that stops talking or listening.
+        timeval timeout;
+        timeout.tv_sec = socket_timeout_seconds;
+        timeout.tv_usec = 0;
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+        // Stop sending reports if the client goes away, but finish the job.
+        bool client_connected = true;
+        auto report = [&](const string& line) {
+            client_connected = client_connected && send_all(client, line + "\n");
+        };
+
+        try {
+            SafariJob job = SafariJob::parse(receive_job_text(client));
+            if (job.shutdown) {
+                running = false;
+                report("done 0 0");
+            } else {
+                if (show_progress) {
+                    cerr << "Mapping " << (job.gam_filename.empty() ? job.fastq_1 : job.gam_filename)
+                         << " to " << job.output_filename << " (" << job.output_format << ")" << endl;
+                }
+                auto start = chrono::steady_clock::now();
+                size_t reads_mapped = run(job, report);
+                chrono::duration<double> seconds = chrono::steady_clock::now() - start;
+                if (show_progress) {
+                    cerr << "Mapped " << reads_mapped << " reads in " << seconds.count() << " seconds" << endl;
+                }
+                report("done " + to_string(reads_mapped) + " " + to_string(seconds.count()));
+            }
+        } catch (exception& e) {
+            if (show_progress) {
+                cerr << "Job failed: " << e.what() << endl;
+            }
+            report(string("error ") + e.what());
+        }
+        close(client);
+    }
+
+    close(listener);
+    unlink(socket_path.c_str());
+}
+
+bool submit_safari_job(const string& socket_path, const SafariJob& job, ostream& progress) {
+    sockaddr_un address = get_socket_address(socket_path);
+
+    int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server < 0 || connect(server, (sockaddr*) &address, sizeof(address)) != 0) {
+        throw runtime_error("could not connect to " + socket_path + ": " + strerror(errno));
+    }
+
+    stringstream request;
+    job.serialize(request);
+    if (!send_all(server, request.str())) {
+        close(server);
+        throw runtime_error("could not send job to " + socket_path + ": " + strerror(errno));
+    }
+
+    // Pass along report lines as they come, and remember the last one.
+    string pending;
+    string last_line;
+    char buffer[4096];
+    while (true) {
+        ssize_t got = recv(server, buffer, sizeof(buffer), 0);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            break;
+        }
+        pending.append(buffer, got);
+        size_t newline;
+        while ((newline = pending.find('\n')) != string::npos) {
+            last_line = pending.substr(0, newline);
+            pending.erase(0, newline + 1);
+            progress << last_line << endl;
+        }
+    }
+    close(server);
+
+    return last_line.compare(0, 5, "done ") == 0;
+}
+
+}
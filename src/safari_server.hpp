@@ -0,0 +1,137 @@
+#ifndef VG_SAFARI_SERVER_HPP_INCLUDED
+#define VG_SAFARI_SERVER_HPP_INCLUDED
+
+/**
+ * \file safari_server.hpp
+ * A persistent "vg safari" mapping server, which keeps its indexes loaded and
+ * runs mapping jobs sent to it over a local UNIX socket, and the client side
+ * for submitting jobs to it.
+ */
+
+#include "minimizer_mapper.hpp"
+
+#include <functional>
+#include <iostream>
+#include <map>
+#include <string>
+
+namespace vg {
+using namespace std;
+
+/**
+ * One mapping job for a SafariServer: what to map, where to write it, and any
+ * mapper settings that should differ from the server's own.
+ *
+ * On the wire a job is a series of "key value" lines, ended by an empty line.
+ */
+struct SafariJob {
+    /// FASTQ files to map. If both are set, they hold the two mates.
+    string fastq_1;
+    string fastq_2;
+    /// Or a GAM file to remap.
+    string gam_filename;
+    /// Is the single input file interleaved pairs?
+    bool interleaved = false;
+
+    /// File to write alignments to. Must not be "-", since the server's
+    /// standard output is not the client's.
+    string output_filename;
+    /// Format to write alignments in, as for "vg safari -o".
+    string output_format = "GAM";
+
+    /// Deamination profiles to score with. If empty, the server's are used.
+    string deam_3p;
+    string deam_5p;
+
+    /// Mapper settings to change for this job, by their "vg safari" long
+    /// option names (like "hit-cap"), as strings to be parsed.
+    map<string, string> settings;
+
+    /// If set, this isn't a job at all, and the server should stop.
+    bool shutdown = false;
+
+    /// Write the job out in wire format.
+    void serialize(ostream& out) const;
+
+    /// Parse a job from wire format. Throws runtime_error if it is malformed.
+    static SafariJob parse(const string& text);
+};
+
+/**
+ * Serves mapping jobs against a MinimizerMapper whose indexes stay loaded
+ * between jobs.
+ *
+ * Jobs are run one at a time, in the order clients connect, and each one gets
+ * all the OpenMP threads. Settings from the job are applied to the mapper for
+ * the length of the job, and then put back to the server's defaults.
+ *
+ * While a job runs, the server reports back to its client with lines of
+ * "progress N" as reads are mapped, and finishes with either "done N SECONDS"
+ * or "error MESSAGE".
+ */
+class SafariServer {
+public:
+
+    /// Make a server that maps with the given mapper, which has already had
+    /// the server's default settings applied. Alignments are emitted against
+    /// the given graph, or, if set, against the path position graph, which is
+    /// required for SAM/BAM/CRAM jobs. Reference paths for HTSlib headers come
+    /// from the given file, or from the graph if it is empty. The mapper's
+    /// stage cache is detached, since jobs do not share stages.
+    SafariServer(MinimizerMapper& mapper, const HandleGraph& graph,
+                 const PathPositionHandleGraph* path_graph = nullptr,
+                 const string& ref_paths_name = "");
+
+    /// Listen on the given UNIX socket path and run jobs until a client asks
+    /// the server to shut down. A stale socket file at the path is replaced.
+    /// The socket is only accessible to, and only accepts jobs from, the user
+    /// running the server, since jobs read and write files as that user.
+    void serve(const string& socket_path);
+
+    /// Run one job, sending progress lines to the given function. Returns the
+    /// number of reads mapped. Throws runtime_error if the job can't be run.
+    size_t run(const SafariJob& job, const function<void(const string&)>& report);
+
+    /// Report progress after about this many reads.
+    size_t progress_interval = 100000;
+
+    /// Log jobs to standard error.
+    bool show_progress = false;
+
+    /// Flags from alignment_emitter_flags_t to emit every job's alignments
+    /// with. Sorting is per output file and isn't offered.
+    int emitter_flags = 0;
+
+    /// Give up on a client that takes longer than this many seconds to send
+    /// its job, or to take a progress report, so it can't stall the server.
+    int socket_timeout_seconds = 60;
+
+protected:
+    /// Map the reads for a job that has been checked and set up, and return
+    /// how many were mapped.
+    size_t map_reads(const SafariJob& job, bool hts_output, const function<void(const string&)>& report);
+
+    MinimizerMapper& mapper;
+    const HandleGraph& graph;
+    const PathPositionHandleGraph* path_graph;
+    string ref_paths_name;
+
+    /// Server's own deamination profiles, used by jobs that don't give any.
+    string default_deam_3p;
+    string default_deam_5p;
+
+    /// Server's own fragment length distribution, if it was given one, for
+    /// jobs that don't give one. Otherwise each job learns its own.
+    bool default_fragment_forced;
+    double default_fragment_mean;
+    double default_fragment_stdev;
+};
+
+/// Send a job to the SafariServer listening on the given socket, and copy its
+/// progress reports to the given stream as they arrive. Returns true if the
+/// job finished successfully.
+bool submit_safari_job(const string& socket_path, const SafariJob& job, ostream& progress);
+
+}
+
+#endif
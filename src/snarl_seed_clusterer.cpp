@@ -26,6 +26,16 @@ SnarlDistanceIndexClusterer::SnarlDistanceIndexClusterer( const SnarlDistanceInd
 vector<SnarlDistanceIndexClusterer::Cluster> SnarlDistanceIndexClusterer::cluster_seeds (const vector<Seed>& seeds, size_t read_distance_limit) const {
     //Wrapper for single ended
 
+    if (seeds_form_one_linear_cluster(seeds, read_distance_limit)) {
+        //Short reads usually land in one place, so skip building the problem
+        vector<Cluster> result(1);
+        result.front().seeds.resize(seeds.size());
+        for (size_t i = 0 ; i < seeds.size() ; i++) {
+            result.front().seeds[i] = i;
+        }
+        return result;
+    }
+
     vector<SeedCache> seed_caches(seeds.size());
     for (size_t i = 0 ; i < seeds.size() ; i++) {
         seed_caches[i].pos = seeds[i].pos;
@@ -122,6 +132,111 @@ vector<vector<SnarlDistanceIndexClusterer::Cluster>> SnarlDistanceIndexClusterer
 }
 
 
+bool SnarlDistanceIndexClusterer::seeds_form_one_linear_cluster(const vector<Seed>& seeds, size_t read_distance_limit) const {
+    if (seeds.empty()) {
+        return false;
+    }
+
+    //The range of positions of the seeds along their node or chain, counting
+    //from 1 like distance_left in get_nodes()
+    size_t min_offset = std::numeric_limits<size_t>::max();
+    size_t max_offset = 0;
+
+    const Seed& first_seed = seeds.front();
+    id_t first_id = id(first_seed.pos);
+    bool same_node = true;
+    for (const Seed& seed : seeds) {
+        if (id(seed.pos) != first_id) {
+            same_node = false;
+            break;
+        }
+    }
+
+    if (same_node) {
+        size_t node_length = first_seed.minimizer_cache != MIPayload::NO_CODE
+                           ? MIPayload::node_length(first_seed.minimizer_cache)
+                           : distance_index.minimum_length(distance_index.get_node_net_handle(first_id));
+        if (node_length == std::numeric_limits<size_t>::max()) {
+            return false;
+        }
+        for (const Seed& seed : seeds) {
+            size_t seed_offset = is_rev(seed.pos) ? node_length - offset(seed.pos) : offset(seed.pos) + 1;
+            min_offset = std::min(min_offset, seed_offset);
+            max_offset = std::max(max_offset, seed_offset);
+        }
+    } else {
+        //Every seed needs to be on a node that is a proper child of the same chain
+        //component, so its prefix sum in the chain is in its payload
+        //cached values are:
+        //(0)record offset of node, (1)record offset of parent, (2)node record offset, (3)node length, (4)is_reversed, 
+        // (5)is_trivial_chain, (6)parent is chain, (7)parent is root, (8)prefix sum, (9)chain_component
+        if (first_seed.minimizer_cache == MIPayload::NO_CODE) {
+            return false;
+        }
+        size_t parent_offset = MIPayload::parent_record_offset(first_seed.minimizer_cache);
+        size_t component = MIPayload::chain_component(first_seed.minimizer_cache);
+        for (const Seed& seed : seeds) {
+            const gbwtgraph::payload_type& cache = seed.minimizer_cache;
+            if (cache == MIPayload::NO_CODE || MIPayload::is_trivial_chain(cache) || !MIPayload::parent_is_chain(cache)
+                || MIPayload::parent_record_offset(cache) != parent_offset || parent_offset == 0
+                || MIPayload::chain_component(cache) != component) {
+                return false;
+            }
+            size_t prefix_sum = MIPayload::prefix_sum(cache);
+            size_t node_length = MIPayload::node_length(cache);
+            if (prefix_sum == std::numeric_limits<size_t>::max() || node_length == std::numeric_limits<size_t>::max()) {
+                return false;
+            }
+            size_t seed_offset = prefix_sum + (MIPayload::is_reversed(cache) != is_rev(seed.pos) ? node_length - offset(seed.pos)
+                                                                                           : offset(seed.pos) + 1);
+            min_offset = std::min(min_offset, seed_offset);
+            max_offset = std::max(max_offset, seed_offset);
+        }
+    }
+
+    //Walking along the node or chain between neighboring seeds is never longer
+    //than the whole range, so if the range fits every seed is close enough
+    //to the next one. Seeds farther apart might still be connected some
+    //other way, so then we need the full clustering.
+    return max_offset - min_offset <= read_distance_limit;
+}
+
+void SnarlDistanceIndexClusterer::ClusteringProblem::reset (vector<vector<SeedCache>*>* all_seeds, 
+           size_t read_distance_limit, size_t fragment_distance_limit, size_t seed_count) {
+    this->all_seeds = all_seeds;
+    this->read_distance_limit = read_distance_limit;
+    this->fragment_distance_limit = fragment_distance_limit;
+    fragment_union_find = structures::UnionFind(seed_count, false);
+
+    seed_count_prefix_sum.assign(1, 0);
+    read_union_find.clear();
+    for (size_t i = 0 ; i < all_seeds->size() ; i++) {
+        size_t size = all_seeds->at(i)->size();
+        size_t offset = seed_count_prefix_sum.back() + size;
+        seed_count_prefix_sum.push_back(offset);
+        read_union_find.emplace_back(size, false);
+
+    }
+
+    //Clearing the hash table takes time in its bucket count, so after a read
+    //much bigger than this one, start a new table rather than clear the big one
+    if (net_handle_to_node_problem_index.bucket_count() > 20*seed_count + 1024) {
+        net_handle_to_node_problem_index = hash_map<net_handle_t, size_t>();
+    } else {
+        net_handle_to_node_problem_index.clear();
+    }
+    net_handle_to_node_problem_index.reserve(5*seed_count);
+    all_node_problems.clear();
+    all_node_problems.reserve(5*seed_count);
+    current_chains = nullptr;
+    parent_chains = nullptr;
+    parent_snarls.clear();
+    root_children.clear();
+    root_children.reserve(seed_count);
+}
+
+thread_local SnarlDistanceIndexClusterer::ClusteringProblem SnarlDistanceIndexClusterer::reusable_problem;
+
 tuple<vector<structures::UnionFind>, structures::UnionFind> SnarlDistanceIndexClusterer::cluster_seeds_internal (
               vector<vector<SeedCache>*>& all_seeds, 
               size_t read_distance_limit, size_t fragment_distance_limit) const {
@@ -153,7 +268,8 @@ cerr << "\tread distance limit: " << read_distance_limit << " and fragment dista
     //It also keeps track of the parents of the current level
     size_t seed_count = 0;
     for (auto v : all_seeds) seed_count+= v->size();
-    ClusteringProblem clustering_problem (&all_seeds, read_distance_limit, fragment_distance_limit, seed_count);
+    ClusteringProblem& clustering_problem = reusable_problem;
+    clustering_problem.reset(&all_seeds, read_distance_limit, fragment_distance_limit, seed_count);
 
 
     //Initialize chains_by_level with all the seeds on chains
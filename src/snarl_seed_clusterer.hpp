@@ -54,14 +54,13 @@ class SnarlDistanceIndexClusterer {
     public:
 
         /// Seed information used in Giraffe.
+        /// This is kept small and free of owning members, since clustering
+        /// copies seeds around a lot. Per-minimizer strings (sequence, rymer
+        /// sequence, mismatches) live in a side table indexed by source.
         struct Seed {
             pos_t  pos;
             size_t source; // Source minimizer.
             gbwtgraph::payload_type minimizer_cache = MIPayload::NO_CODE; //minimizer payload
-            string seq="";
-            bool from_rymer = false; // add this field
-            string rymer_seq="";
-            vector<int> mismatch_positions;
         };
 
         /// Seed information used for clustering
@@ -387,26 +386,28 @@ class SnarlDistanceIndexClusterer {
             //the total number of seeds in all_seeds
             ClusteringProblem (vector<vector<SeedCache>*>* all_seeds, 
                        size_t read_distance_limit, size_t fragment_distance_limit, size_t seed_count) :
-                all_seeds(all_seeds),
-                read_distance_limit(read_distance_limit),
-                fragment_distance_limit(fragment_distance_limit),
-                fragment_union_find (seed_count, false),
-                seed_count_prefix_sum(1,0){
-
-                for (size_t i = 0 ; i < all_seeds->size() ; i++) {
-                    size_t size = all_seeds->at(i)->size();
-                    size_t offset = seed_count_prefix_sum.back() + size;
-                    seed_count_prefix_sum.push_back(offset);
-                    read_union_find.emplace_back(size, false);
-
-                }
-
-                net_handle_to_node_problem_index.reserve(5*seed_count);
-                all_node_problems.reserve(5*seed_count);
-                root_children.reserve(seed_count);
+                fragment_union_find (0, false) {
+                reset(all_seeds, read_distance_limit, fragment_distance_limit, seed_count);
             }
+
+            //Make an empty problem, to be set up with reset()
+            ClusteringProblem () : fragment_union_find (0, false) {}
+
+            //Set up the problem for new seeds, keeping the memory the
+            //buffers got for the last problem
+            void reset (vector<vector<SeedCache>*>* all_seeds, 
+                       size_t read_distance_limit, size_t fragment_distance_limit, size_t seed_count);
         };
 
+        //Each thread reuses its ClusteringProblem buffers from read to read
+        static thread_local ClusteringProblem reusable_problem;
+
+        //If all the seeds are on one node, or on nodes directly on one chain, and
+        //their payloads put them all within the read distance limit of each
+        //other, then they must form one cluster, and we don't need to walk the
+        //snarl tree. Return true if that's the case.
+        bool seeds_form_one_linear_cluster(const vector<Seed>& seeds, size_t read_distance_limit) const;
+
         //Go through all the seeds and assign them to their parent chains or roots
         //If a node is in a chain, then assign it to its parent chain and add the parent
         //chain to chain_to_children_by_level
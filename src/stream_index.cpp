@@ -500,6 +500,103 @@ auto StreamIndexBase::is_in_range(const vector<pair<id_t, id_t>>& ranges, id_t i
     
 }
 
+IDRangeQueries::IDRangeQueries(const vector<vector<pair<id_t, id_t>>>& queries) : query_count(queries.size()) {
+    // Break the IDs at every range start and past every range end
+    vector<id_t> boundaries;
+    for (auto& query : queries) {
+        for (auto& range : query) {
+            boundaries.push_back(range.first);
+            if (range.second != numeric_limits<id_t>::max()) {
+                boundaries.push_back(range.second + 1);
+            }
+        }
+    }
+    std::sort(boundaries.begin(), boundaries.end());
+    boundaries.erase(std::unique(boundaries.begin(), boundaries.end()), boundaries.end());
+    
+    // Find the queries covering each elementary segment
+    vector<vector<size_t>> covering(boundaries.size());
+    for (size_t i = 0; i < queries.size(); i++) {
+        for (auto& range : queries[i]) {
+            auto it = std::lower_bound(boundaries.begin(), boundaries.end(), range.first);
+            for (; it != boundaries.end() && *it <= range.second; ++it) {
+                auto& here = covering[it - boundaries.begin()];
+                if (here.empty() || here.back() != i) {
+                    here.push_back(i);
+                }
+            }
+        }
+    }
+    
+    // Keep only the covered segments
+    for (size_t i = 0; i < boundaries.size(); i++) {
+        if (covering[i].empty()) {
+            continue;
+        }
+        id_t end = i + 1 < boundaries.size() ? boundaries[i + 1] - 1 : numeric_limits<id_t>::max();
+        segment_starts.push_back(boundaries[i]);
+        segment_ends.push_back(end);
+        segment_queries.emplace_back(std::move(covering[i]));
+        
+        if (!covered.empty() && covered.back().second != numeric_limits<id_t>::max() &&
+            covered.back().second + 1 == boundaries[i]) {
+            covered.back().second = end;
+        } else {
+            covered.emplace_back(boundaries[i], end);
+        }
+    }
+}
+
+auto IDRangeQueries::size() const -> size_t {
+    return query_count;
+}
+
+auto IDRangeQueries::covered_ranges() const -> const vector<pair<id_t, id_t>>& {
+    return covered;
+}
+
+auto IDRangeQueries::match(const vector<id_t>& ids, bool only_fully_contained, vector<size_t>& matches) const -> void {
+    matches.clear();
+    vector<size_t> merged;
+    bool first = true;
+    for (auto& id : ids) {
+        // Find the segment the ID is in, if any
+        auto it = std::upper_bound(segment_starts.begin(), segment_starts.end(), id);
+        const vector<size_t>* here = nullptr;
+        if (it != segment_starts.begin()) {
+            size_t segment = (it - segment_starts.begin()) - 1;
+            if (id <= segment_ends[segment]) {
+                here = &segment_queries[segment];
+            }
+        }
+        
+        if (only_fully_contained) {
+            if (here == nullptr) {
+                // This ID is in no query, so no query contains everything.
+                matches.clear();
+                return;
+            }
+            if (first) {
+                matches = *here;
+            } else {
+                merged.clear();
+                std::set_intersection(matches.begin(), matches.end(), here->begin(), here->end(),
+                                      std::back_inserter(merged));
+                swap(matches, merged);
+            }
+            if (matches.empty()) {
+                return;
+            }
+        } else if (here != nullptr) {
+            merged.clear();
+            std::set_union(matches.begin(), matches.end(), here->begin(), here->end(),
+                           std::back_inserter(merged));
+            swap(matches, merged);
+        }
+        first = false;
+    }
+}
+
 auto StreamIndexBase::save(ostream& to) const -> void {
     // We aren't going to save as Protobuf messages; we're going to save as a bunch of varints.
     
@@ -11,6 +11,8 @@
 #include <set>
 #include <unordered_map>
 #include <type_traits>
+#include <algorithm>
+#include <omp.h>
 
 #include "types.hpp"
 #include <vg/vg.pb.h>
@@ -346,6 +348,40 @@ private:
 
 };
 
+/**
+ * A batch of node ID queries, each a sorted, coalesced list of inclusive
+ * ranges, which can quickly say which queries a message's node IDs match.
+ * Queries may overlap each other.
+ */
+class IDRangeQueries {
+public:
+    /// Make a batch out of the given queries
+    IDRangeQueries(const vector<vector<pair<id_t, id_t>>>& queries);
+    
+    /// Get the number of queries
+    size_t size() const;
+    
+    /// Get the sorted, coalesced ranges covered by any query
+    const vector<pair<id_t, id_t>>& covered_ranges() const;
+    
+    /// Fill matches with the sorted numbers of the queries that match the
+    /// given node IDs: the queries with a range containing any of them, or,
+    /// if only_fully_contained is set, all of them.
+    void match(const vector<id_t>& ids, bool only_fully_contained, vector<size_t>& matches) const;
+    
+private:
+    /// Number of queries
+    size_t query_count;
+    /// Start IDs of the disjoint, sorted, inclusive segments the queries' ranges break the IDs into
+    vector<id_t> segment_starts;
+    /// End IDs of the segments
+    vector<id_t> segment_ends;
+    /// Sorted queries covering each segment
+    vector<vector<size_t>> segment_queries;
+    /// Union of all the ranges
+    vector<pair<id_t, id_t>> covered;
+};
+
 /** An index that provides a higher-level API in terms of the actual messages
  * being indexed. This is the main entry point for users in most cases.
  *
@@ -378,6 +414,18 @@ public:
     void find(cursor_t& cursor, const vector<pair<id_t, id_t>>& ranges, const function<void(const Message&)> handle_result,
         bool only_fully_contained = false) const;
     
+    /// Call the given callback with the query number and message for every
+    /// message matching each of a batch of queries. All the queries are
+    /// planned up front into one sorted list of disjoint virtual offset
+    /// spans, so each group is read at most once, and the spans are scanned
+    /// in parallel, one thread per given cursor. Messages are delivered in
+    /// file order, and the callback is never called concurrently. Each thread
+    /// buffers at most max_buffered messages; the rest of a bigger span is
+    /// streamed to the callback when its turn comes.
+    void find_all(const vector<cursor_t*>& cursors, const IDRangeQueries& queries,
+        const function<void(size_t, const Message&)>& handle_result, bool only_fully_contained = false,
+        size_t max_buffered = 4096) const;
+    
     /// Given a cursor at the beginning of a sorted, readable file, index the file.
     void index(cursor_t& cursor);
     
@@ -870,6 +918,116 @@ auto StreamIndex<Message>::find(cursor_t& cursor, const vector<pair<id_t, id_t>>
     }
 }
 
+template<typename Message>
+auto StreamIndex<Message>::find_all(const vector<cursor_t*>& cursors, const IDRangeQueries& queries,
+    const function<void(size_t, const Message&)>& handle_result, bool only_fully_contained,
+    size_t max_buffered) const -> void {
+    
+    // A span of virtual offsets to scan, and the largest node ID any query
+    // scanning it cares about
+    struct Span {
+        int64_t start_vo;
+        int64_t past_end_vo;
+        id_t max_id;
+    };
+    
+    // Plan all the runs for all the queries. Since we can't scan while
+    // planning, we take every run the index offers, and stop each scan
+    // later, once its messages start past max_id.
+    vector<Span> runs;
+    for (auto& range : queries.covered_ranges()) {
+        find(range.first, range.second, [&](int64_t start_vo, int64_t past_end_vo) -> bool {
+            runs.push_back({start_vo, past_end_vo, range.second});
+            return true;
+        });
+    }
+    std::sort(runs.begin(), runs.end(), [](const Span& a, const Span& b) {
+        return a.start_vo < b.start_vo;
+    });
+    
+    // Merge overlapping runs into disjoint spans
+    vector<Span> spans;
+    for (auto& run : runs) {
+        if (!spans.empty() && run.start_vo < spans.back().past_end_vo) {
+            spans.back().past_end_vo = max(spans.back().past_end_vo, run.past_end_vo);
+            spans.back().max_id = max(spans.back().max_id, run.max_id);
+        } else {
+            spans.push_back(run);
+        }
+    }
+    
+#ifdef debug
+    cerr << "Planned " << spans.size() << " spans from " << runs.size() << " runs for "
+        << queries.size() << " queries" << endl;
+#endif
+    
+    // Most spans are small, so we scan them in parallel and hand over what
+    // they found in order. Once a span has found max_buffered messages, its
+    // thread waits for its turn and streams the rest of the span straight to
+    // the callback, so a big span is never held in memory all at once.
+#pragma omp parallel for ordered schedule(dynamic, 1) num_threads(cursors.size())
+    for (size_t i = 0; i < spans.size(); i++) {
+        const Span& span = spans[i];
+        cursor_t& cursor = *cursors[omp_get_thread_num()];
+        
+        // Messages found in the span, and the queries they match
+        vector<pair<vector<size_t>, Message>> found;
+        vector<id_t> ids;
+        vector<size_t> matches;
+        
+        // Move the cursor to the next message in the span that matches a
+        // query, and fill in the queries it matches, or return false if there
+        // are no more.
+        auto next_match = [&]() -> bool {
+            while (cursor.has_current() && cursor.tell_group() < span.past_end_vo) {
+                ids.clear();
+                id_t min_id = numeric_limits<id_t>::max();
+                for_each_id(*cursor, [&](const id_t& id) {
+                    min_id = min(min_id, id);
+                    ids.push_back(id);
+                    return true;
+                });
+                
+                if (min_id != numeric_limits<id_t>::max() && min_id > span.max_id) {
+                    // Messages are sorted by min ID, so nothing from here on can
+                    // match, and we can stop without reading the rest of the group.
+                    return false;
+                }
+                
+                queries.match(ids, only_fully_contained, matches);
+                if (!matches.empty()) {
+                    return true;
+                }
+                cursor.advance();
+            }
+            return false;
+        };
+        
+        cursor.seek_group(span.start_vo);
+        bool more = true;
+        while (found.size() < max_buffered && (more = next_match())) {
+            found.emplace_back(matches, cursor.take());
+        }
+        
+#pragma omp ordered
+        {
+            for (auto& match : found) {
+                for (auto& query : match.first) {
+                    handle_result(query, match.second);
+                }
+            }
+            found.clear();
+            
+            while (more && next_match()) {
+                Message message = cursor.take();
+                for (auto& query : matches) {
+                    handle_result(query, message);
+                }
+            }
+        }
+    }
+}
+
 template<typename Message>
 auto StreamIndex<Message>::index(cursor_t& cursor) -> void {
     // Keep track of what group we are in 
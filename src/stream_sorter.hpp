@@ -446,7 +446,7 @@ vector<string> StreamSorter<Message>::streaming_merge(const vector<string>& temp
         // Open up cursors into all the files.
         list<ifstream> temp_ifstreams;
         list<cursor_t> temp_cursors;
-        open_all(vector<string>(&temp_files_out[start_file], &temp_files_out[start_file + file_count]), temp_ifstreams, temp_cursors);
+        open_all(vector<string>(temp_files_in.begin() + start_file, temp_files_in.begin() + start_file + file_count), temp_ifstreams, temp_cursors);
         
         // Work out how many messages to expect
         size_t expected_messages = 0;
@@ -472,7 +472,7 @@ vector<string> StreamSorter<Message>::streaming_merge(const vector<string>& temp
         // Clean up the input files we used
         temp_cursors.clear();
         temp_ifstreams.clear();
-        for (size_t i = start_file; i < file_count; i++) {
+        for (size_t i = start_file; i < start_file + file_count; i++) {
             temp_file::remove(temp_files_in.at(i));
         }
         
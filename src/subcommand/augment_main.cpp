@@ -58,10 +58,13 @@ void help_augment(char** argv, ConfigurableParser& parser) {
          << "    -Q, --min-mapq N            ignore alignments with mapping quality < N" << endl
          << "    -N, --max-n F               maximum fraction of N bases in an edit for it to be included [default : 0.25]" << endl
          << "    -E, --edges-only            only edges implied by reads, ignoring edits" << endl
+         << "    -b, --batch-size N          filter the edits of N alignments at a time in parallel [default : 1024]" << endl
+         << "    -M, --max-memory N          keep breakpoints and added nodes to about N MB by spilling breakpoints to disk" << endl
+         << "                                and editing one node ID range at a time (reads the alignments once per range)" << endl
          << "    -h, --help                  print this help message" << endl
          << "    -p, --progress              show progress" << endl
          << "    -v, --verbose               print information and warnings about vcf generation" << endl
-         << "    -t, --threads N             number of threads (only 1st pass with -m or -q option is multithreaded)" << endl
+         << "    -t, --threads N             number of threads (used to find breakpoints with -m or -q, and to filter edits)" << endl
          << "loci file options:" << endl
          << "    -l, --include-loci FILE     merge all alleles in loci into the graph" << endl       
          << "    -L, --include-gt FILE       merge only the alleles in called genotypes into the graph" << endl;
@@ -121,6 +124,12 @@ int main_augment(int argc, char** argv) {
     // practice, it seems they already are.  Todo: remove?
     double edges_only = false;
 
+    // How many alignments to filter in parallel at once when editing the graph
+    size_t batch_size = 1024;
+
+    // If nonzero, bound the memory used to edit the graph to about this many bytes
+    size_t max_edit_memory = 0;
+
     // GAF format toggle
     string aln_format = "GAM";
 
@@ -147,6 +156,8 @@ int main_augment(int argc, char** argv) {
         {"min-mapq", required_argument, 0, 'Q'},
         {"max-n", required_argument, 0, 'N'},
         {"edges-only", no_argument, 0, 'E'},
+        {"batch-size", required_argument, 0, 'b'},
+        {"max-memory", required_argument, 0, 'M'},
         {"gaf", no_argument, 0, 'F'},
         {"help", no_argument, 0, 'h'},
         {"progress", required_argument, 0, 'p'},
@@ -157,7 +168,7 @@ int main_augment(int argc, char** argv) {
         {"include-gt", required_argument, 0, 'L'},
         {0, 0, 0, 0}
     };
-    static const char* short_options = "a:Z:A:iCSBhpvt:l:L:sm:c:q:Q:N:EF";
+    static const char* short_options = "a:Z:A:iCSBhpvt:l:L:sm:c:q:Q:N:EFb:M:";
     optind = 2; // force optind past command positional arguments
 
     // This is our command-line parser
@@ -209,6 +220,20 @@ int main_augment(int argc, char** argv) {
         case 'E':
             edges_only = true;
             break;
+        case 'b':
+            batch_size = parse<size_t>(optarg);
+            if (batch_size == 0) {
+                cerr << "[vg augment] error: batch size (-b) must be positive" << endl;
+                exit(1);
+            }
+            break;
+        case 'M':
+            max_edit_memory = parse<double>(optarg) * 1024 * 1024;
+            if (max_edit_memory == 0) {
+                cerr << "[vg augment] error: memory limit (-M) must be positive" << endl;
+                exit(1);
+            }
+            break;
         case 'F':
             aln_format = "GAF";
             break;
@@ -325,8 +350,8 @@ int main_augment(int argc, char** argv) {
     }
     else {
         // the packer's required for any kind of filtering logic -- so we use it when
-        // baseq is present as well, or n-fraction.
-        if (min_coverage > 0 || min_baseq || max_frac_n < 1.) {
+        // baseq is present as well, or n-fraction, or memory is bounded.
+        if (min_coverage > 0 || min_baseq || max_frac_n < 1. || max_edit_memory > 0) {
             vectorizable_graph = dynamic_cast<HandleGraph*>(overlay_helper.apply(graph.get()));
             size_t data_width = Packer::estimate_data_width(expected_coverage);
             size_t bin_count = Packer::estimate_bin_count(get_thread_count());
@@ -403,7 +428,9 @@ int main_augment(int argc, char** argv) {
                     packer.get(),
                     min_coverage,
                     max_frac_n,
-                    edges_only);
+                    edges_only,
+                    batch_size,
+                    max_edit_memory);
         } else {
             // much better to stream from a file so we can do two passes without storing in memory
             augment(graph.get(),
@@ -420,7 +447,9 @@ int main_augment(int argc, char** argv) {
                     packer.get(),
                     min_coverage,
                     max_frac_n,
-                    edges_only);
+                    edges_only,
+                    batch_size,
+                    max_edit_memory);
         }
 
         // we don't have a streaming interface for translation:  write the buffer now
@@ -25,11 +25,16 @@
 #include <bdsg/overlays/overlay_helper.hpp>
 #include "../io/save_handle_graph.hpp"
 
+#include <htslib/hts.h>
+#include <htslib/kstring.h>
+
 using namespace std;
 using namespace vg;
 using namespace vg::subcommand;
 
 static string chunk_name(const string& out_chunk_prefix, int i, const Region& region, string ext, int gi = 0, bool components = false);
+static void chunk_gaf_file(const string& gaf_file, const IDRangeQueries& queries, vector<unique_ptr<ofstream>>& outs,
+                           bool fully_contained);
 static int split_gam(istream& gam_stream, size_t chunk_size, const string& out_prefix,
                      size_t gam_buffer_size = 100);
 
@@ -46,7 +51,8 @@ void help_chunk(char** argv) {
          << "    -x, --xg-name FILE       use this graph or xg index to chunk subgraphs" << endl
          << "    -G, --gbwt-name FILE     use this GBWT haplotype index for haplotype extraction (for -T)" << endl
          << "    -a, --gam-name FILE      chunk this gam file instead of the graph (multiple allowed)" << endl
-         << "    -g, --gam-and-graph      when used in combination with -a, both gam and graph will be chunked" << endl 
+         << "    -F, --gaf-name FILE      chunk this gaf file instead of the graph (multiple allowed, no index needed)" << endl
+         << "    -g, --gam-and-graph      when used in combination with -a or -F, both alignments and graph will be chunked" << endl 
          << "path chunking:" << endl
          << "    -p, --path TARGET        write the chunk in the specified (0-based inclusive, multiple allowed)\n"
          << "                             path range TARGET=path[:pos1[-pos2]] to standard output" << endl
@@ -73,7 +79,7 @@ void help_chunk(char** argv) {
          << "    -l, --context-length N   expand the context of the chunk by this many bp [0]" << endl
          << "    -T, --trace              trace haplotype threads in chunks (and only expand forward from input coordinates)." << endl
          << "                             Produces a .annotate.txt file with haplotype frequencies for each chunk." << endl 
-         << "    -f, --fully-contained    only return GAM alignments that are fully contained within chunk" << endl
+         << "    -f, --fully-contained    only return GAM/GAF alignments that are fully contained within chunk" << endl
          << "    -O, --output-fmt         Specify output format (vg, pg, hg, gfa).  [vg]" << endl
          << "    -t, --threads N          for tasks that can be done in parallel, use this many threads [1]" << endl
          << "    -h, --help" << endl;
@@ -89,6 +95,7 @@ int main_chunk(int argc, char** argv) {
     string xg_file;
     string gbwt_file;
     vector<string> gam_files;
+    vector<string> gaf_files;
     bool gam_and_graph = false;
     vector<string> region_strings;
     string path_list_file;
@@ -120,6 +127,7 @@ int main_chunk(int argc, char** argv) {
             {"xg-name", required_argument, 0, 'x'},
             {"gbwt-name", required_argument, 0, 'G'},
             {"gam-name", required_argument, 0, 'a'},
+            {"gaf-name", required_argument, 0, 'F'},
             {"gam-and-graph", no_argument, 0, 'g'},
             {"path", required_argument, 0, 'p'},
             {"path-names", required_argument, 0, 'P'},
@@ -145,7 +153,7 @@ int main_chunk(int argc, char** argv) {
         };
 
         int option_index = 0;
-        c = getopt_long (argc, argv, "hx:G:a:gp:P:s:o:e:S:E:b:c:r:R:Tft:n:l:m:CMO:",
+        c = getopt_long (argc, argv, "hx:G:a:F:gp:P:s:o:e:S:E:b:c:r:R:Tft:n:l:m:CMO:",
                 long_options, &option_index);
 
 
@@ -167,6 +175,10 @@ int main_chunk(int argc, char** argv) {
         case 'a':
             gam_files.push_back(optarg);
             break;
+
+        case 'F':
+            gaf_files.push_back(optarg);
+            break;
             
         case 'g':
             gam_and_graph = true;
@@ -283,8 +295,16 @@ int main_chunk(int argc, char** argv) {
         return 1;
     }
     // need -a if using -f
-    if ((gam_split_size != 0 || fully_contained) && gam_files.empty()) {
-        cerr << "error:[vg chunk] gam file must be specified with -a when using -f or -m" << endl;
+    if (gam_split_size != 0 && gam_files.empty()) {
+        cerr << "error:[vg chunk] gam file must be specified with -a when using -m" << endl;
+        return 1;
+    }
+    if (fully_contained && gam_files.empty() && gaf_files.empty()) {
+        cerr << "error:[vg chunk] gam or gaf file must be specified with -a or -F when using -f" << endl;
+        return 1;
+    }
+    if (!gaf_files.empty() && (!gam_files.empty() || components)) {
+        cerr << "error:[vg chunk] gaf files (-F) cannot be chunked with gam files (-a) or by components (-C, -M)" << endl;
         return 1;
     }
     if (components == true && context_steps >= 0) {
@@ -313,7 +333,8 @@ int main_chunk(int argc, char** argv) {
     // because we use the graph to get the nodes we're looking for.
     // but we only write the subgraphs to disk if chunk_graph is true. 
     bool chunk_gam = !gam_files.empty() && gam_split_size == 0;
-    bool chunk_graph = gam_and_graph || (!chunk_gam && gam_split_size == 0);
+    bool chunk_gaf = !gaf_files.empty();
+    bool chunk_graph = gam_and_graph || (!chunk_gam && !chunk_gaf && gam_split_size == 0);
 
     // Load the snarls
     unique_ptr<SnarlManager> snarl_manager;
@@ -624,6 +645,10 @@ int main_chunk(int argc, char** argv) {
         }
     }
 
+    // the node ID ranges to look up alignments in for each chunk, which we
+    // do for all the chunks together once they are all extracted
+    vector<vector<pair<vg::id_t, vg::id_t>>> chunk_id_ranges((chunk_gam || chunk_gaf) && !components ? num_regions : 0);
+
     // extract chunks in parallel
 #pragma omp parallel for
     for (int i = 0; i < num_regions; ++i) {
@@ -734,33 +759,16 @@ int main_chunk(int argc, char** argv) {
             vg::io::save_handle_graph(subgraph.get(), *out_stream);
         }
         
-        // optional gam chunking
-        if (chunk_gam) {
+        // optional alignment chunking
+        if (chunk_gam || chunk_gaf) {
             if (!components) {
-                // old way: use the gam index
-                for (size_t gi = 0; gi < gam_indexes.size(); ++gi) {
-                    auto& gam_index = gam_indexes[gi];
-                    assert(gam_index.get() != nullptr);
-                    GAMIndex::cursor_t& cursor = cursors_vec[gi][tid];
-            
-                    string gam_name = chunk_name(out_chunk_prefix, i, output_regions[i], ".gam", gi, components);
-                    ofstream out_gam_file(gam_name);
-                    if (!out_gam_file) {
-                        cerr << "error[vg chunk]: can't open output gam file " << gam_name << endl;
-                        exit(1);
-                    }
-            
-                    // Work out the ID ranges to look up
-                    vector<pair<vg::id_t, vg::id_t>> region_id_ranges;
-                    if (subgraph) {
-                        // Use the regions from the graph
-                        region_id_ranges = vg::algorithms::sorted_id_ranges(subgraph.get());
-                    } else {
-                        // Use the region we were asked for
-                        region_id_ranges = {{region.start, region.end}};
-                    }
-            
-                    gam_index->find(cursor, region_id_ranges, vg::io::emit_to<Alignment>(out_gam_file), fully_contained);
+                // Work out the ID ranges to look up
+                if (subgraph) {
+                    // Use the regions from the graph
+                    chunk_id_ranges[i] = vg::algorithms::sorted_id_ranges(subgraph.get());
+                } else {
+                    // Use the region we were asked for
+                    chunk_id_ranges[i] = {{region.start, region.end}};
                 }
             } else {
 #pragma omp critical (node_to_component)
@@ -790,6 +798,57 @@ int main_chunk(int argc, char** argv) {
         }
     }
         
+    // Look up the alignments for all the chunks together, so that each part
+    // of the input is read only once, in parallel for indexed GAMs. We do
+    // batches of chunks, to keep from opening too many files at once.
+    if ((chunk_gam || chunk_gaf) && !components) {
+        static const size_t max_open_chunks = 256;
+        for (size_t batch_start = 0; batch_start < (size_t)num_regions; batch_start += max_open_chunks) {
+            size_t batch_end = min((size_t)num_regions, batch_start + max_open_chunks);
+            IDRangeQueries queries(vector<vector<pair<vg::id_t, vg::id_t>>>(chunk_id_ranges.begin() + batch_start,
+                                                                             chunk_id_ranges.begin() + batch_end));
+            
+            for (size_t gi = 0; gi < gam_indexes.size(); ++gi) {
+                // Open an output for each chunk in the batch
+                vector<unique_ptr<ofstream>> out_gam_files;
+                vector<unique_ptr<vg::io::ProtobufEmitter<Alignment>>> emitters;
+                for (size_t i = batch_start; i < batch_end; ++i) {
+                    string gam_name = chunk_name(out_chunk_prefix, i, output_regions[i], ".gam", gi, components);
+                    out_gam_files.emplace_back(new ofstream(gam_name));
+                    if (!*out_gam_files.back()) {
+                        cerr << "error[vg chunk]: can't open output gam file " << gam_name << endl;
+                        exit(1);
+                    }
+                    emitters.emplace_back(new vg::io::ProtobufEmitter<Alignment>(*out_gam_files.back()));
+                }
+                
+                vector<GAMIndex::cursor_t*> cursors;
+                for (auto& cursor : cursors_vec[gi]) {
+                    cursors.push_back(&cursor);
+                }
+                gam_indexes[gi]->find_all(cursors, queries, [&](size_t query, const Alignment& aln) {
+                    emitters[query]->write_copy(aln);
+                }, fully_contained);
+                
+                // finish the files before closing them
+                emitters.clear();
+            }
+            
+            for (size_t gi = 0; gi < gaf_files.size(); ++gi) {
+                vector<unique_ptr<ofstream>> out_gaf_files;
+                for (size_t i = batch_start; i < batch_end; ++i) {
+                    string gaf_name = chunk_name(out_chunk_prefix, i, output_regions[i], ".gaf", gi, components);
+                    out_gaf_files.emplace_back(new ofstream(gaf_name));
+                    if (!*out_gaf_files.back()) {
+                        cerr << "error[vg chunk]: can't open output gaf file " << gaf_name << endl;
+                        exit(1);
+                    }
+                }
+                chunk_gaf_file(gaf_files[gi], queries, out_gaf_files, fully_contained);
+            }
+        }
+    }
+        
     // write a bed file if asked giving a more explicit linking of chunks to files
     if (!out_bed_file.empty()) {
         ofstream obed(out_bed_file);
@@ -800,7 +859,7 @@ int main_chunk(int argc, char** argv) {
             const Region& oregion = output_regions[i];
             string seq = id_range ? "ids" : oregion.seq;
             obed << seq << "\t" << oregion.start << "\t" << (oregion.end + 1)
-                 << "\t" << chunk_name(out_chunk_prefix, i, oregion, chunk_gam ? ".gam" : "." + output_format, 0, components);
+                 << "\t" << chunk_name(out_chunk_prefix, i, oregion, chunk_gam ? ".gam" : (chunk_gaf ? ".gaf" : "." + output_format), 0, components);
             if (trace) {
                 obed << "\t" << chunk_name(out_chunk_prefix, i, oregion, ".annotate.txt", 0, components);
             }
@@ -898,6 +957,79 @@ string chunk_name(const string& out_chunk_prefix, int i, const Region& region, s
     return chunk_name.str();
 }
 
+// Get the node IDs a GAF line visits, or 0 if it isn't placed by node ID
+static void gaf_node_ids(const char* line, size_t length, vector<vg::id_t>& ids) {
+    ids.clear();
+    // skip to the path column
+    size_t i = 0;
+    for (size_t column = 0; column < 5 && i < length; ++i) {
+        if (line[i] == '\t') {
+            ++column;
+        }
+    }
+    while (i < length && (line[i] == '>' || line[i] == '<')) {
+        ++i;
+        vg::id_t id = 0;
+        for (; i < length && line[i] >= '0' && line[i] <= '9'; ++i) {
+            id = id * 10 + (line[i] - '0');
+        }
+        ids.push_back(id);
+    }
+    if (ids.empty()) {
+        // unmapped, or on a named path we can't place without the graph
+        ids.push_back(0);
+    }
+}
+
+// Send each GAF line to the outputs of the queries it matches, in one pass over the file
+void chunk_gaf_file(const string& gaf_file, const IDRangeQueries& queries, vector<unique_ptr<ofstream>>& outs,
+                    bool fully_contained) {
+    htsFile* in = hts_open(gaf_file.c_str(), "r");
+    if (in == nullptr) {
+        cerr << "error[vg chunk]: unable to open input gaf: " << gaf_file << endl;
+        exit(1);
+    }
+    
+    // read batches of lines on this thread, and match them in parallel
+    static const size_t batch_size = 10000;
+    vector<string> lines;
+    vector<vector<size_t>> matches;
+    kstring_t line = {0, 0, nullptr};
+    bool more = true;
+    while (more) {
+        lines.clear();
+        while (lines.size() < batch_size && more) {
+            int status = hts_getline(in, KS_SEP_LINE, &line);
+            if (status < -1) {
+                // Only -1 is the end of the file
+                cerr << "error[vg chunk]: unable to read input gaf: " << gaf_file << endl;
+                exit(1);
+            }
+            more = status >= 0;
+            if (more) {
+                lines.emplace_back(line.s, line.l);
+            }
+        }
+        matches.resize(lines.size());
+#pragma omp parallel
+        {
+            vector<vg::id_t> ids;
+#pragma omp for
+            for (size_t i = 0; i < lines.size(); ++i) {
+                gaf_node_ids(lines[i].c_str(), lines[i].size(), ids);
+                queries.match(ids, fully_contained, matches[i]);
+            }
+        }
+        for (size_t i = 0; i < lines.size(); ++i) {
+            for (auto& query : matches[i]) {
+                *outs[query] << lines[i] << "\n";
+            }
+        }
+    }
+    free(line.s);
+    hts_close(in);
+}
+
 // Split out every chunk_size reads into a different file
 int split_gam(istream& gam_stream, size_t chunk_size, const string& out_prefix, size_t gam_buffer_size) {
     ofstream out_file;
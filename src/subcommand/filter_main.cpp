@@ -29,6 +29,7 @@ void help_filter(char** argv) {
          << endl
          << "options:" << endl
          << "    -M, --input-mp-alns        input is multipath alignments (GAMP) rather than GAM" << endl
+         << "    -G, --gaf-input            input is GAF rather than GAM, and write GAF (requires -x)" << endl
          << "    -n, --name-prefix NAME     keep only reads with this prefix in their names [default='']" << endl
          << "    -N, --name-prefixes FILE   keep reads with names with one of many prefixes, one per nonempty line" << endl
          << "    -a, --subsequence NAME     keep reads that contain this subsequence" << endl
@@ -67,6 +68,7 @@ int main_filter(int argc, char** argv) {
     }
     
     bool input_gam = true;
+    bool input_gaf = false;
     vector<string> name_prefixes;
     vector<regex> excluded_refpos_contigs;
     unordered_set<string> excluded_features;
@@ -113,6 +115,7 @@ int main_filter(int argc, char** argv) {
         static struct option long_options[] =
             {
                 {"input-mp-alns", no_argument, 0, 'M'},
+                {"gaf-input", no_argument, 0, 'G'},
                 {"name-prefix", required_argument, 0, 'n'},
                 {"name-prefixes", required_argument, 0, 'N'},
                 {"subsequence", required_argument, 0, 'a'},
@@ -144,7 +147,7 @@ int main_filter(int argc, char** argv) {
             };
 
         int option_index = 0;
-        c = getopt_long (argc, argv, "Mn:N:a:A:pX:F:s:r:Od:e:fauo:m:Sx:vVq:E:D:C:d:iIb:Ut:",
+        c = getopt_long (argc, argv, "MGn:N:a:A:pX:F:s:r:Od:e:fauo:m:Sx:vVq:E:D:C:d:iIb:Ut:",
                          long_options, &option_index);
 
         /* Detect the end of the options. */
@@ -156,6 +159,9 @@ int main_filter(int argc, char** argv) {
         case 'M':
             input_gam = false;
             break;
+        case 'G':
+            input_gaf = true;
+            break;
         case 'n':
             name_prefixes.push_back(optarg);
             break;
@@ -326,6 +332,15 @@ int main_filter(int argc, char** argv) {
         return 1;
     }
 
+    if (input_gaf && !input_gam) {
+        cerr << "error[vg filter]: GAF input (-G) cannot be multipath alignments (-M)" << endl;
+        return 1;
+    }
+    if (input_gaf && xg_name.empty()) {
+        cerr << "error[vg filter]: GAF input (-G) requires a graph (-x)" << endl;
+        return 1;
+    }
+
     // What should our return code be?
     int error_code = 0;
     
@@ -401,6 +416,13 @@ int main_filter(int argc, char** argv) {
         filter.graph = xindex;
     };
     
+    if (input_gaf) {
+        // The GAF reader opens the file itself.
+        ReadFilter<Alignment> filter;
+        set_params(filter);
+        return filter.filter_gaf(get_input_file_name(optind, argc, argv));
+    }
+    
     // Read in the alignments and filter them.
     get_input_file(optind, argc, argv, [&](istream& in) {
         // Open up the alignment stream
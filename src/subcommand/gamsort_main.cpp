@@ -1,4 +1,5 @@
 #include "../stream_sorter.hpp"
+#include "../gaf_sorter.hpp"
 #include <vg/io/stream.hpp>
 #include "../stream_index.hpp"
 #include <getopt.h>
@@ -13,11 +14,12 @@ using namespace vg;
 using namespace vg::subcommand;
 void help_gamsort(char **argv)
 {
-    cerr << "gamsort: sort a GAM file, or index a sorted GAM file" << endl
+    cerr << "gamsort: sort a GAM or GAF file, or index a sorted GAM file" << endl
          << "Usage: " << argv[1] << " [Options] gamfile" << endl
          << "Options:" << endl
          << "  -i / --index FILE       produce an index of the sorted GAM file" << endl
          << "  -d / --dumb-sort        use naive sorting algorithm (no tmp files, faster for small GAMs)" << endl
+         << "  -G / --gaf-input        input is GAF (may be gzipped); write sorted GAF" << endl
          << "  -p / --progress         Show progress." << endl
          << "  -t / --threads          Use the specified number of threads." << endl
          << endl;
@@ -28,6 +30,7 @@ int main_gamsort(int argc, char **argv)
     string index_filename;
     bool easy_sort = false;
     bool show_progress = false;
+    bool gaf_input = false;
     // We limit the max threads, and only allow thread count to be lowered, to
     // prevent tcmalloc from giving each thread a very large heap for many
     // threads.
@@ -41,12 +44,13 @@ int main_gamsort(int argc, char **argv)
             {
                 {"index", required_argument, 0, 'i'},
                 {"dumb-sort", no_argument, 0, 'd'},
+                {"gaf-input", no_argument, 0, 'G'},
                 {"rocks", required_argument, 0, 'r'},
                 {"progress", no_argument, 0, 'p'},
                 {"threads", required_argument, 0, 't'},
                 {0, 0, 0, 0}};
         int option_index = 0;
-        c = getopt_long(argc, argv, "i:dhpt:",
+        c = getopt_long(argc, argv, "i:dGhpt:",
                         long_options, &option_index);
 
         // Detect the end of the options.
@@ -61,6 +65,9 @@ int main_gamsort(int argc, char **argv)
         case 'd':
             easy_sort = true;
             break;
+        case 'G':
+            gaf_input = true;
+            break;
         case 'p':
             show_progress = true;
             break;
@@ -83,6 +90,23 @@ int main_gamsort(int argc, char **argv)
     
     omp_set_num_threads(num_threads);
 
+    if (gaf_input) {
+        if (!index_filename.empty()) {
+            cerr << "error:[vg gamsort] indexing is only supported for GAM" << endl;
+            exit(1);
+        }
+
+        // GAF is read by name, so htslib can deal with compression.
+        string gaf_filename = get_input_file_name(optind, argc, argv);
+        GAFSorter sorter(show_progress);
+        if (easy_sort) {
+            sorter.easy_sort(gaf_filename, cout);
+        } else {
+            sorter.stream_sort(gaf_filename, cout);
+        }
+        return 0;
+    }
+
     get_input_file(optind, argc, argv, [&](istream& gam_in) {
 
         GAMSorter gs(show_progress);
@@ -25,6 +25,8 @@
 #include "../hts_alignment_emitter.hpp"
 #include "../minimizer_mapper.hpp"
 #include "../index_registry.hpp"
+#include "../safari_server.hpp"
+#include "../numa_placement.hpp"
 #include <bdsg/overlays/overlay_helper.hpp>
 
 #include <gbwtgraph/gbz.h>
@@ -336,6 +338,12 @@ void help_safari(char** argv) {
     << "  --ref-paths FILE              ordered list of paths in the graph, one per line or HTSlib .dict, for HTSLib @SQ headers" << endl
     << "  --named-coordinates           produce GAM outputs in named-segment (GFA) space" << endl
     << "  -P, --prune-low-cplx          prune short and low complexity anchors during linear format realignment" << endl
+    << "  --sort                        coordinate-sort SAM / BAM / CRAM output" << endl
+    << "  --sort-memory INT             hold up to INT MB of records in memory while sorting [768]" << endl
+    << "  --sort-index FILE             also write an index of sorted BAM output to FILE (BAI if named .bai, else CSI)" << endl
+    << "  --mark-duplicates             flag duplicate reads by both fragment ends in sorted output (requires --sort)" << endl
+    << "  --remove-duplicates           drop duplicate reads from sorted output instead of flagging them (requires --sort)" << endl
+    << "  --duplicate-stats FILE        write duplication statistics to FILE" << endl
     << "  -n, --discard                 discard all output alignments (for profiling)" << endl
     << "  --output-basename NAME        write output to a GAM file beginning with the given prefix for each setting combination" << endl
     << "  --report-name NAME            write a TSV of output file and mapping speed to the given file" << endl
@@ -367,11 +375,20 @@ void help_safari(char** argv) {
     << "  --paired-distance-limit FLOAT cluster pairs of read using a distance limit FLOAT standard deviations greater than the mean [2.0]" << endl
     << "  --rescue-subgraph-size FLOAT  search for rescued alignments FLOAT standard deviations greater than the mean [4.0]" << endl
     << "  --rescue-seed-limit INT       attempt rescue with at most INT seeds [100]" << endl
+    << "  --gbwt-cache-records INT      clear each thread's GBWT record cache once it holds more than INT records [32768]" << endl
+    << "  --max-dozeu-cells INT         skip rescue and tail alignments needing more than INT DP cells; each thread may" << endl
+    << "                                hold 2 bytes per cell while one runs [16777216]" << endl
     << "  --track-provenance            track how internal intermediate alignment candidates were arrived at" << endl
     << "  --track-correctness           track if internal intermediate alignment candidates are correct (implies --track-provenance)" << endl
     << "  -j, --posterior-threshold FLOAT             cutoff for posterior on correct alignment when using RYmers" << endl
     << "  -V, --spurious-prior FLOAT             Prior on spurious alignment when using RYmers" << endl
-    << "  -t, --threads INT             number of mapping threads to use" << endl;
+    << "  -t, --threads INT             number of mapping threads to use" << endl
+    << "  --numa                        spread the indexes over all NUMA nodes and pin mapping threads to CPUs" << endl
+    << "                                (only memory the main thread allocates while loading is spread;" << endl
+    << "                                the main thread itself is not pinned)" << endl
+    << "server options:" << endl
+    << "  --serve SOCKET                load indexes once, then map jobs sent with 'vg safari-submit' to UNIX socket SOCKET" << endl
+    << "                                (jobs use -P and --named-coordinates; --sort and --discard are not allowed)" << endl;
 }
 
 int main_safari(int argc, char** argv) {
@@ -398,6 +415,16 @@ int main_safari(int argc, char** argv) {
     #define OPT_EXCLUDE_OVERLAPPING_MIN 1013
     #define OPT_ALIGN_FROM_CHAINS 1014
     #define OPT_NUM_BP_PER_MIN 1015
+    #define OPT_SORT 1016
+    #define OPT_SORT_MEMORY 1017
+    #define OPT_SORT_INDEX 1018
+    #define OPT_MARK_DUPLICATES 1019
+    #define OPT_REMOVE_DUPLICATES 1020
+    #define OPT_DUPLICATE_STATS 1021
+    #define OPT_SERVE 1022
+    #define OPT_NUMA 1023
+    #define OPT_GBWT_CACHE_RECORDS 1024
+    #define OPT_MAX_DOZEU_CELLS 1025
 
     // initialize parameters with their default options
     
@@ -405,6 +432,10 @@ int main_safari(int argc, char** argv) {
     IndexRegistry registry = VGIndexes::get_vg_index_registry();
     string output_basename;
     string report_name;
+    // If set, load the indexes and then serve mapping jobs on this socket.
+    string serve_socket;
+    // Should we place indexes and threads for a multi-socket machine?
+    bool numa = false;
     // How close should two hits be to be in the same cluster?
     Range<size_t> distance_limit = 200;
     Range<size_t> hit_cap = 10, hard_hit_cap = 50000;
@@ -465,6 +496,10 @@ int main_safari(int argc, char** argv) {
     double rescue_stdev = 4.0;
     // Attempt rescue with up to this many seeds.
     size_t rescue_seed_limit = 100;
+    // Keep up to this many decompressed GBWT records per thread between reads.
+    size_t gbwt_cache_records = 32768;
+    // Don't try rescue or tail alignments bigger than this many cells with Dozeu.
+    size_t max_dozeu_cells = 16 * 1024 * 1024;
     // How many pairs should we be willing to buffer before giving up on fragment length estimation?
     size_t MAX_BUFFERED_PAIRS = 100000;
     // What sample name if any should we apply?
@@ -480,20 +515,25 @@ int main_safari(int argc, char** argv) {
     // Should we log our mapping decision making?
     bool show_work = false;
     // For RYmers, at what posterior threshold do we place our filter?
-    double posterior_threshold = 0.5;
+    Range<double> posterior_threshold = 0.5;
     // What's the prior on spurious alignments when using RYmers?
-    double spurious_alignment_prior = 0.5;
+    Range<double> spurious_alignment_prior = 0.5;
     // Deamination matrices
     string deam3pfreqE = "";
     string deam5pfreqE = "";
 
     // Chain all the ranges and get a function that loops over all combinations.
-    auto for_each_combo = distance_limit
+    // The last range changes fastest, so the ranges go in the order of the
+    // mapping stages they affect, and combinations that share their early
+    // stages come one after another and can reuse them.
+    auto for_each_combo = hard_hit_cap
+        .chain(spurious_alignment_prior)
+        .chain(posterior_threshold)
         .chain(hit_cap)
-        .chain(hard_hit_cap)
         .chain(minimizer_score_fraction)
-        .chain(rescue_attempts)
         .chain(max_unique_min)
+        .chain(distance_limit)
+        .chain(rescue_attempts)
         .chain(max_multimaps)
         .chain(max_extensions)
         .chain(max_alignments)
@@ -516,6 +556,10 @@ int main_safari(int argc, char** argv) {
     
     // For GAM format, should we report in named-segment space instead of node ID space?
     bool named_coordinates = false;
+    
+    // For HTSlib formats, should we sort, and how?
+    bool sort_output = false;
+    HTSOutputOptions hts_options;
 
     // Map algorithm names to rescue algorithms
     std::map<std::string, MinimizerMapper::RescueAlgorithm> rescue_algorithms = {
@@ -554,6 +598,12 @@ int main_safari(int argc, char** argv) {
             {"ref-paths", required_argument, 0, OPT_REF_PATHS},
             {"prune-low-cplx", no_argument, 0, 'P'},
             {"named-coordinates", no_argument, 0, OPT_NAMED_COORDINATES},
+            {"sort", no_argument, 0, OPT_SORT},
+            {"sort-memory", required_argument, 0, OPT_SORT_MEMORY},
+            {"sort-index", required_argument, 0, OPT_SORT_INDEX},
+            {"mark-duplicates", no_argument, 0, OPT_MARK_DUPLICATES},
+            {"remove-duplicates", no_argument, 0, OPT_REMOVE_DUPLICATES},
+            {"duplicate-stats", required_argument, 0, OPT_DUPLICATE_STATS},
             {"discard", no_argument, 0, 'n'},
             {"output-basename", required_argument, 0, OPT_OUTPUT_BASENAME},
             {"report-name", required_argument, 0, OPT_REPORT_NAME},
@@ -579,6 +629,8 @@ int main_safari(int argc, char** argv) {
             {"paired-distance-limit", required_argument, 0, OPT_CLUSTER_STDEV },
             {"rescue-subgraph-size", required_argument, 0, OPT_RESCUE_STDEV },
             {"rescue-seed-limit", required_argument, 0, OPT_RESCUE_SEED_LIMIT},
+            {"gbwt-cache-records", required_argument, 0, OPT_GBWT_CACHE_RECORDS},
+            {"max-dozeu-cells", required_argument, 0, OPT_MAX_DOZEU_CELLS},
             {"max-fragment-length", required_argument, 0, 'L' },
             {"fragment-mean", required_argument, 0, OPT_FRAGMENT_MEAN },
             {"fragment-stdev", required_argument, 0, OPT_FRAGMENT_STDEV },
@@ -590,6 +642,8 @@ int main_safari(int argc, char** argv) {
             {"spurious-alignment-prior", required_argument, 0, 'V'},
             {"deam-3p", required_argument, 0, 'Y'},
             {"deam-5p", required_argument, 0, 'y'},
+            {"serve", required_argument, 0, OPT_SERVE},
+            {"numa", no_argument, 0, OPT_NUMA},
             {0, 0, 0, 0}
         };
 
@@ -779,6 +833,46 @@ int main_safari(int argc, char** argv) {
             case OPT_NAMED_COORDINATES:
                 named_coordinates = true;
                 break;
+                
+            case OPT_SORT:
+                sort_output = true;
+                break;
+                
+            case OPT_SORT_MEMORY:
+                {
+                    size_t megabytes = parse<size_t>(optarg);
+                    if (megabytes == 0) {
+                        cerr << "error:[vg safari] Sort memory (--sort-memory) must be a positive integer" << endl;
+                        exit(1);
+                    }
+                    hts_options.sort_memory = megabytes * 1024 * 1024;
+                }
+                break;
+                
+            case OPT_SORT_INDEX:
+                hts_options.index_filename = optarg;
+                break;
+                
+            case OPT_MARK_DUPLICATES:
+                hts_options.mark_duplicates = true;
+                break;
+                
+            case OPT_REMOVE_DUPLICATES:
+                hts_options.mark_duplicates = true;
+                hts_options.remove_duplicates = true;
+                break;
+                
+            case OPT_DUPLICATE_STATS:
+                hts_options.duplicate_stats_filename = optarg;
+                break;
+
+            case OPT_SERVE:
+                serve_socket = optarg;
+                break;
+
+            case OPT_NUMA:
+                numa = true;
+                break;
 
             case 'n':
                 discard_alignments = true;
@@ -1003,6 +1097,14 @@ int main_safari(int argc, char** argv) {
                 rescue_seed_limit = parse<size_t>(optarg);
                 break;
 
+            case OPT_GBWT_CACHE_RECORDS:
+                gbwt_cache_records = parse<size_t>(optarg);
+                break;
+
+            case OPT_MAX_DOZEU_CELLS:
+                max_dozeu_cells = parse<size_t>(optarg);
+                break;
+
             case OPT_TRACK_PROVENANCE:
                 track_provenance = true;
                 break;
@@ -1108,11 +1210,38 @@ if (deam3pfreqE == "" || deam5pfreqE == ""){throw runtime_error("[safari] Must p
     // Decide if we are outputting to an htslib format
     bool hts_output = (output_format == "SAM" || output_format == "BAM" || output_format == "CRAM");
     
-    if (!ref_paths_name.empty() && !hts_output) {
+    if (!ref_paths_name.empty() && !hts_output && serve_socket.empty()) {
         cerr << "warning:[vg safari] Reference path file (--ref-paths) is only used when output format (-o) is SAM, BAM, or CRAM." << endl;
         ref_paths_name = "";
     }
     
+    if (!serve_socket.empty() && (sort_output || !hts_options.index_filename.empty() || hts_options.mark_duplicates ||
+                                  !hts_options.duplicate_stats_filename.empty() || discard_alignments)) {
+        // These are about one output file, and a server writes one per job.
+        cerr << "error:[vg safari] A server (--serve) can't sort, index, mark duplicates in, or discard its jobs' outputs." << endl;
+        exit(1);
+    }
+    
+    if ((sort_output || !hts_options.index_filename.empty()) && !hts_output) {
+        cerr << "error:[vg safari] Sorting (--sort) and indexing (--sort-index) are only available when output format (-o) is SAM, BAM, or CRAM." << endl;
+        exit(1);
+    }
+    
+    if (!hts_options.index_filename.empty() && (!sort_output || output_format != "BAM")) {
+        cerr << "error:[vg safari] Indexing (--sort-index) requires sorted (--sort) BAM output." << endl;
+        exit(1);
+    }
+    
+    if ((hts_options.mark_duplicates || !hts_options.duplicate_stats_filename.empty()) && !sort_output) {
+        cerr << "error:[vg safari] Duplicate marking (--mark-duplicates, --remove-duplicates, --duplicate-stats) requires sorted (--sort) output." << endl;
+        exit(1);
+    }
+    
+    if (!hts_options.duplicate_stats_filename.empty() && !hts_options.mark_duplicates) {
+        // Asking for statistics implies looking for duplicates.
+        hts_options.mark_duplicates = true;
+    }
+    
     if (output_format != "GAM" && !output_basename.empty()) {
         cerr << "error:[vg safari] Using an output basename (--output-basename) only makes sense for GAM format (-o)" << endl;
         exit(1);
@@ -1127,6 +1256,22 @@ if (deam3pfreqE == "" || deam5pfreqE == ""){throw runtime_error("[safari] Must p
         cerr << "error:[vg safari] Cannot designate both FASTQ input (-f) and GAM input (-G) in same run." << endl;
         exit(1);
     }
+
+    if (!serve_socket.empty() && (!fastq_filename_1.empty() || !gam_filename.empty() || !output_basename.empty())) {
+        cerr << "error:[vg safari] A server (--serve) gets its reads and outputs from jobs, not from -f, -G, or --output-basename." << endl;
+        exit(1);
+    }
+
+    // Count the parameter combinations a sweep will run.
+    size_t combo_count = 0;
+    for_each_combo([&]() {
+        combo_count++;
+    });
+
+    if (!serve_socket.empty() && combo_count > 1) {
+        cerr << "error:[vg safari] A server (--serve) runs with one set of parameters; use single values instead of ranges." << endl;
+        exit(1);
+    }
     
     if (have_input_file(optind, argc, argv)) {
         // TODO: work out how to interpret additional files as reads.
@@ -1209,6 +1354,21 @@ if (deam3pfreqE == "" || deam5pfreqE == ""){throw runtime_error("[safari] Must p
     }
 #endif
 
+    // On a multi-socket machine, every thread probes the big indexes at
+    // random, so spread their pages over all the nodes while they load.
+    vector<NumaNode> numa_nodes;
+    unique_ptr<NumaInterleave> numa_interleave;
+    if (numa) {
+        numa_nodes = get_numa_nodes();
+        if (show_progress) {
+            cerr << "NUMA nodes: " << describe_numa_nodes(numa_nodes) << endl;
+        }
+        numa_interleave.reset(new NumaInterleave(numa_nodes));
+        if (show_progress && numa_interleave->is_active()) {
+            cerr << "Interleaving indexes over " << numa_nodes.size() << " NUMA nodes" << endl;
+        }
+    }
+
     // Grab the minimizer index
     auto minimizer_index = vg::io::VPKG::load_one<gbwtgraph::DefaultMinimizerIndex>(registry.require("Minimizers").at(0));
 
@@ -1225,6 +1385,15 @@ if (deam3pfreqE == "" || deam5pfreqE == ""){throw runtime_error("[safari] Must p
         cerr << "Loading Distance Index v2" << endl;
     }
 
+    if (numa) {
+        // Everything from here on belongs to the thread that makes it, so
+        // let it go on the thread's own node.
+        numa_interleave.reset();
+        if (!pin_omp_threads(numa_nodes)) {
+            cerr << "warning:[vg safari] Could not pin mapping threads to CPUs" << endl;
+        }
+    }
+
     // If we are tracking correctness, we will fill this in with a graph for
     // getting offsets along ref paths.
     PathPositionHandleGraph* path_position_graph = nullptr;
@@ -1233,7 +1402,7 @@ if (deam3pfreqE == "" || deam5pfreqE == ""){throw runtime_error("[safari] Must p
     bdsg::ReferencePathOverlayHelper overlay_helper;
     // And we might load an XG
     unique_ptr<PathHandleGraph> xg_graph;
-    if (track_correctness || hts_output) {
+    if (track_correctness || hts_output || !serve_socket.empty()) {
         // Usually we will get our paths from the GBZ
         PathHandleGraph* base_graph = &gbz->graph;
         // But if an XG is around, we should use that instead. Otherwise, it's not possible to provide paths when using an old GBWT/GBZ that doesn't have them.
@@ -1280,6 +1449,14 @@ if (deam3pfreqE == "" || deam5pfreqE == ""){throw runtime_error("[safari] Must p
         report << "#file\treads/second/thread" << endl;
     }
 
+    // When sweeping, each read's minimizers, rymer candidates and seeds are
+    // kept between combinations, and a combination only redoes the stages
+    // from the first one its settings change.
+    MinimizerMapper::ReadStageCache stage_cache;
+    if (combo_count > 1 && !track_provenance && serve_socket.empty()) {
+        minimizer_mapper.stage_cache = &stage_cache;
+    }
+
     // We need to loop over all the ranges...
     for_each_combo([&]() {
     
@@ -1306,6 +1483,14 @@ if (deam3pfreqE == "" || deam5pfreqE == ""){throw runtime_error("[safari] Must p
             s << "-U" << max_unique_min;
             s << "-w" << extension_set;
             s << "-v" << extension_score;
+            // These are newer, so only name them when they are being swept,
+            // to keep the other names the same.
+            if (spurious_alignment_prior.start != spurious_alignment_prior.end) {
+                s << "-V" << spurious_alignment_prior;
+            }
+            if (posterior_threshold.start != posterior_threshold.end) {
+                s << "-j" << posterior_threshold;
+            }
             
             s << ".gam";
             
@@ -1412,6 +1597,16 @@ if (deam3pfreqE == "" || deam5pfreqE == ""){throw runtime_error("[safari] Must p
             cerr << "--distance-limit " << distance_limit << endl;
         }
         minimizer_mapper.distance_limit = distance_limit;
+
+        if (show_progress) {
+            cerr << "--gbwt-cache-records " << gbwt_cache_records << endl;
+        }
+        minimizer_mapper.gbwt_cache_records = gbwt_cache_records;
+
+        if (show_progress) {
+            cerr << "--max-dozeu-cells " << max_dozeu_cells << endl;
+        }
+        minimizer_mapper.max_dozeu_cells = max_dozeu_cells;
         
         if (show_progress && track_provenance) {
             cerr << "--track-provenance " << endl;
@@ -1459,6 +1654,26 @@ if (deam3pfreqE == "" || deam5pfreqE == ""){throw runtime_error("[safari] Must p
         minimizer_mapper.sample_name = sample_name;
         minimizer_mapper.read_group = read_group;
 
+        if (minimizer_mapper.stage_cache != nullptr) {
+            // Drop the stages these settings would compute differently.
+            stage_cache.update(minimizer_mapper);
+        }
+
+        if (!serve_socket.empty()) {
+            // These settings are the defaults for jobs, which we serve until
+            // a client tells us to stop.
+            SafariServer server(minimizer_mapper, gbz->graph, path_position_graph, ref_paths_name);
+            server.show_progress = show_progress;
+            if (prune_anchors) {
+                server.emitter_flags |= ALIGNMENT_EMITTER_FLAG_HTS_PRUNE_SUSPICIOUS_ANCHORS;
+            }
+            if (named_coordinates) {
+                server.emitter_flags |= ALIGNMENT_EMITTER_FLAG_VG_USE_SEGMENT_NAMES;
+            }
+            server.serve(serve_socket);
+            return;
+        }
+
         // Work out the number of threads we will have
         size_t thread_count = omp_get_max_threads();
 
@@ -1546,6 +1761,10 @@ if (deam3pfreqE == "" || deam5pfreqE == ""){throw runtime_error("[safari] Must p
                     // When not surjecting, use named segments instead of node IDs.
                     flags |= ALIGNMENT_EMITTER_FLAG_VG_USE_SEGMENT_NAMES;
                 }
+                if (sort_output) {
+                    // Hold back HTSlib records and write them in coordinate order.
+                    flags |= ALIGNMENT_EMITTER_FLAG_HTS_SORT;
+                }
                 
                 // We send along the positional graph when we have it, and otherwise we send the GBWTGraph which is sufficient for GAF output.
                 // TODO: What if we need both a positional graph and a NamedNodeBackTranslation???
@@ -1553,7 +1772,7 @@ if (deam3pfreqE == "" || deam5pfreqE == ""){throw runtime_error("[safari] Must p
                 
                 alignment_emitter = get_alignment_emitter(output_filename, output_format,
                                                           paths, thread_count,
-                                                          emitter_graph, flags);
+                                                          emitter_graph, flags, hts_options);
             }
             
 #ifdef USE_CALLGRIND
@@ -1786,6 +2005,14 @@ if (deam3pfreqE == "" || deam5pfreqE == ""){throw runtime_error("[safari] Must p
             }
 
             cerr << "Memory footprint: " << gbwt::inGigabytes(gbwt::memoryUsage()) << " GB" << endl;
+
+            // Report on the GBWT caches so they can be sized.
+            auto cache_statistics = MinimizerMapper::GBWTCache::get_statistics();
+            if (cache_statistics.uses != 0) {
+                cerr << "GBWT cache: " << cache_statistics.records_decompressed << " records decompressed over "
+                    << cache_statistics.uses << " uses (" << (double) cache_statistics.records_decompressed / cache_statistics.uses
+                    << " per use); " << cache_statistics.clears << " full caches cleared" << endl;
+            }
         }
         
         
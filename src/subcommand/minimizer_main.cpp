@@ -23,6 +23,7 @@
 #include <vg/io/vpkg.hpp>
 
 #include <algorithm>
+#include <fstream>
 #include <iostream>
 #include <vector>
 
@@ -67,7 +68,12 @@ void help_minimizer(char** argv) {
     std::cerr << "    -d, --distance-index X  annotate the hits with positions in this distance index" << std::endl;
     std::cerr << "    -l, --load-index X      load the index from file X and insert the new kmers into it" << std::endl;
     std::cerr << "                            (overrides minimizer options)" << std::endl;
+    std::cerr << "    -U, --update-from X     with -l, only scan the haplotypes not in the GBZ in file X for new kmers" << std::endl;
+    std::cerr << "                            (every node and edge of that graph must be in the input graph; this only" << std::endl;
+    std::cerr << "                            saves scanning the old haplotypes: the distance index for -d must still" << std::endl;
+    std::cerr << "                            be built for the input graph, and every payload in the index is recomputed)" << std::endl;
     std::cerr << "    -g, --gbwt-name X       use the GBWT index in file X (required with a non-GBZ graph)" << std::endl;
+    std::cerr << "    -D, --dump X            also write the hits in the index to file X as sorted text" << std::endl;
     std::cerr << "    -p, --progress          show progress information" << std::endl;
     std::cerr << "    -t, --threads N         use N threads for index construction (default " << get_default_threads() << ")" << std::endl;
     std::cerr << "                            (using more than " << DEFAULT_MAX_THREADS << " threads rarely helps)" << std::endl;
@@ -82,7 +88,7 @@ int main_minimizer(int argc, char** argv) {
     }
 
     // Command-line options.
-    std::string output_name, distance_name, load_index, gbwt_name, graph_name;
+    std::string output_name, distance_name, load_index, update_from, gbwt_name, graph_name, dump_name;
     bool use_syncmers = false;
     bool progress = false;
     int threads = get_default_threads();
@@ -102,6 +108,8 @@ int main_minimizer(int argc, char** argv) {
             { "smer-length", required_argument, 0, 's' },
             { "distance-index", required_argument, 0, 'd' },
             { "load-index", required_argument, 0, 'l' },
+            { "update-from", required_argument, 0, 'U' },
+            { "dump", required_argument, 0, 'D' },
             { "gbwt-graph", no_argument, 0, 'G' }, // deprecated
             { "progress", no_argument, 0, 'p' },
             { "threads", required_argument, 0, 't' },
@@ -109,7 +117,7 @@ int main_minimizer(int argc, char** argv) {
         };
 
         int option_index = 0;
-        c = getopt_long(argc, argv, "g:o:i:k:w:bcs:d:l:Gpt:h", long_options, &option_index);
+        c = getopt_long(argc, argv, "g:o:i:k:w:bcs:d:l:U:D:Gpt:h", long_options, &option_index);
         if (c == -1) { break; } // End of options.
 
         switch (c)
@@ -146,6 +154,12 @@ int main_minimizer(int argc, char** argv) {
         case 'l':
             load_index = optarg;
             break;
+        case 'U':
+            update_from = optarg;
+            break;
+        case 'D':
+            dump_name = optarg;
+            break;
         case 'G':
             std::cerr << "[vg minimizer] warning: --gbwt-graph is deprecated, graph format is now autodetected" << std::endl;
             break;
@@ -170,6 +184,10 @@ int main_minimizer(int argc, char** argv) {
         std::cerr << "[vg minimizer] error: option --output-name is required" << std::endl;
         return 1;
     }
+    if (!update_from.empty() && load_index.empty()) {
+        std::cerr << "[vg minimizer] error: option --update-from requires --load-index" << std::endl;
+        return 1;
+    }
     if (optind + 1 != argc) {
         help_minimizer(argv);
         return 1;
@@ -264,16 +282,33 @@ int main_minimizer(int argc, char** argv) {
         std::cerr << std::endl;
     }
 
+    // If we are updating an index, find the haplotypes it doesn't have yet.
+    std::vector<gbwt::size_type> update_threads;
+    if (!update_from.empty()) {
+        update_threads = find_update_threads(*gbz, update_from, progress);
+    }
 
-  if (distance_name.empty()) {
-    gbwtgraph::index_haplotypes(gbz->graph, false, *index, [](const pos_t&) -> gbwtgraph::payload_type {
+    std::function<gbwtgraph::payload_type(const pos_t&)> get_payload = [](const pos_t&) -> gbwtgraph::payload_type {
         return MIPayload::NO_CODE;
-    }, IndexingParameters::minimizer_k);
-} else {
-    gbwtgraph::index_haplotypes(gbz->graph, false, *index, [&](const pos_t& pos) -> gbwtgraph::payload_type {
-        return MIPayload::encode(get_minimizer_distances(*distance_index,pos));
-    }, IndexingParameters::minimizer_k);
-}
+    };
+    if (distance_index) {
+        get_payload = [&](const pos_t& pos) -> gbwtgraph::payload_type {
+            return MIPayload::encode(get_minimizer_distances(*distance_index, pos));
+        };
+    }
+
+    if (update_from.empty()) {
+        gbwtgraph::index_haplotypes(gbz->graph, false, *index, get_payload, IndexingParameters::minimizer_k);
+    } else {
+        // The old graph is part of this one, so the positions already in the
+        // index still hold. The payloads depend on the snarl decomposition of
+        // the whole graph and must be recomputed from this distance index.
+        if (progress) {
+            std::cerr << "Recomputing payloads for " << index->values() << " existing hits" << std::endl;
+        }
+        recompute_payloads(*index, get_payload);
+        index_haplotype_threads(gbz->graph, update_threads, false, *index, get_payload);
+    }
 
     // Index statistics.
     if (progress) {
@@ -287,6 +322,14 @@ int main_minimizer(int argc, char** argv) {
 
     // Serialize the index.
     save_minimizer(*index, output_name);
+    if (!dump_name.empty()) {
+        std::ofstream dump(dump_name);
+        if (!dump) {
+            std::cerr << "[vg minimizer] error: cannot open " << dump_name << " for writing" << std::endl;
+            return 1;
+        }
+        dump_minimizer(*index, dump);
+    }
 
     if (progress) {
         double seconds = gbwt::readTimer() - start;
@@ -32,6 +32,13 @@ void help_pack(char** argv) {
          << "    -Q, --min-mapq N       ignore reads with MAPQ < N and positions with base quality < N [default: 0]" << endl
          << "    -c, --expected-cov N   expected coverage.  used only for memory tuning [default : 128]" << endl
          << "    -s, --trim-ends N      ignore the first and last N bases of each read" << endl 
+         << "    -B, --thread-buffer N  collect up to N coverage increments per thread before locking the shared counts" << endl
+         << "                           (0 to lock for every base) [default: 65536]" << endl
+         << "damage masking:" << endl
+         << "    -y, --deam-5p FILE     5' end deamination rate matrix (must end in .prof)" << endl
+         << "    -Y, --deam-3p FILE     3' end deamination rate matrix (must end in .prof)" << endl
+         << "    -P, --damage-prob P    with -y and -Y, ignore C->T and G->A substitutions near read ends that" << endl
+         << "                           deamination explains with probability at least P [default: 0.05]" << endl
          << "    -t, --threads N        use N threads (defaults to numCPUs)" << endl;
 }
 
@@ -54,6 +61,10 @@ int main_pack(int argc, char** argv) {
     int min_baseq = 0;
     size_t expected_coverage = 128;
     int trim_ends = 0;
+    size_t thread_buffer_size = 65536;
+    string deam5p_file;
+    string deam3p_file;
+    double min_damage_prob = 0.05;
 
     if (argc == 2) {
         help_pack(argv);
@@ -82,11 +93,15 @@ int main_pack(int argc, char** argv) {
             {"min-mapq", required_argument, 0, 'Q'},
             {"expected-cov", required_argument, 0, 'c'},
             {"trim-ends", required_argument, 0, 's'},
+            {"thread-buffer", required_argument, 0, 'B'},
+            {"deam-5p", required_argument, 0, 'y'},
+            {"deam-3p", required_argument, 0, 'Y'},
+            {"damage-prob", required_argument, 0, 'P'},
             {0, 0, 0, 0}
 
         };
         int option_index = 0;
-        c = getopt_long (argc, argv, "hx:o:i:g:a:dDut:eb:n:N:Q:c:s:",
+        c = getopt_long (argc, argv, "hx:o:i:g:a:dDut:eb:n:N:Q:c:s:B:y:Y:P:",
                 long_options, &option_index);
 
         // Detect the end of the options.
@@ -156,6 +171,18 @@ int main_pack(int argc, char** argv) {
         case 's':
             trim_ends = parse<int>(optarg);
             break;
+        case 'B':
+            thread_buffer_size = parse<size_t>(optarg);
+            break;
+        case 'y':
+            deam5p_file = optarg;
+            break;
+        case 'Y':
+            deam3p_file = optarg;
+            break;
+        case 'P':
+            min_damage_prob = parse<double>(optarg);
+            break;
         default:
             abort();
         }
@@ -187,6 +214,15 @@ int main_pack(int argc, char** argv) {
         exit(1);
     }
 
+    if (deam5p_file.empty() != deam3p_file.empty()) {
+        cerr << "error [vg pack]: -y and -Y must be used together" << endl;
+        exit(1);
+    }
+    if (min_damage_prob <= 0 || min_damage_prob > 1) {
+        cerr << "error [vg pack]: damage probability (-P) must be in (0, 1]" << endl;
+        exit(1);
+    }
+
     // process input node list
     if (!node_list_file.empty()) {
         ifstream nli;
@@ -216,7 +252,10 @@ int main_pack(int argc, char** argv) {
     size_t bin_count = Packer::estimate_bin_count(num_threads);
 
     // create our packer
-    Packer packer(graph, true, true, record_edits, true, bin_size, bin_count, data_width);
+    Packer packer(graph, true, true, record_edits, true, bin_size, bin_count, data_width, thread_buffer_size);
+    if (!deam5p_file.empty()) {
+        packer.set_damage_mask(deam5p_file, deam3p_file, min_damage_prob);
+    }
     
     // todo one packer per thread and merge
     if (packs_in.size() == 1) {
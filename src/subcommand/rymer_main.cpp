@@ -66,6 +66,9 @@ void help_rymer(char** argv) {
     std::cerr << "    -d, --distance-index X  annotate the hits with positions in this distance index" << std::endl;
     std::cerr << "    -l, --load-index X      load the index from file X and insert the new RYmers into it" << std::endl;
     std::cerr << "                            (overrides RYmer options)" << std::endl;
+    std::cerr << "    -U, --update-from X     with -l, only scan the haplotypes not in the GBZ in file X for new RYmers" << std::endl;
+    std::cerr << "                            (every node and edge of that graph must be in the input graph; this only" << std::endl;
+    std::cerr << "                            saves scanning the old haplotypes)" << std::endl;
     std::cerr << "    -g, --gbwt-name X       use the GBWT index in file X (required with a non-GBZ graph)" << std::endl;
     std::cerr << "    -p, --progress          show progress information" << std::endl;
     std::cerr << "    -t, --threads N         use N threads for index construction (default " << get_default_threads_rymer() << ")" << std::endl;
@@ -81,7 +84,7 @@ int main_rymer(int argc, char** argv) {
     }
 
     // Command-line options.
-    std::string output_name, distance_name, load_index, gbwt_name, graph_name;
+    std::string output_name, distance_name, load_index, update_from, gbwt_name, graph_name;
     bool use_syncmers = false;
     bool progress = false;
     int threads = get_default_threads_rymer();
@@ -101,6 +104,7 @@ int main_rymer(int argc, char** argv) {
             { "smer-length", required_argument, 0, 's' },
             { "distance-index", required_argument, 0, 'd' },
             { "load-index", required_argument, 0, 'l' },
+            { "update-from", required_argument, 0, 'U' },
             { "gbwt-graph", no_argument, 0, 'G' }, // deprecated
             { "progress", no_argument, 0, 'p' },
             { "threads", required_argument, 0, 't' },
@@ -108,7 +112,7 @@ int main_rymer(int argc, char** argv) {
         };
 
         int option_index = 0;
-        c = getopt_long(argc, argv, "g:o:i:k:w:bcs:d:l:Gpt:h", long_options, &option_index);
+        c = getopt_long(argc, argv, "g:o:i:k:w:bcs:d:l:U:Gpt:h", long_options, &option_index);
         if (c == -1) { break; } // End of options.
 
         switch (c)
@@ -145,6 +149,9 @@ int main_rymer(int argc, char** argv) {
         case 'l':
             load_index = optarg;
             break;
+        case 'U':
+            update_from = optarg;
+            break;
         case 'G':
             std::cerr << "[vg rymer] warning: --gbwt-graph is deprecated, graph format is now autodetected" << std::endl;
             break;
@@ -169,6 +176,10 @@ int main_rymer(int argc, char** argv) {
         std::cerr << "[vg rymer] error: option --output-name is required" << std::endl;
         return 1;
     }
+    if (!update_from.empty() && load_index.empty()) {
+        std::cerr << "[vg rymer] error: option --update-from requires --load-index" << std::endl;
+        return 1;
+    }
     if (optind + 1 != argc) {
         help_rymer(argv);
         return 1;
@@ -262,16 +273,29 @@ if (IndexingParameters::rymer_k < 10){throw runtime_error("[vg rymer] k must be
         std::cerr << std::endl;
     }
 
+    // If we are updating an index, find the haplotypes it doesn't have yet.
+    std::vector<gbwt::size_type> update_threads;
+    if (!update_from.empty()) {
+        update_threads = find_update_threads(*gbz, update_from, progress);
+    }
 
-  if (distance_name.empty()) {
-    gbwtgraph::index_haplotypes(gbz->graph, true, *rymer_index, [](const pos_t&) -> gbwtgraph::payload_type {
+    std::function<gbwtgraph::payload_type(const pos_t&)> get_payload = [](const pos_t&) -> gbwtgraph::payload_type {
         return MIPayload::NO_CODE;
-    }, IndexingParameters::rymer_k);
-} else {
-    gbwtgraph::index_haplotypes(gbz->graph, true, *rymer_index, [&](const pos_t& pos) -> gbwtgraph::payload_type {
-        return MIPayload::encode(get_minimizer_distances(*distance_index,pos));
-    }, IndexingParameters::rymer_k);
-}
+    };
+    if (distance_index) {
+        get_payload = [&](const pos_t& pos) -> gbwtgraph::payload_type {
+            return MIPayload::encode(get_minimizer_distances(*distance_index, pos));
+        };
+    }
+
+    if (update_from.empty()) {
+        gbwtgraph::index_haplotypes(gbz->graph, true, *rymer_index, get_payload, IndexingParameters::rymer_k);
+    } else {
+        // The old graph is part of this one, so the positions already in the
+        // index still hold. RYmer payloads are kmer keys, which do not depend
+        // on the graph, so we only need the new threads.
+        index_haplotype_threads(gbz->graph, update_threads, true, *rymer_index, get_payload);
+    }
 
     // Index statistics.
     if (progress) {
@@ -0,0 +1,206 @@
+/** \file safari_submit_main.cpp
+ *
+ * Defines the "vg safari-submit" subcommand, which sends a mapping job to a
+ * "vg safari --serve" server and reports its progress.
+ */
+
+#include "subcommand.hpp"
+
+#include <cctype>
+#include <iostream>
+#include <string>
+
+#include <getopt.h>
+#include <unistd.h>
+
+#include "../safari_server.hpp"
+
+using namespace std;
+using namespace vg;
+using namespace vg::subcommand;
+
+void help_safari_submit(char** argv) {
+    cerr
+    << "usage: " << argv[0] << " safari-submit [options] -s SOCKET" << endl
+    << "Map reads with a running 'vg safari --serve' server, which keeps its indexes loaded." << endl
+    << endl
+    << "options:" << endl
+    << "  -s, --socket FILE             submit to the server listening on this UNIX socket" << endl
+    << "  -f, --fastq-in FILE           align FASTQ-format reads from FILE (two are allowed, one for each mate)" << endl
+    << "  -G, --gam-in FILE             realign GAM-format reads from FILE" << endl
+    << "  -i, --interleaved             GAM/FASTQ input is interleaved pairs, for paired-end alignment" << endl
+    << "  -O, --output FILE             have the server write alignments to FILE" << endl
+    << "  -o, --output-format NAME      output the alignments in NAME format (gam / gaf / json / tsv / SAM / BAM / CRAM) [gam]" << endl
+    << "  --deam-3p FILE                3' end deamination rate matrix for this job (must end in .prof)" << endl
+    << "  --deam-5p FILE                5' end deamination rate matrix for this job (must end in .prof)" << endl
+    << "  -N, --sample NAME             add this sample name" << endl
+    << "  -R, --read-group NAME         add this read group" << endl
+    << "  -S, --set NAME=VALUE          change a mapping setting for this job, named like the 'vg safari'" << endl
+    << "                                long option (e.g. hit-cap=20, fragment-mean=60)" << endl
+    << "  --shutdown                    ask the server to stop instead of mapping" << endl;
+}
+
+/// Make a path absolute, since the server may not share our working directory.
+static string make_absolute(const string& path) {
+    if (path.empty() || path[0] == '/') {
+        return path;
+    }
+    char* cwd = getcwd(nullptr, 0);
+    if (cwd == nullptr) {
+        cerr << "error:[vg safari-submit] Could not get the working directory" << endl;
+        exit(1);
+    }
+    string absolute = string(cwd) + "/" + path;
+    free(cwd);
+    return absolute;
+}
+
+int main_safari_submit(int argc, char** argv) {
+
+    if (argc == 2) {
+        help_safari_submit(argv);
+        return 1;
+    }
+
+    #define OPT_DEAM_3P 1000
+    #define OPT_DEAM_5P 1001
+    #define OPT_SHUTDOWN 1002
+
+    string socket_path;
+    SafariJob job;
+
+    int c;
+    optind = 2; // force optind past command positional argument
+    while (true) {
+        static struct option long_options[] =
+        {
+            {"help", no_argument, 0, 'h'},
+            {"socket", required_argument, 0, 's'},
+            {"fastq-in", required_argument, 0, 'f'},
+            {"gam-in", required_argument, 0, 'G'},
+            {"interleaved", no_argument, 0, 'i'},
+            {"output", required_argument, 0, 'O'},
+            {"output-format", required_argument, 0, 'o'},
+            {"deam-3p", required_argument, 0, OPT_DEAM_3P},
+            {"deam-5p", required_argument, 0, OPT_DEAM_5P},
+            {"sample", required_argument, 0, 'N'},
+            {"read-group", required_argument, 0, 'R'},
+            {"set", required_argument, 0, 'S'},
+            {"shutdown", no_argument, 0, OPT_SHUTDOWN},
+            {0, 0, 0, 0}
+        };
+
+        int option_index = 0;
+        c = getopt_long (argc, argv, "hs:f:G:iO:o:N:R:S:",
+                         long_options, &option_index);
+
+        // Detect the end of the options.
+        if (c == -1)
+            break;
+
+        switch (c)
+        {
+            case 's':
+                socket_path = optarg;
+                break;
+
+            case 'f':
+                if (job.fastq_1.empty()) {
+                    job.fastq_1 = make_absolute(optarg);
+                } else if (job.fastq_2.empty()) {
+                    job.fastq_2 = make_absolute(optarg);
+                } else {
+                    cerr << "error:[vg safari-submit] Cannot specify more than two FASTQ files" << endl;
+                    exit(1);
+                }
+                break;
+
+            case 'G':
+                job.gam_filename = make_absolute(optarg);
+                break;
+
+            case 'i':
+                job.interleaved = true;
+                break;
+
+            case 'O':
+                job.output_filename = make_absolute(optarg);
+                break;
+
+            case 'o':
+                job.output_format = optarg;
+                for (char& c : job.output_format) {
+                    c = std::toupper(c);
+                }
+                break;
+
+            case OPT_DEAM_3P:
+                job.deam_3p = make_absolute(optarg);
+                break;
+
+            case OPT_DEAM_5P:
+                job.deam_5p = make_absolute(optarg);
+                break;
+
+            case 'N':
+                job.settings["sample"] = optarg;
+                break;
+
+            case 'R':
+                job.settings["read-group"] = optarg;
+                break;
+
+            case 'S':
+                {
+                    string setting = optarg;
+                    size_t equals = setting.find('=');
+                    if (equals == string::npos || equals == 0) {
+                        cerr << "error:[vg safari-submit] Setting " << setting << " is not NAME=VALUE" << endl;
+                        exit(1);
+                    }
+                    job.settings[setting.substr(0, equals)] = setting.substr(equals + 1);
+                }
+                break;
+
+            case OPT_SHUTDOWN:
+                job.shutdown = true;
+                break;
+
+            case 'h':
+            case '?':
+            default:
+                help_safari_submit(argv);
+                exit(1);
+                break;
+        }
+    }
+
+    if (socket_path.empty()) {
+        cerr << "error:[vg safari-submit] A server socket (-s) is required" << endl;
+        exit(1);
+    }
+    if (!job.shutdown) {
+        // The server checks everything, but catch the obvious mistakes here.
+        if (job.fastq_1.empty() == job.gam_filename.empty()) {
+            cerr << "error:[vg safari-submit] Exactly one of FASTQ input (-f) or GAM input (-G) is required" << endl;
+            exit(1);
+        }
+        if (job.output_filename.empty()) {
+            cerr << "error:[vg safari-submit] An output file (-O) is required" << endl;
+            exit(1);
+        }
+    }
+
+    bool succeeded;
+    try {
+        succeeded = submit_safari_job(socket_path, job, cerr);
+    } catch (runtime_error& e) {
+        cerr << "error:[vg safari-submit] " << e.what() << endl;
+        exit(1);
+    }
+
+    return succeeded ? 0 : 1;
+}
+
+// Register subcommand
+static Subcommand vg_safari_submit("safari-submit", "map reads with a running safari server", PIPELINE, main_safari_submit);
@@ -52,6 +52,7 @@ void help_surject(char** argv) {
          << "  -R, --read-group NAME   set this read group for all reads" << endl
          << "  -f, --max-frag-len N    reads with fragment lengths greater than N will not be marked properly paired in SAM/BAM/CRAM" << endl
          << "  -L, --list-all-paths    annotate SAM records with a list of all attempted re-alignments to paths in SS tag" << endl
+         << "  -O, --sorted-input      input is sorted by node ID (e.g. by vg gamsort), so cache lookups across reads" << endl
          << "  -C, --compression N     level for compression [0-9]" << endl;
 }
 
@@ -79,6 +80,7 @@ int main_surject(int argc, char** argv) {
     bool prune_anchors = false;
     bool annotate_with_all_path_scores = false;
     bool multimap = false;
+    bool sorted_input = false;
 
     int c;
     optind = 2; // force optind past command positional argument
@@ -107,11 +109,12 @@ int main_surject(int argc, char** argv) {
             {"max-frag-len", required_argument, 0, 'f'},
             {"list-all-paths", no_argument, 0, 'L'},
             {"compress", required_argument, 0, 'C'},
+            {"sorted-input", no_argument, 0, 'O'},
             {0, 0, 0, 0}
         };
 
         int option_index = 0;
-        c = getopt_long (argc, argv, "hx:p:F:liGmcbsN:R:f:C:t:SPALM",
+        c = getopt_long (argc, argv, "hx:p:F:liGmcbsN:R:f:C:t:SPALMO",
                 long_options, &option_index);
 
         // Detect the end of the options.
@@ -201,6 +204,10 @@ int main_surject(int argc, char** argv) {
         case 'L':
             annotate_with_all_path_scores = true;
             break;
+            
+        case 'O':
+            sorted_input = true;
+            break;
 
         case 'h':
         case '?':
@@ -265,6 +272,7 @@ int main_surject(int argc, char** argv) {
         surjector.min_splice_length = numeric_limits<int64_t>::max();
     }
     surjector.annotate_with_all_path_scores = annotate_with_all_path_scores;
+    surjector.set_sorted_input(sorted_input);
     
     // Count our threads
     int thread_count = vg::get_thread_count();
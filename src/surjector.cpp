@@ -19,6 +19,9 @@
 
 #include "bdsg/hash_graph.hpp"
 
+#include <deque>
+#include <omp.h>
+
 //#define debug_spliced_surject
 //#define debug_anchored_surject
 //#define debug_multipath_surject
@@ -32,12 +35,147 @@ namespace vg {
 
 using namespace std;
     
+    /**
+     * When the input is sorted by node ID, consecutive reads mostly look up the
+     * same nodes and realign against the same stretch of each path, so we hold
+     * onto those results and slide forward along with the input.
+     */
+    struct Surjector::SortedInputCache {
+        
+        SortedInputCache(const PathPositionHandleGraph* graph, size_t max_nodes) : memoizing_graph(graph) {
+            memoizing_graph.max_handle_memo_size = max_nodes;
+            memoizing_graph.max_steps_of_handle_memo_size = max_nodes;
+        }
+        
+        /// Memoized node and step lookups, kept across reads
+        MemoizingGraph memoizing_graph;
+        
+        /// The lowest node ID that we have already dropped memoized results below
+        id_t memo_floor = 0;
+        
+        /// A step in the window of path that we hold onto
+        struct WindowStep {
+            step_handle_t step;
+            size_t position;
+            id_t node_id;
+            bool is_reverse;
+            string sequence;
+        };
+        
+        /// The path that the window is on
+        path_handle_t window_path;
+        
+        /// Consecutive steps along the window path
+        deque<WindowStep> window;
+        
+        /// The most recently extracted linearized path graph
+        bdsg::HashGraph path_graph;
+        
+        /// The translation from the linearized path graph to the graph
+        unordered_map<id_t, pair<id_t, bool>> path_trans;
+        
+        /// The path interval that the linearized path graph covers, or an
+        /// interval where start > end if we don't have one
+        path_handle_t path_graph_path;
+        size_t path_graph_first = 1;
+        size_t path_graph_last = 0;
+        
+        /// Note that we've moved on to a read whose lowest node ID is the given
+        /// one, and drop memoized lookups behind it if the memo is filling up
+        void advance(id_t min_node_id) {
+            if (min_node_id > memo_floor &&
+                memoizing_graph.memo_size() >= memoizing_graph.max_handle_memo_size) {
+                memoizing_graph.forget_before(min_node_id);
+                memo_floor = min_node_id;
+            }
+        }
+        
+        /// Make path_graph and path_trans into the linearized path graph for the
+        /// given end-inclusive interval of a non-circular path, reusing the window
+        /// of path steps left over from previous reads where we can
+        void extract_linearized_path_graph(const PathPositionHandleGraph* graph, path_handle_t path_handle,
+                                           size_t first, size_t last) {
+            
+            if (path_handle == path_graph_path && first == path_graph_first && last == path_graph_last) {
+                // we just made this one
+                return;
+            }
+            
+            if (window.empty() || path_handle != window_path || first < window.front().position
+                || first >= window.back().position + window.back().sequence.size()) {
+                // we can't slide the window to this interval, start over
+                window.clear();
+                window_path = path_handle;
+                push_step(graph, graph->get_step_at_position(path_handle, first));
+            }
+            
+            // forget the steps that we've moved past
+            while (window.size() > 1 && window[1].position <= first) {
+                window.pop_front();
+            }
+            
+            // and walk forward until the window reaches the end of the interval
+            while (window.back().position + window.back().sequence.size() <= last
+                   && graph->has_next_step(window.back().step)) {
+                push_step(graph, graph->get_next_step(window.back().step));
+            }
+            
+            path_graph.clear();
+            path_trans.clear();
+            handle_t prev_node;
+            for (size_t i = 0; i < window.size() && window[i].position <= last; ++i) {
+                handle_t node_here = path_graph.create_handle(window[i].sequence);
+                if (i != 0) {
+                    path_graph.create_edge(prev_node, node_here);
+                }
+                path_trans[path_graph.get_id(node_here)] = make_pair(window[i].node_id, window[i].is_reverse);
+                prev_node = node_here;
+            }
+            
+            path_graph_path = path_handle;
+            path_graph_first = first;
+            path_graph_last = last;
+        }
+        
+    private:
+        
+        void push_step(const PathPositionHandleGraph* graph, const step_handle_t& step) {
+            handle_t handle = graph->get_handle_of_step(step);
+            window.emplace_back();
+            auto& window_step = window.back();
+            window_step.step = step;
+            window_step.position = graph->get_position_of_step(step);
+            window_step.node_id = graph->get_id(handle);
+            window_step.is_reverse = graph->get_is_reverse(handle);
+            window_step.sequence = graph->get_sequence(handle);
+        }
+    };
+    
     Surjector::Surjector(const PathPositionHandleGraph* graph) : graph(graph) {
         if (!graph) {
             cerr << "error:[Surjector] Failed to provide an graph to the Surjector" << endl;
         }
     }
     
+    Surjector::~Surjector() = default;
+    
+    void Surjector::set_sorted_input(bool sorted_input) {
+        sorted_input_caches.clear();
+        if (sorted_input) {
+            for (size_t i = 0; i < get_thread_count(); ++i) {
+                sorted_input_caches.emplace_back(new SortedInputCache(graph, max_sorted_cache_nodes));
+            }
+        }
+    }
+    
+    Surjector::SortedInputCache* Surjector::get_sorted_input_cache() const {
+        size_t thread_num = omp_get_thread_num();
+        if (thread_num < sorted_input_caches.size()) {
+            return sorted_input_caches[thread_num].get();
+        }
+        return nullptr;
+    }
+    
     Alignment Surjector::surject(const Alignment& source, const unordered_set<path_handle_t>& paths,
                                  bool allow_negative_scores, bool preserve_deletions) const {
     
@@ -198,13 +336,37 @@ using namespace std;
             source_mp_aln = &simplified_source_mp_aln;
         }
         
-        // make an overlay that will memoize the results of some expensive XG operations
-        MemoizingGraph memoizing_graph(graph);
+        // make an overlay that will memoize the results of some expensive XG operations, or
+        // reuse this thread's if the input is sorted
+        unique_ptr<MemoizingGraph> local_memoizing_graph;
+        MemoizingGraph* memoizing_graph;
+        SortedInputCache* sorted_input_cache = get_sorted_input_cache();
+        if (sorted_input_cache) {
+            id_t min_node_id = numeric_limits<id_t>::max();
+            if (source_aln) {
+                for (const auto& mapping : source_aln->path().mapping()) {
+                    min_node_id = min<id_t>(min_node_id, mapping.position().node_id());
+                }
+            }
+            else {
+                for (const auto& subpath : source_mp_aln->subpath()) {
+                    for (const auto& mapping : subpath.path().mapping()) {
+                        min_node_id = min<id_t>(min_node_id, mapping.position().node_id());
+                    }
+                }
+            }
+            sorted_input_cache->advance(min_node_id);
+            memoizing_graph = &sorted_input_cache->memoizing_graph;
+        }
+        else {
+            local_memoizing_graph = unique_ptr<MemoizingGraph>(new MemoizingGraph(graph));
+            memoizing_graph = local_memoizing_graph.get();
+        }
         
         // get the chunks of the aligned path that overlap the ref path
         unordered_map<pair<path_handle_t, bool>, vector<tuple<size_t, size_t, int32_t>>> connections;
-        auto path_overlapping_anchors = source_aln ? extract_overlapping_paths(&memoizing_graph, *source_aln, paths)
-                                                   : extract_overlapping_paths(&memoizing_graph, *source_mp_aln,
+        auto path_overlapping_anchors = source_aln ? extract_overlapping_paths(memoizing_graph, *source_aln, paths)
+                                                   : extract_overlapping_paths(memoizing_graph, *source_mp_aln,
                                                                                paths, connections);
         
         if (source_mp_aln) {
@@ -328,7 +490,7 @@ using namespace std;
             pair<step_handle_t, step_handle_t> path_range;
             if (!preserve_deletions && source_aln) {
                 // unspliced GAM -> GAM surjection
-                auto surjection = realigning_surject(&memoizing_graph, *source_aln, surj_record.first.first, surj_record.first.second,
+                auto surjection = realigning_surject(memoizing_graph, *source_aln, surj_record.first.first, surj_record.first.second,
                                                      surj_record.second.first, surj_record.second.second, path_range, allow_negative_scores);
                 if (surjection.path().mapping_size() != 0) {
                     aln_surjections[surj_record.first] = make_pair(move(surjection), path_range);
@@ -336,7 +498,7 @@ using namespace std;
             }
             else if (source_aln) {
                 // spliced GAM -> GAM surjection
-                auto surjection = spliced_surject(&memoizing_graph, source_aln->sequence(), source_aln->quality(),
+                auto surjection = spliced_surject(memoizing_graph, source_aln->sequence(), source_aln->quality(),
                                                   source_aln->mapping_quality(), surj_record.first.first, surj_record.first.second,
                                                   surj_record.second.first, surj_record.second.second,
                                                   connections[surj_record.first], path_range,
@@ -352,7 +514,7 @@ using namespace std;
             else {
                 // surjecting a multipath alignment (they always use the spliced pathway even if not
                 // doing spliced alignment)
-                auto surjection = spliced_surject(&memoizing_graph, source_mp_aln->sequence(),
+                auto surjection = spliced_surject(memoizing_graph, source_mp_aln->sequence(),
                                                   source_mp_aln->quality(), source_mp_aln->mapping_quality(),
                                                   surj_record.first.first, surj_record.first.second,
                                                   surj_record.second.first, surj_record.second.second,
@@ -492,7 +654,7 @@ using namespace std;
             
             // use this info to set the path position
             positions_out.emplace_back();
-            set_path_position(&memoizing_graph, initial_pos, final_pos, path_range.first, path_range.second,
+            set_path_position(memoizing_graph, initial_pos, final_pos, path_range.first, path_range.second,
                               path_strand.second, get<0>(positions_out.back()), get<1>(positions_out.back()),
                               get<2>(positions_out.back()));
             
@@ -2954,23 +3116,36 @@ using namespace std;
             // nonempty path interval that they cover.
             assert(ref_path_interval.first <= ref_path_interval.second);
             
-            // get the path graph corresponding to this interval
-            bdsg::HashGraph path_graph;
-            unordered_map<id_t, pair<id_t, bool>> path_trans = extract_linearized_path_graph(path_position_graph, &path_graph, path_handle,
-                                                                                             ref_path_interval.first, ref_path_interval.second);
+            // get the path graph corresponding to this interval, from the sorted input
+            // cache if we have one
+            bdsg::HashGraph local_path_graph;
+            unordered_map<id_t, pair<id_t, bool>> local_path_trans;
+            const bdsg::HashGraph* path_graph = &local_path_graph;
+            const unordered_map<id_t, pair<id_t, bool>>* path_trans = &local_path_trans;
+            SortedInputCache* sorted_input_cache = get_sorted_input_cache();
+            if (sorted_input_cache && !path_position_graph->get_is_circular(path_handle)) {
+                sorted_input_cache->extract_linearized_path_graph(path_position_graph, path_handle,
+                                                                  ref_path_interval.first, ref_path_interval.second);
+                path_graph = &sorted_input_cache->path_graph;
+                path_trans = &sorted_input_cache->path_trans;
+            }
+            else {
+                local_path_trans = extract_linearized_path_graph(path_position_graph, &local_path_graph, path_handle,
+                                                                 ref_path_interval.first, ref_path_interval.second);
+            }
             
             // split it into a forward and reverse strand
             // TODO: we usually should only need one strand of the graph, but it might be different strands on
             // different nodes...
-            StrandSplitGraph split_path_graph(&path_graph);
+            StrandSplitGraph split_path_graph(path_graph);
             
             // make a translator down to the original graph
             unordered_map<id_t, pair<id_t, bool>> node_trans;
             split_path_graph.for_each_handle([&](const handle_t& handle) {
                 handle_t underlying = split_path_graph.get_underlying_handle(handle);
-                const pair<id_t, bool>& original = path_trans[path_graph.get_id(underlying)];
+                const pair<id_t, bool>& original = path_trans->at(path_graph->get_id(underlying));
                 node_trans[split_path_graph.get_id(handle)] = make_pair(original.first,
-                                                                        original.second != path_graph.get_is_reverse(underlying));
+                                                                        original.second != path_graph->get_is_reverse(underlying));
             });
             
 #ifdef debug_anchored_surject
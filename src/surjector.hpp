@@ -11,6 +11,7 @@
 #include <sstream>
 #include <algorithm>
 #include <functional>
+#include <memory>
 
 #include "aligner.hpp"
 #include "handle.hpp"
@@ -27,6 +28,8 @@ using namespace std;
         
         Surjector(const PathPositionHandleGraph* graph);
         
+        ~Surjector();
+        
         /// Extract the portions of an alignment that are on a chosen set of paths and try to
         /// align realign the portions that are off of the chosen paths to the intervening
         /// path segments to obtain an alignment that is fully restricted to the paths.
@@ -127,8 +130,26 @@ using namespace std;
         
         bool annotate_with_all_path_scores = false;
         
+        /// Tell the Surjector whether its input arrives sorted by node ID (e.g.
+        /// from vg gamsort). If so, each thread keeps a sliding cache of graph
+        /// lookups and path subgraphs across consecutive reads, dropping entries
+        /// as the input moves past them. Must be set before surjecting, and
+        /// allocates a cache for each of get_thread_count() threads.
+        void set_sorted_input(bool sorted_input);
+        
+        /// The largest number of nodes each thread's sorted input cache memoizes
+        /// lookups for
+        size_t max_sorted_cache_nodes = 64 * 1024;
+        
     protected:
         
+        /// Per-thread state for surjecting sorted input
+        struct SortedInputCache;
+        
+        /// Get the calling thread's sorted input cache, or null if the input
+        /// isn't sorted
+        SortedInputCache* get_sorted_input_cache() const;
+        
         void surject_internal(const Alignment* source_aln, const multipath_alignment_t* source_mp_aln,
                               vector<Alignment>* alns_out, vector<multipath_alignment_t>* mp_alns_out,
                               const unordered_set<path_handle_t>& paths,
@@ -266,6 +287,9 @@ using namespace std;
         
         /// the graph we're surjecting onto
         const PathPositionHandleGraph* graph = nullptr;
+        
+        /// caches for sorted input, indexed by thread, or empty if the input isn't sorted
+        vector<unique_ptr<SortedInputCache>> sorted_input_caches;
     };
 
 
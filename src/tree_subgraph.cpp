@@ -194,5 +194,20 @@ Path TreeSubgraph::translate_down(const Path& path_against_subgraph) const {
     return translated;
 }
 
+size_t TreeSubgraph::get_longest_path_length() const {
+    // How long is the path from the root through the end of each node?
+    vector<size_t> depth(tree.size());
+    size_t longest = 0;
+    for (size_t i = 0; i < tree.size(); i++) {
+        // Parents come before children, so the parent's depth is known.
+        depth[i] = get_length(get_handle(i + 1, false));
+        if (tree[i].first != -1) {
+            depth[i] += depth[tree[i].first];
+        }
+        longest = max(longest, depth[i]);
+    }
+    return longest;
+}
+
 }
 
@@ -121,6 +121,10 @@ using namespace std;
         /// Translate a Path against us to a Path against the base graph
         Path translate_down(const Path& path_against_subgraph) const;
         
+        /// Get the length in bases of the longest path from the root to a
+        /// leaf. No path through the tree can spell more bases than this.
+        size_t get_longest_path_length() const;
+        
     protected:
         /// What graph are we based on?
         const HandleGraph* super;
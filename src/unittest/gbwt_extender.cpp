@@ -410,6 +410,9 @@ void paths_match(const Path& path, const Path& correct_path) {
 /// given graph and ensure they can be round-tripped from Path to WFAAlignment
 /// and back.
 void round_trip_versions_of(const std::vector<handle_t>& base_path, const HandleGraph& graph) {
+    // Also convert into the same Path object over and over, to make sure
+    // leftovers from previous conversions don't leak through.
+    Path reused;
     // For each basic route we want to look at through the graph 
     for_each_random_alignment(graph, base_path, [&](const Path& truth_path, const std::string& truth_sequence) {
         // Consider some alignments and round-trip to WFAAlignment and back.
@@ -427,6 +430,8 @@ void round_trip_versions_of(const std::vector<handle_t>& base_path, const Handle
         std::cerr << "Converts back to Path " << pb2json(converted_back) << std::endl;
 #endif
         paths_match(converted_back, truth_path);
+        converted.to_path(graph, truth_sequence, reused);
+        paths_match(reused, truth_path);
      });
 }
 
@@ -1136,6 +1141,81 @@ TEST_CASE("Non-ACGT characters do not match", "[gapless_extender]") {
 
 //------------------------------------------------------------------------------
 
+TEST_CASE("Matching stops at the mismatch limit within a word", "[gapless_extender]") {
+
+    // Mismatches at 1, 3, 4 in the first word, and at 7, 8, 10 in the
+    // last 8 characters, which is the first word matched backward.
+    std::string read   = "AAAAAAAAAAAA";
+    std::string target = "ACACCAACCACA";
+    gbwtgraph::view_type view(target.data(), target.length());
+
+    SECTION("forward") {
+        std::vector<std::pair<size_t, uint32_t>> expected {
+            // (characters matched, mismatches) for limits 1, 2, 3, 4
+            { 1, 0 }, { 3, 1 }, { 4, 2 }, { 7, 3 }
+        };
+        for (uint32_t limit = 1; limit <= expected.size(); limit++) {
+            GaplessExtension match {};
+            match.read_interval = { 0, 0 };
+            size_t matched = match_forward(match, read, view, limit);
+            REQUIRE(matched == expected[limit - 1].first);
+            REQUIRE(match.read_interval.second == expected[limit - 1].first);
+            REQUIRE(match.internal_score == expected[limit - 1].second);
+        }
+    }
+
+    SECTION("forward with earlier mismatches") {
+        // Start in the middle, with one mismatch already counted. The word
+        // covers 7 to 11 with mismatches at 7, 8, 10.
+        std::vector<std::pair<size_t, uint32_t>> expected {
+            // (characters matched, mismatches) for limits 2, 3, 4
+            { 0, 1 }, { 1, 2 }, { 3, 3 }
+        };
+        for (uint32_t limit = 2; limit < expected.size() + 2; limit++) {
+            GaplessExtension match {};
+            match.read_interval = { 7, 7 };
+            match.internal_score = 1;
+            gbwtgraph::view_type suffix(target.data() + 7, target.length() - 7);
+            size_t matched = match_forward(match, read, suffix, limit);
+            REQUIRE(matched == expected[limit - 2].first);
+            REQUIRE(match.read_interval.second == 7 + expected[limit - 2].first);
+            REQUIRE(match.internal_score == expected[limit - 2].second);
+        }
+    }
+
+    SECTION("backward") {
+        std::vector<std::pair<size_t, uint32_t>> expected {
+            // (start of the match, mismatches) for limits 1, 2, 3, 4
+            { 11, 0 }, { 9, 1 }, { 8, 2 }, { 5, 3 }
+        };
+        for (uint32_t limit = 1; limit <= expected.size(); limit++) {
+            GaplessExtension match {};
+            match.read_interval = { read.length(), read.length() };
+            match.offset = target.length();
+            match_backward(match, read, view, limit);
+            REQUIRE(match.read_interval.first == expected[limit - 1].first);
+            REQUIRE(match.offset == expected[limit - 1].first);
+            REQUIRE(match.internal_score == expected[limit - 1].second);
+        }
+    }
+
+    SECTION("without reaching the limit") {
+        GaplessExtension forward {};
+        forward.read_interval = { 0, 0 };
+        REQUIRE(match_forward(forward, read, view, 7) == target.length());
+        REQUIRE(forward.internal_score == 6);
+
+        GaplessExtension backward {};
+        backward.read_interval = { read.length(), read.length() };
+        backward.offset = target.length();
+        match_backward(backward, read, view, 7);
+        REQUIRE(backward.read_interval.first == 0);
+        REQUIRE(backward.internal_score == 6);
+    }
+}
+
+//------------------------------------------------------------------------------
+
 TEST_CASE("Gapless extensions can be converted to WFAAlignments and joined", "[wfa_alignment]") {
 
     // Build a GBWT with three threads including a duplicate.
@@ -0,0 +1,138 @@
+/// \file hts_duplicate_marker.cpp
+///
+/// Unit tests for the HTSDuplicateMarker, which flags duplicates in sorted BAM streams
+
+#include "../hts_duplicate_marker.hpp"
+
+#include "catch.hpp"
+
+#include <string>
+#include <vector>
+
+namespace vg {
+namespace unittest {
+using namespace std;
+
+/// Make an unpaired BAM record with the given CIGAR and base quality
+static bam1_t* make_dup_test_record(const string& name, int64_t pos, const vector<uint32_t>& cigar, bool reverse, uint8_t quality) {
+    bam1_t* b = bam_init1();
+    size_t length = bam_cigar2qlen(cigar.size(), cigar.data());
+    string seq(length, 'A');
+    string qual(length, (char) quality);
+    REQUIRE(bam_set1(b, name.size(), name.c_str(), reverse ? BAM_FREVERSE : 0, 0, pos, 60,
+                     cigar.size(), cigar.data(), -1, -1, 0, length, seq.c_str(), qual.c_str(), 0) >= 0);
+    return b;
+}
+
+/// Make an unpaired BAM record with the given match length and base quality
+static bam1_t* make_dup_test_record(const string& name, int64_t pos, size_t length, bool reverse, uint8_t quality) {
+    return make_dup_test_record(name, pos, vector<uint32_t>{(uint32_t) bam_cigar_gen(length, BAM_CMATCH)}, reverse, quality);
+}
+
+/// Run records through a duplicate marker, and get the names and duplicate
+/// flags of what comes out.
+static vector<pair<string, bool>> mark_dup_test_records(vector<bam1_t*> input, bool remove, size_t expected_duplicates) {
+    vector<pair<string, bool>> output;
+    HTSDuplicateMarker marker([&](bam1_t* b) {
+        output.emplace_back(bam_get_qname(b), b->core.flag & BAM_FDUP);
+    }, remove);
+    for (auto& b : input) {
+        marker.add(b);
+    }
+    marker.flush();
+
+    REQUIRE(marker.examined == input.size());
+    REQUIRE(marker.duplicates == expected_duplicates);
+
+    // We get back the records we gave up.
+    for (auto& b : input) {
+        bam_destroy1(b);
+    }
+    return output;
+}
+
+TEST_CASE("HTSDuplicateMarker uses both fragment ends and keeps the best read", "[hts][duplicates]") {
+
+    for (bool remove : {false, true}) {
+        vector<bam1_t*> input {
+            make_dup_test_record("low", 10, 40, false, 20),
+            make_dup_test_record("high", 10, 40, false, 30),
+            // Same start, different end: not a duplicate for collapsed reads
+            make_dup_test_record("longer", 10, 45, false, 30),
+            // Same ends, other strand: not a duplicate
+            make_dup_test_record("reverse", 10, 40, true, 30),
+            make_dup_test_record("elsewhere", 11, 40, false, 30),
+            make_dup_test_record("elsewhere2", 11, 40, false, 10)
+        };
+        vector<pair<string, bool>> output = mark_dup_test_records(input, remove, 2);
+
+        if (remove) {
+            REQUIRE(output.size() == 4);
+            for (auto& item : output) {
+                REQUIRE(!item.second);
+                REQUIRE(item.first != "low");
+                REQUIRE(item.first != "elsewhere2");
+            }
+        } else {
+            REQUIRE(output.size() == 6);
+            // Order is preserved
+            REQUIRE(output[0] == make_pair(string("low"), true));
+            REQUIRE(output[1] == make_pair(string("high"), false));
+            REQUIRE(output[2] == make_pair(string("longer"), false));
+            REQUIRE(output[3] == make_pair(string("reverse"), false));
+            REQUIRE(output[4] == make_pair(string("elsewhere"), false));
+            REQUIRE(output[5] == make_pair(string("elsewhere2"), true));
+        }
+    }
+}
+
+TEST_CASE("HTSDuplicateMarker counts clipped bases as part of the fragment", "[hts][duplicates]") {
+
+    vector<bam1_t*> input {
+        make_dup_test_record("unclipped", 10, 40, false, 20),
+        // Aligns to the same place as the first, but is clipped at the end
+        make_dup_test_record("hard", 10, {bam_cigar_gen(38, BAM_CMATCH), bam_cigar_gen(2, BAM_CHARD_CLIP)}, false, 40),
+        // Aligns 5 bases later, but starts and ends in the same place
+        make_dup_test_record("soft", 15, {bam_cigar_gen(5, BAM_CSOFT_CLIP), bam_cigar_gen(35, BAM_CMATCH)}, false, 30),
+        // Same aligned start as the soft-clipped read, but really starts later
+        make_dup_test_record("later", 15, 35, false, 30)
+    };
+    vector<pair<string, bool>> output = mark_dup_test_records(input, false, 2);
+
+    REQUIRE(output.size() == 4);
+    REQUIRE(output[0] == make_pair(string("unclipped"), true));
+    REQUIRE(output[1] == make_pair(string("hard"), false));
+    REQUIRE(output[2] == make_pair(string("soft"), true));
+    REQUIRE(output[3] == make_pair(string("later"), false));
+}
+
+TEST_CASE("HTSDuplicateMarker only holds reads while they can still have duplicates", "[hts][duplicates]") {
+
+    vector<string> output;
+    HTSDuplicateMarker marker([&](bam1_t* b) {
+        output.emplace_back(bam_get_qname(b));
+    }, false, 10);
+
+    bam1_t* b = make_dup_test_record("first", 10, 40, false, 30);
+    marker.add(b);
+    REQUIRE(output.empty());
+    bam_destroy1(b);
+
+    // Clipping by up to 10 bases could still make this a duplicate
+    b = make_dup_test_record("near", 20, 40, false, 30);
+    marker.add(b);
+    REQUIRE(output.empty());
+    bam_destroy1(b);
+
+    b = make_dup_test_record("far", 100, 40, false, 30);
+    marker.add(b);
+    REQUIRE(output == vector<string>{"first", "near"});
+    bam_destroy1(b);
+
+    marker.flush();
+    REQUIRE(output.size() == 3);
+    REQUIRE(marker.duplicates == 0);
+}
+
+}
+}
@@ -0,0 +1,107 @@
+/// \file hts_sorter.cpp
+///
+/// Unit tests for the HTSSorter, which coordinate-sorts BAM records
+
+#include "../hts_sorter.hpp"
+
+#include "catch.hpp"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace vg {
+namespace unittest {
+using namespace std;
+
+/// Make a simple unpaired BAM record
+static bam1_t* make_sort_test_record(const string& name, int32_t tid, int64_t pos, bool reverse) {
+    bam1_t* b = bam_init1();
+    string seq = "GATTACAGATTACA";
+    uint32_t cigar = bam_cigar_gen(seq.size(), BAM_CMATCH);
+    uint16_t flag = reverse ? BAM_FREVERSE : 0;
+    if (tid == -1) {
+        flag |= BAM_FUNMAP;
+    }
+    REQUIRE(bam_set1(b, name.size(), name.c_str(), flag, tid, pos, 60,
+                     tid == -1 ? 0 : 1, &cigar, -1, -1, 0, seq.size(), seq.c_str(), nullptr, 0) >= 0);
+    return b;
+}
+
+TEST_CASE("HTSSorter orders records by contig, position, strand, and name", "[hts][sort]") {
+
+    bam1_t* a = make_sort_test_record("a", 0, 100, false);
+    bam1_t* b = make_sort_test_record("b", 0, 100, true);
+    bam1_t* c = make_sort_test_record("c", 1, 5, false);
+    bam1_t* d = make_sort_test_record("d", -1, -1, false);
+    bam1_t* e = make_sort_test_record("e", 0, 100, false);
+
+    REQUIRE(HTSSorter::less_than(a, b));
+    REQUIRE(!HTSSorter::less_than(b, a));
+    REQUIRE(HTSSorter::less_than(b, c));
+    REQUIRE(HTSSorter::less_than(c, d));
+    REQUIRE(HTSSorter::less_than(a, e));
+    REQUIRE(!HTSSorter::less_than(a, a));
+
+    for (auto& r : {a, b, c, d, e}) {
+        bam_destroy1(r);
+    }
+}
+
+TEST_CASE("HTSSorter merges records from several threads, spilled or not", "[hts][sort]") {
+
+    string header_text = "@HD\tVN:1.5\tSO:coordinate\n@SQ\tSN:x\tLN:1000000\n@SQ\tSN:y\tLN:1000000\n";
+    bam_hdr_t* header = sam_hdr_parse(header_text.size(), header_text.c_str());
+    REQUIRE(header != nullptr);
+
+    for (size_t record_count : {100, 40000}) {
+        // The larger count exceeds the minimum per-thread budget and must spill.
+        HTSSorter sorter(2, 0);
+
+        for (size_t thread_number = 0; thread_number < 2; thread_number++) {
+            vector<bam1_t*> batch;
+            for (size_t i = 0; i < record_count; i++) {
+                // Interleave positions between the threads, in reverse order.
+                int64_t pos = (record_count - i) * 2 + thread_number;
+                batch.push_back(make_sort_test_record("r" + to_string(pos), pos % 3 == 0 ? 1 : 0, pos, false));
+                if (batch.size() == 1000) {
+                    sorter.add(header, batch, thread_number);
+                    REQUIRE(batch.empty());
+                }
+            }
+            sorter.add(header, batch, thread_number);
+        }
+
+        if (record_count > 100) {
+            REQUIRE(sorter.spilled_runs() > 0);
+        } else {
+            REQUIRE(sorter.spilled_runs() == 0);
+        }
+
+        size_t seen = 0;
+        bam1_t* last = nullptr;
+        bool in_order = true;
+        sorter.merge(header, [&](bam1_t* b) {
+            if (last != nullptr && HTSSorter::less_than(b, last)) {
+                in_order = false;
+            }
+            // Records are only valid during the callback, so keep a copy.
+            if (last != nullptr) {
+                bam_destroy1(last);
+            }
+            last = bam_dup1(b);
+            seen++;
+        });
+        if (last != nullptr) {
+            bam_destroy1(last);
+        }
+
+        REQUIRE(seen == record_count * 2);
+        REQUIRE(in_order);
+    }
+
+    bam_hdr_destroy(header);
+}
+
+}
+}
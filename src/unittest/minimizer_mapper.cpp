@@ -29,6 +29,9 @@ public:
     using MinimizerMapper::Minimizer;
     using MinimizerMapper::fragment_length_distr;
     using MinimizerMapper::faster_cap;
+    using MinimizerMapper::get_log10_prob_of_disruption_in_interval;
+    using MinimizerMapper::get_prob_of_disruption_in_column;
+    using MinimizerMapper::find_best_tree;
 };
 
 TEST_CASE("Fragment length distribution gets reasonable value", "[giraffe][mapping]") {
@@ -162,6 +165,120 @@ TEST_CASE("Mapping quality cap cannot be confused by excessive Gs", "[giraffe][m
     REQUIRE(!isinf(cap));
 }
 
+TEST_CASE("Disruption probability of an interval agrees with its columns", "[giraffe][mapping]") {
+    string sequence = "GATTACACATTAGGCATCGGATCCAGTTACGATCAGCATGCAATTGCCGTAGGTACCATGACTGATCGTAGCTAGCTTAGGCATCAGTCAGCTAGTCGAT";
+    string quality;
+    for (size_t i = 0; i < sequence.size(); i++) {
+        quality.push_back((char)(10 + (i * 7) % 30));
+    }
+    
+    // 15bp cores with 5bp flanks, which may run off the ends of an interval
+    int core_width = 15;
+    int flank_width = 5;
+    vector<TestMinimizerMapper::Minimizer> minimizers;
+    vector<size_t> disrupted;
+    for (size_t core_start : {5, 30, 60, 80}) {
+        disrupted.push_back(minimizers.size());
+        minimizers.emplace_back();
+        TestMinimizerMapper::Minimizer& m = minimizers.back();
+        m.agglomeration_start = core_start - flank_width;
+        m.agglomeration_length = core_width + 2 * flank_width;
+        // Different sequences give different hashes
+        m.value.key = gbwtgraph::DefaultMinimizerIndex::key_type::encode(sequence.substr(core_start, core_width));
+        m.value.hash = m.value.key.hash();
+        m.value.offset = core_start;
+        m.value.is_reverse = false;
+        m.hits = 10;
+        m.occs = nullptr;
+        m.length = core_width;
+        m.candidates_per_window = flank_width + 1;
+        m.score = 1;
+    }
+    
+    // Whole read, cores hanging past left and right, inside one core, one
+    // column, and no cores at all
+    vector<pair<size_t, size_t>> intervals { {0, 100}, {10, 40}, {32, 38}, {50, 51}, {0, 5}, {42, 61} };
+    for (auto& interval : intervals) {
+        double fast = TestMinimizerMapper::get_log10_prob_of_disruption_in_interval(minimizers, sequence, quality,
+            disrupted.begin(), disrupted.end(), interval.first, interval.second);
+        
+        // OR up the columns one at a time
+        double p = 0;
+        for (size_t i = interval.first; i < interval.second; i++) {
+            double col_p = TestMinimizerMapper::get_prob_of_disruption_in_column(minimizers, sequence, quality,
+                disrupted.begin(), disrupted.end(), i);
+            p = (i == interval.first) ? col_p : (p + col_p - (p * col_p));
+        }
+        double slow = log10(p);
+        
+        REQUIRE(fast == Approx(slow).epsilon(1e-12));
+    }
+}
+
+TEST_CASE("Tail trees are tried best bound first and skipped when they can't win", "[giraffe][mapping]") {
+    // Remember which trees we actually align to
+    vector<size_t> aligned;
+    
+    SECTION("Trees that can't beat the best score so far are not aligned") {
+        vector<int32_t> bounds { 5, 40, 12 };
+        vector<int32_t> scores { 5, 15, 12 };
+        auto best = TestMinimizerMapper::find_best_tree(bounds, 50, 0, [&](size_t i) {
+            aligned.push_back(i);
+            return scores[i];
+        });
+        REQUIRE(best.first == 1);
+        REQUIRE(best.second == 15);
+        REQUIRE(aligned == vector<size_t>{1});
+    }
+    
+    SECTION("Nothing more is aligned once the best score is the maximum") {
+        vector<int32_t> bounds { 10, 30, 20, 30 };
+        vector<int32_t> scores { 10, 30, 20, 30 };
+        auto best = TestMinimizerMapper::find_best_tree(bounds, 30, 0, [&](size_t i) {
+            aligned.push_back(i);
+            return scores[i];
+        });
+        REQUIRE(best.first == 1);
+        REQUIRE(best.second == 30);
+        REQUIRE(aligned == vector<size_t>{1});
+    }
+    
+    SECTION("Ties go to the tree first in the forest, whatever order they are aligned in") {
+        vector<int32_t> bounds { 20, 30, 25 };
+        vector<int32_t> scores { 18, 18, 18 };
+        auto best = TestMinimizerMapper::find_best_tree(bounds, 30, 0, [&](size_t i) {
+            aligned.push_back(i);
+            return scores[i];
+        });
+        REQUIRE(best.first == 0);
+        REQUIRE(best.second == 18);
+        REQUIRE(aligned == vector<size_t>{1, 2, 0});
+    }
+    
+    SECTION("A tree that could only tie a later tree is aligned, but one that could only tie an earlier tree is not") {
+        vector<int32_t> bounds { 22, 22, 30 };
+        vector<int32_t> scores { 22, 22, 22 };
+        auto best = TestMinimizerMapper::find_best_tree(bounds, 30, 0, [&](size_t i) {
+            aligned.push_back(i);
+            return scores[i];
+        });
+        REQUIRE(best.first == 0);
+        REQUIRE(aligned == vector<size_t>{2, 0});
+    }
+    
+    SECTION("A tree must beat not aligning at all") {
+        vector<int32_t> bounds { 10, 10 };
+        vector<int32_t> scores { 0, numeric_limits<int32_t>::min() };
+        auto best = TestMinimizerMapper::find_best_tree(bounds, 30, 0, [&](size_t i) {
+            aligned.push_back(i);
+            return scores[i];
+        });
+        REQUIRE(best.first == 2);
+        REQUIRE(best.second == 0);
+        REQUIRE(aligned == vector<size_t>{0, 1});
+    }
+}
+
 
 
 
@@ -0,0 +1,61 @@
+/// \file safari_server.cpp
+///
+/// Unit tests for the mapping jobs sent to a SafariServer
+
+#include "../safari_server.hpp"
+
+#include "catch.hpp"
+
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+namespace vg {
+namespace unittest {
+using namespace std;
+
+TEST_CASE("SafariJob survives the trip over the wire", "[safari][server]") {
+    SafariJob job;
+    job.fastq_1 = "/data/lib 1/reads_1.fq.gz";
+    job.fastq_2 = "/data/lib 1/reads_2.fq.gz";
+    job.output_filename = "/data/out.gaf";
+    job.output_format = "GAF";
+    job.deam_3p = "/data/lib1.3p.prof";
+    job.deam_5p = "/data/lib1.5p.prof";
+    job.settings["hit-cap"] = "20";
+    job.settings["sample"] = "lib1";
+
+    stringstream wire;
+    job.serialize(wire);
+    SafariJob received = SafariJob::parse(wire.str());
+
+    REQUIRE(received.fastq_1 == job.fastq_1);
+    REQUIRE(received.fastq_2 == job.fastq_2);
+    REQUIRE(received.gam_filename.empty());
+    REQUIRE(!received.interleaved);
+    REQUIRE(received.output_filename == job.output_filename);
+    REQUIRE(received.output_format == job.output_format);
+    REQUIRE(received.deam_3p == job.deam_3p);
+    REQUIRE(received.deam_5p == job.deam_5p);
+    REQUIRE(received.settings == job.settings);
+    REQUIRE(!received.shutdown);
+}
+
+TEST_CASE("SafariJob parsing stops at the end of the job", "[safari][server]") {
+    SafariJob job = SafariJob::parse("gam-in reads.gam\ninterleaved\noutput out.gam\n\nhit-cap 5\n");
+    REQUIRE(job.gam_filename == "reads.gam");
+    REQUIRE(job.interleaved);
+    REQUIRE(job.settings.empty());
+
+    SafariJob stop;
+    stop.shutdown = true;
+    stringstream wire;
+    stop.serialize(wire);
+    REQUIRE(SafariJob::parse(wire.str()).shutdown);
+
+    REQUIRE_THROWS_AS(SafariJob::parse("output\n\n"), runtime_error);
+    REQUIRE_THROWS_AS(SafariJob::parse("fastq-in a\nfastq-in b\nfastq-in c\n\n"), runtime_error);
+}
+
+}
+}
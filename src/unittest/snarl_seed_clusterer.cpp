@@ -143,6 +143,51 @@ namespace unittest {
 
         }
     }
+    TEST_CASE( "cluster seeds on one chain with and without payloads",
+                   "[cluster]" ) {
+        VG graph;
+
+        Node* n1 = graph.create_node("GCA");
+        Node* n2 = graph.create_node("T");
+        Node* n3 = graph.create_node("G");
+        Node* n4 = graph.create_node("CTGA");
+
+        graph.create_edge(n1, n2);
+        graph.create_edge(n1, n3);
+        graph.create_edge(n2, n4);
+        graph.create_edge(n3, n4);
+
+        IntegratedSnarlFinder snarl_finder(graph);
+        SnarlDistanceIndex dist_index;
+        fill_in_distance_index(&dist_index, &graph, &snarl_finder);
+        SnarlDistanceIndexClusterer clusterer(dist_index, &graph);
+
+        vector<pos_t> positions;
+        positions.emplace_back(make_pos_t(1, false, 0));
+        positions.emplace_back(make_pos_t(1, false, 2));
+        positions.emplace_back(make_pos_t(4, true, 0));
+
+        //Payloads let seeds close together on the chain skip the snarl tree,
+        //but the answer must not change
+        for (size_t limit : {3, 10}) {
+            vector<size_t> cluster_counts;
+            for (bool use_minimizers : {true, false} ) {
+                vector<SnarlDistanceIndexClusterer::Seed> seeds;
+                for (auto& pos : positions) {
+                    auto chain_info = MIPayload::encode(get_minimizer_distances(dist_index, pos));
+                    if (use_minimizers) {
+                        seeds.push_back({ pos, 0, chain_info});
+                    } else {
+                        seeds.push_back({ pos, 0});
+                    }
+                }
+                vector<SnarlDistanceIndexClusterer::Cluster> clusters = clusterer.cluster_seeds(seeds, limit); 
+                cluster_counts.push_back(clusters.size());
+            }
+            REQUIRE(cluster_counts[0] == cluster_counts[1]);
+            REQUIRE(cluster_counts[0] == (limit == 3 ? 2 : 1));
+        }
+    }
     TEST_CASE( "two tips", "[cluster][bug]" ) {
         VG graph;
 
@@ -411,5 +411,89 @@ TEST_CASE("GAMIndex can work with ProtobufIterator cursors", "[gam][gamindex]")
 }
 
 
+TEST_CASE("IDRangeQueries matches overlapping queries", "[gamindex]") {
+    IDRangeQueries queries({{{1, 10}, {20, 30}}, {{5, 25}}, {{100, 100}}});
+    
+    REQUIRE(queries.size() == 3);
+    REQUIRE(queries.covered_ranges() == vector<pair<id_t, id_t>>({{1, 30}, {100, 100}}));
+    
+    vector<size_t> matches;
+    queries.match({7}, false, matches);
+    REQUIRE(matches == vector<size_t>({0, 1}));
+    queries.match({15}, false, matches);
+    REQUIRE(matches == vector<size_t>({1}));
+    queries.match({15, 100}, false, matches);
+    REQUIRE(matches == vector<size_t>({1, 2}));
+    queries.match({15, 100}, true, matches);
+    REQUIRE(matches.empty());
+    queries.match({8, 22}, true, matches);
+    REQUIRE(matches == vector<size_t>({0, 1}));
+    queries.match({8, 40}, true, matches);
+    REQUIRE(matches.empty());
+    queries.match({50}, false, matches);
+    REQUIRE(matches.empty());
+}
+
+TEST_CASE("GAMIndex can look up many queries at once in parallel", "[gam][gamindex]") {
+    stringstream file;
+    
+    // Make groups of one-node alignments to each node, in order.
+    id_t next_id = 1;
+    for (size_t group_number = 0; group_number < 50; group_number++) {
+        vector<Alignment> group;
+        for (size_t i = 0; i < 100; i++) {
+            group.emplace_back();
+            group.back().mutable_path()->add_mapping()->mutable_position()->set_node_id(next_id);
+            next_id++;
+        }
+        vg::io::write_buffered(file, group, 0);
+    }
+    
+    GAMIndex::cursor_t cursor(file);
+    GAMIndex index;
+    index.index(cursor);
+    
+    // Make some overlapping queries
+    vector<vector<pair<id_t, id_t>>> query_ranges;
+    for (id_t start = 1; start < next_id; start += 250) {
+        query_ranges.push_back({{start, start + 299}});
+    }
+    query_ranges.push_back({{10, 20}, {4000, 4010}});
+    IDRangeQueries queries(query_ranges);
+    
+    // Look them up one at a time
+    vector<vector<id_t>> expected(query_ranges.size());
+    for (size_t i = 0; i < query_ranges.size(); i++) {
+        index.find(cursor, query_ranges[i], [&](const Alignment& found) {
+            expected[i].push_back(found.path().mapping(0).position().node_id());
+        });
+    }
+    
+    // And all together, with a cursor per thread
+    vector<stringstream> streams(4);
+    vector<unique_ptr<GAMIndex::cursor_t>> cursors;
+    vector<GAMIndex::cursor_t*> cursor_pointers;
+    for (auto& stream : streams) {
+        stream.str(file.str());
+        cursors.emplace_back(new GAMIndex::cursor_t(stream));
+        cursor_pointers.push_back(cursors.back().get());
+    }
+    vector<vector<id_t>> observed(query_ranges.size());
+    index.find_all(cursor_pointers, queries, [&](size_t query, const Alignment& found) {
+        observed[query].push_back(found.path().mapping(0).position().node_id());
+    });
+    
+    REQUIRE(observed == expected);
+    REQUIRE(observed.back().size() == 22);
+    
+    // And with spans too big to buffer, so that they are streamed
+    vector<vector<id_t>> streamed(query_ranges.size());
+    index.find_all(cursor_pointers, queries, [&](size_t query, const Alignment& found) {
+        streamed[query].push_back(found.path().mapping(0).position().node_id());
+    }, false, 10);
+    
+    REQUIRE(streamed == expected);
+}
+
 }
 }
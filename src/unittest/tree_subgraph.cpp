@@ -58,6 +58,9 @@ TEST_CASE("TreeSubgraph can be created and traversed", "[subgraph]") {
         
         REQUIRE(root == subgraph.get_root());
         
+        // The longest path spells GATTACA
+        REQUIRE(subgraph.get_longest_path_length() == 7);
+        
         SECTION("root node is correct") {
         
             // Make sure it is correct
@@ -178,6 +181,9 @@ TEST_CASE("TreeSubgraph can be created and traversed", "[subgraph]") {
         REQUIRE(subgraph.get_sequence(trimmed_root) == "T");
         REQUIRE(subgraph.get_sequence(subgraph.flip(trimmed_root)) == "A");
         
+        // The trimmed bases don't count towards path length
+        REQUIRE(subgraph.get_longest_path_length() == 5);
+        
         Path forward_path;
         json2pb(forward_path, R"(
             {"mapping": [
@@ -108,6 +108,7 @@ dz_alignment_s* XdropAligner::trace(const dz_forefront_s* forefront) {
 
 void XdropAligner::flush() {
     dz_flush(dz);
+    trim_arena();
 }
 
 /**
@@ -6,7 +6,7 @@ BASH_TAP_ROOT=../deps/bash-tap
 PATH=../bin:$PATH # for vg
 
 
-plan tests 46
+plan tests 47
 
 vg construct -r small/x.fa >j.vg
 vg index -x j.xg j.vg
@@ -194,5 +194,8 @@ is "$(vg surject -x x.xg -s -m -t 1 mapped.gamp | grep -v '@' | wc -l)" 40 "GAMP
 is "$(vg surject -x x.xg -M -m -s -t 1 mapped.gamp | grep -v '@' | wc -l)" 80 "GAMP surject can return multimappings"
 is "$(vg surject -x x.xg -M -m -s -i -t 1 mapped.gamp | grep -v '@' | wc -l)" 80 "GAMP surject can return multimappings"
 
-rm x.vg x.pathdup.vg x.xg x.gcsa x.gcsa.lcp x.gam mapped.gam mapped.gamp
+vg gamsort mapped.gam > mapped.sorted.gam
+is "$(vg surject -x x.xg -s -t 1 -O mapped.sorted.gam | md5sum)" "$(vg surject -x x.xg -s -t 1 mapped.sorted.gam | md5sum)" "surjecting sorted input with caching produces the same alignments"
+
+rm x.vg x.pathdup.vg x.xg x.gcsa x.gcsa.lcp x.gam mapped.gam mapped.sorted.gam mapped.gamp
 
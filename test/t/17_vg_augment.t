@@ -6,7 +6,7 @@ BASH_TAP_ROOT=../deps/bash-tap
 PATH=../bin:$PATH # for vg
 
 
-plan tests 39
+plan tests 43
 
 vg view -J -v pileup/tiny.json > tiny.vg
 
@@ -102,6 +102,18 @@ is "$?" 0 "augmenting 2 snps with -m 1 produces the same nodes as default"
 vg augment flat.vg 4edits.gam -m 11 -S | vg view - | grep S | awk '{print $3}' | sort > 4edits_m11.nodes
 diff 2snp_default.nodes 4edits_m11.nodes
 is "$?" 0 "augmenting 2 snps and 2 errors with -m 11 produces the same nodes as with just the snps"
+is "$(vg augment flat.vg 4edits.gam -m 11 -S -b 3 -t 2 | vg view - | md5sum)" "$(vg augment flat.vg 4edits.gam -m 11 -S | vg view - | md5sum)" "augmenting in small batches produces the same graph"
+
+# bound memory so tightly that a chopped-up graph is edited a couple of nodes at a time
+vg construct -m 8 -r tiny/tiny.fa >chop.vg
+vg index -x chop.xg -g chop.gcsa -k 16 chop.vg
+cat 2snp.sim 2err.sim | vg map -g chop.gcsa -x chop.xg -G - -k 8 >chop.gam
+vg augment chop.vg chop.gam -m 1 -S -i >chop.aug.vg
+vg augment chop.vg chop.gam -m 1 -S -i -M 0.001 >chop.aug.chunked.vg
+is "$(vg view chop.aug.chunked.vg | grep ^S | awk '{print $3}' | sort | md5sum)" "$(vg view chop.aug.vg | grep ^S | awk '{print $3}' | sort | md5sum)" "augmenting one node ID range at a time adds the same sequences"
+is "$(vg stats -E chop.aug.chunked.vg)" "$(vg stats -E chop.aug.vg)" "augmenting one node ID range at a time adds the same edges"
+is "$(vg paths -E -x chop.aug.chunked.vg | sort | md5sum)" "$(vg paths -E -x chop.aug.vg | sort | md5sum)" "augmenting one node ID range at a time embeds the same paths"
+rm -f chop.vg chop.xg chop.gcsa chop.gam chop.aug.vg chop.aug.chunked.vg
 
 # 2 snps, but one has a low quality, and one has a high quality
 echo "@read" > qual.fq
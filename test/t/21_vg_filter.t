@@ -5,7 +5,7 @@ BASH_TAP_ROOT=../deps/bash-tap
 
 PATH=../bin:$PATH # for vg
 
-plan tests 12
+plan tests 15
 
 vg construct -m 1000 -r small/x.fa -v small/x.vcf.gz >x.vg
 vg index -x x.xg  x.vg
@@ -78,6 +78,12 @@ rm g.xg g.gcsa g.gcsa.lcp g.proper.gam g.improper.gam
 is "$(echo '{"sequence": "GATTACA", "name": "read1", "annotation": {"features": ["test"]}, "fragment_next": {"name": "read2"}}{"sequence": "CATTAG", "name": "read2", "fragment_prev":{"name": "read1"}}' | vg view -JGa - | vg filter -F "test" -i - | vg view -aj - | wc -l)" "0" "read pairs can be tropped by feature"
 is "$(echo '{"sequence": "GATTACA", "name": "read1", "annotation": {"features": ["test"]}, "fragment_next": {"name": "read2"}}{"sequence": "CATTAG", "name": "read2", "fragment_prev":{"name": "read1"}}' | vg view -JGa - | vg filter -F "test" -I - | vg view -aj - | wc -l)" "2" "read pairs can be kept if only one read fails"
 
-rm -f x.gam filter_chunk*.gam chunks.bed
+vg convert -G x.gam x.xg > x.gaf
+is "$(vg filter -G -x x.xg x.gaf | wc -l)" 5000 "vg filter with no options preserves GAF input"
+is "$(vg filter -G -x x.xg -r 90 x.gaf | wc -l)" "$(vg filter -r 90 x.gam | vg view -aj - | wc -l)" "vg filter drops the same reads by score from GAF and GAM"
+vg filter -G -x x.xg -X chr x.gaf > /dev/null 2>&1
+is $? 1 "vg filter refuses to filter GAF by refpos contig"
+
+rm -f x.gam x.gaf filter_chunk*.gam chunks.bed
 rm -f x.vg x.xg paired.gam paired.sam paired.annotated.gam single.gam single.sam filtered.gam filtered.sam
                                                                
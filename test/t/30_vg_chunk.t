@@ -5,7 +5,7 @@ BASH_TAP_ROOT=../deps/bash-tap
 
 PATH=../bin:$PATH # for vg
 
-plan tests 32
+plan tests 33
 
 # Construct a graph with alt paths so we can make a GBWT and a GBZ
 vg construct -m 1000 -r small/x.fa -v small/x.vcf.gz -a >x.vg
@@ -49,7 +49,10 @@ is $(ls -l _chunk_test*.gam | wc -l) 2 "gam chunker produces correct number of g
 is $(grep x _chunk_test_out.bed | wc -l) 2 "gam chunker produces bed with correct number of chunks"
 is "$(vg view -aj _chunk_test_0_x_0_199.gam | wc -l)" "$(vg view -aj _chunk_test_0_x_0_199.gam | sort | uniq | wc -l)" "gam chunker emits each matching read at most once"
 is "$(vg view -aj _chunk_test_1_x_500_627.gam | wc -l)" "225" "chunk contains the expected number of alignments"
-rm -f _chunk_test*
+vg convert x.xg -G x.sorted.gam > x.sorted.gaf
+vg chunk -x x.xg -F x.sorted.gaf -b _chunk_test_gaf -e _chunk_test_bed.bed -c 0
+is "$(wc -l < _chunk_test_gaf_1_x_500_627.gaf)" "225" "gaf chunk contains the same alignments as the gam chunk"
+rm -f _chunk_test* x.sorted.gaf
 
 #check that we can chunk by read count
 vg chunk -a small/x-l100-n1000-s10-e0.01-i0.01.gam -m 100 -b _chunk_test
@@ -5,7 +5,7 @@ BASH_TAP_ROOT=../deps/bash-tap
 
 PATH=../bin:$PATH # for vg
 
-plan tests 20
+plan tests 24
 
 vg construct -m 1000 -r tiny/tiny.fa >flat.vg
 vg view flat.vg| sed 's/CAAATAAGGCTTGGAAATTTTCTGGAGTTCTATTATATTCCAACTCTCTG/CAAATAAGGCTTGGAAATTTTCTGGAGATCTATTATACTCCAACTCTCTG/' | vg view -Fv - >2snp.vg
@@ -33,6 +33,25 @@ vg pack -x flat.xg -o 2snp.gam.cx -b 10 -g 2snp.gam
 y=$(vg pack -x flat.xg -di 2snp.gam.cx | wc -c )
 is $x $y "binned edit accumulation does not affect the result"
 
+x=$(vg pack -x flat.xg -g 2snp.gam -d -B 0 -t 4 | md5sum | cut -f 1 -d\ )
+y=$(vg pack -x flat.xg -g 2snp.gam -d -B 7 -t 4 | md5sum | cut -f 1 -d\ )
+is $x $y "per-thread coverage buffers do not affect the result"
+
+x=$(vg pack -x flat.xg -g 2snp.gam -d | tail -n+2 | awk '{ s += $4 } END { print s }')
+y=$(vg pack -x flat.xg -g 2snp.gam -d -y SAFARI/dhigh5p.prof -Y SAFARI/dhigh3p.prof -P 0.1 | tail -n+2 | awk '{ s += $4 } END { print s }')
+is $y $x "damage masking keeps the coverage of bases that match the reference"
+
+# a C->T at the 5' end, a C->T in the middle, and a G->A at the 3' end
+echo '{"name": "5p", "sequence": "TAAATAAGGCTTGGAAATTT", "path": {"mapping": [{"position": {"node_id": 1}, "edit": [{"from_length": 1, "to_length": 1, "sequence": "T"}, {"from_length": 19, "to_length": 19}]}]}}' > damage.json
+echo '{"name": "mid", "sequence": "CAAATAAGGTTTGGAAATTT", "path": {"mapping": [{"position": {"node_id": 1}, "edit": [{"from_length": 9, "to_length": 9}, {"from_length": 1, "to_length": 1, "sequence": "T"}, {"from_length": 10, "to_length": 10}]}]}}' >> damage.json
+echo '{"name": "3p", "sequence": "CAAATAAGGCTTGA", "path": {"mapping": [{"position": {"node_id": 1}, "edit": [{"from_length": 13, "to_length": 13}, {"from_length": 1, "to_length": 1, "sequence": "A"}]}]}}' >> damage.json
+vg view -JaG damage.json > damage.gam
+vg pack -x flat.xg -o damage.cx -g damage.gam -e
+is "$(vg pack -x flat.xg -di damage.cx -e | tail -n+2 | awk '$5 != 0 { print $3 }' | paste -sd, -)" "0,9,13" "substitutions at the read ends and in the middle are recorded without damage masking"
+vg pack -x flat.xg -o damage.cx -g damage.gam -e -y SAFARI/dhigh5p.prof -Y SAFARI/dhigh3p.prof -P 0.1
+is "$(vg pack -x flat.xg -di damage.cx -e | tail -n+2 | awk '$5 != 0 { print $3 }' | paste -sd, -)" "9" "damage masking drops C->T and G->A at the read ends but keeps the interior C->T"
+rm -f damage.json damage.gam damage.cx
+
 x=$(vg pack -x flat.xg -di 2snp.gam.cx -n 1 | wc -c)
 y=$(vg pack -x flat.xg -di 2snp.gam.cx | wc -c)
 is $x $y "pack records are filtered by node id"
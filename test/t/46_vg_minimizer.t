@@ -5,7 +5,7 @@ BASH_TAP_ROOT=../deps/bash-tap
 
 PATH=../bin:$PATH # for vg
 
-plan tests 15
+plan tests 20
 
 
 # Indexing a single graph
@@ -51,7 +51,26 @@ is $? 0 "construction with payload"
 #Construction will not be deterministic because the snarls are not deterministic
 #is $(md5sum x.mi | cut -f 1 -d\ ) 6d377fdd427c7173e16e92516bf72b7b "construction is deterministic"
 
-rm -f x.vg x.xg x.gbwt x.snarls x.dist x.mi x.gg x.gbz
+# Updating the index with new haplotypes
+vg gbwt -x x.vg -E -o old.gbwt
+vg gbwt -m -o new.gbwt old.gbwt x.gbwt
+vg gbwt -x x.xg -g old.gbz --gbz-format old.gbwt
+vg gbwt -x x.xg -g new.gbz --gbz-format new.gbwt
+is $(( $(vg stats -N new.gbz) > $(vg stats -N old.gbz) && $(vg stats -E new.gbz) > $(vg stats -E old.gbz) )) 1 "new haplotypes add nodes and edges to the graph"
+vg index -j old.dist old.gbz
+vg index -j new.dist new.gbz
+vg minimizer -t 1 -o old.mi -d old.dist old.gbz
+vg minimizer -t 2 -l old.mi -U old.gbz -o x.mi -d new.dist -D updated.txt new.gbz
+is $? 0 "updating the index with new haplotypes"
+vg minimizer -t 1 -o new.mi -d new.dist -D scratch.txt new.gbz
+cmp -s updated.txt scratch.txt
+is $? 0 "updated index has the same hits and payloads as an index built from scratch"
+vg minimizer -t 1 -U old.gbz -o x.mi new.gbz 2> /dev/null
+is $? 1 "updating requires an index to update"
+vg minimizer -t 1 -l old.mi -U old.gbwt -o x.mi new.gbz 2> /dev/null
+is $? 1 "updating requires a graph to check against"
+
+rm -f x.vg x.xg x.gbwt x.snarls x.dist x.mi x.gg x.gbz old.gbwt old.gbz old.dist old.mi new.gbwt new.gbz new.dist new.mi updated.txt scratch.txt
 
 
 # Indexing two graphs
@@ -0,0 +1,46 @@
+#!/usr/bin/env bash
+
+BASH_TAP_ROOT=../deps/bash-tap
+. ../deps/bash-tap/bash-tap-bootstrap
+
+PATH=../bin:$PATH # for vg
+
+plan tests 7
+
+cp small/x.fa .
+cp small/x.vcf.gz .
+cp small/x.vcf.gz.tbi .
+
+# Build the indexes with a direct run, so the server loads the same ones.
+vg safari x.fa x.vcf.gz --deam-3p SAFARI/dhigh3p.prof --deam-5p SAFARI/dhigh5p.prof -f reads/small.middle.ref.fq -o gaf >/dev/null
+vg safari -Z x.safari.gbz -m x.min -d x.dist -q x.ry --deam-3p SAFARI/dhigh3p.prof --deam-5p SAFARI/dhigh5p.prof \
+    -t 1 -P -f reads/small.middle.ref.fq -o gaf > direct.gaf
+is "${?}" "0" "reads can be mapped directly"
+
+is "$(vg safari -Z x.safari.gbz -m x.min -d x.dist -q x.ry --deam-3p SAFARI/dhigh3p.prof --deam-5p SAFARI/dhigh5p.prof \
+    --serve server.sock --sort 2>&1 | grep -c "can't sort")" "1" "a server refuses options about one output file"
+
+vg safari -Z x.safari.gbz -m x.min -d x.dist -q x.ry --deam-3p SAFARI/dhigh3p.prof --deam-5p SAFARI/dhigh5p.prof \
+    -t 1 -P --serve server.sock 2>server.log &
+SERVER_PID=$!
+# Wait for the indexes to load and the socket to appear.
+while [[ ! -S server.sock ]] && kill -0 ${SERVER_PID} 2>/dev/null ; do
+    sleep 1
+done
+
+vg safari-submit -s server.sock -f reads/small.middle.ref.fq -o gaf -O served.gaf 2>submit.log
+is "${?}" "0" "a job can be submitted to a server"
+diff <(sort direct.gaf) <(sort served.gaf)
+is "${?}" "0" "a served job maps the same as a direct run with the same settings"
+
+vg safari-submit -s server.sock -f reads/small.middle.ref.fq -o gaf -O served2.gaf
+diff <(sort direct.gaf) <(sort served2.gaf)
+is "${?}" "0" "a second job on the same server maps the same"
+
+vg safari-submit -s server.sock --shutdown
+is "${?}" "0" "a server can be asked to shut down"
+wait ${SERVER_PID}
+is "${?}" "0" "a server exits cleanly after shutting down"
+
+rm -f x.fa x.fa.fai x.vcf.gz x.vcf.gz.tbi x.safari.gbz x.min x.dist x.ry
+rm -f direct.gaf served.gaf served2.gaf server.log submit.log server.sock